@@ -0,0 +1,438 @@
+//================================================
+//
+// libhatchling: the load-time static analysis
+// the engines use to drop checks a program
+// provably never needs. See hatchling.h.
+//
+//================================================
+#include <stdlib.h>
+#include <string.h>
+#include "hatchling.h"
+
+#define ANALYSIS_WIDEN  3           //joins at an instruction before its intervals are widened
+
+//what hmlAnalyze() knows on entry to one instruction
+struct analysisState{
+    bool reached;
+    int joins;                      //paths merged into the state so far
+    Interval acc;
+    int eq;                         //the accumulator is mem[eq] + offset, -1 when unknown
+    int offset;
+    Interval mem[256];
+};
+typedef struct analysisState AnalysisState;
+
+//================================================
+// interval arithmetic for hmlAnalyze(). An interval
+// with lo > hi holds no values, the result of an
+// operation on one holds none either
+//================================================
+#define FULL_RANGE  ((Interval){-32768, 32767})
+#define NO_VALUES   ((Interval){1, 0})
+#define IS_EMPTY(r) ((r).lo > (r).hi)
+
+static Interval intervalJoin(Interval a, Interval b){
+    if(IS_EMPTY(a)){
+        return b;
+    }
+    if(IS_EMPTY(b)){
+        return a;
+    }
+    return (Interval){a.lo < b.lo ? a.lo : b.lo, a.hi > b.hi ? a.hi : b.hi};
+}
+
+static Interval intervalMeet(Interval a, Interval b){
+    return (Interval){a.lo > b.lo ? a.lo : b.lo, a.hi < b.hi ? a.hi : b.hi};
+}
+
+//================================================
+// accumulator after an ADD, SUB, MUL, DIV or MOD
+// of a word in b, for every run that doesn't
+// fault. faults gets MAY_OVERFLOW and
+// MAY_DIVIDE_ZERO when some pair of values
+// would. Each of them is monotonic in both
+// operands while the divisor keeps its sign, so
+// the bounds are at the corners
+//================================================
+static Interval intervalArith(unsigned char op, Interval a, Interval b, unsigned char *faults){
+    *faults = 0;
+    if(IS_EMPTY(a) || IS_EMPTY(b)){
+        return NO_VALUES;
+    }
+
+    Interval r = NO_VALUES;
+    switch(op){
+        case ADD:
+            r = (Interval){a.lo + b.lo, a.hi + b.hi};
+            break;
+        case SUB:
+            r = (Interval){a.lo - b.hi, a.hi - b.lo};
+            break;
+        case MUL:
+        {
+            int c[4] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+            r = (Interval){c[0], c[0]};
+            for(int k = 1; k < 4; k++){
+                r = intervalJoin(r, (Interval){c[k], c[k]});
+            }
+            break;
+        }
+        case DIV:
+        case MOD:
+        {
+            if(b.lo <= 0 && b.hi >= 0){
+                *faults |= MAY_DIVIDE_ZERO;
+            }
+
+            //the negative and positive divisors, without 0
+            Interval parts[2] = {intervalMeet(b, (Interval){-32768, -1}), intervalMeet(b, (Interval){1, 32767})};
+            for(int k = 0; k < 2; k++){
+                Interval d = parts[k];
+                if(IS_EMPTY(d)){
+                    continue;
+                }
+                if(op == DIV){
+                    int c[4] = {a.lo / d.lo, a.lo / d.hi, a.hi / d.lo, a.hi / d.hi};
+                    for(int j = 0; j < 4; j++){
+                        r = intervalJoin(r, (Interval){c[j], c[j]});
+                    }
+                }
+                else{
+                    //smaller in magnitude than the divisor, with the sign of the dividend
+                    int m = (d.lo < 0 ? -d.lo : d.hi) - 1;
+                    r = intervalJoin(r, (Interval){a.lo < 0 ? (a.lo > -m ? a.lo : -m) : 0,
+                                                   a.hi > 0 ? (a.hi < m ? a.hi : m) : 0});
+                }
+            }
+            break;
+        }
+    }
+    if(r.lo < -32768 || r.hi > 32767){
+        *faults |= MAY_OVERFLOW;
+    }
+    return intervalMeet(r, FULL_RANGE);
+}
+
+//================================================
+// accumulator after an AND, ORR or XOR of a word
+// in b. Only non-negative values are tracked
+// closely, where no result needs more bits than
+// the wider operand
+//================================================
+static Interval intervalBits(unsigned char op, Interval a, Interval b){
+    if(IS_EMPTY(a) || IS_EMPTY(b)){
+        return NO_VALUES;
+    }
+    if(a.lo < 0 || b.lo < 0){
+        //masking with a non-negative value still can't go negative or past it
+        if(op == AND && (a.lo >= 0 || b.lo >= 0)){
+            return (Interval){0, a.lo >= 0 ? a.hi : b.hi};
+        }
+        return FULL_RANGE;
+    }
+    if(op == AND){
+        return (Interval){0, a.hi < b.hi ? a.hi : b.hi};
+    }
+    int bits = 1;
+    while(bits <= a.hi || bits <= b.hi){
+        bits <<= 1;
+    }
+    return (Interval){op == ORR ? (a.lo > b.lo ? a.lo : b.lo) : 0, bits - 1};
+}
+
+//================================================
+// accumulator after a NOT, LSR, ASR or LSL
+//================================================
+static Interval intervalShift(unsigned char op, Interval a){
+    if(IS_EMPTY(a)){
+        return NO_VALUES;
+    }
+    switch(op){
+        case NOT:
+            if(a.lo == 0 && a.hi == 0){
+                return (Interval){1, 1};
+            }
+            return (Interval){0, a.lo <= 0 && a.hi >= 0 ? 1 : 0};
+        case LSL:
+            //bits shifted out wrap the result around
+            if(a.lo < -16384 || a.hi > 16383){
+                return FULL_RANGE;
+            }
+            return (Interval){a.lo * 2, a.hi * 2};
+        default:
+            //LSR and ASR both shift the sign bit in
+            return (Interval){a.lo >> 1, a.hi >> 1};
+    }
+}
+
+//================================================
+// merges the state from one path into the state
+// an instruction has so far. Once it has been
+// joined ANALYSIS_WIDEN times a bound that still
+// grows jumps to the next threshold, so every
+// loop settles. Returns whether anything changed
+//================================================
+static bool joinState(AnalysisState *to, const AnalysisState *from, const int *thresholds, int nThresholds){
+    if(!to->reached){
+        *to = *from;
+        to->reached = true;
+        to->joins = 0;
+        return true;
+    }
+
+    bool widen = ++to->joins > ANALYSIS_WIDEN;
+    bool changed = false;
+    for(int i = -1; i < 256; i++){
+        Interval *old = i < 0 ? &to->acc : &to->mem[i];
+        Interval r = intervalJoin(*old, i < 0 ? from->acc : from->mem[i]);
+        if(r.lo == old->lo && r.hi == old->hi){
+            continue;
+        }
+        if(widen && r.lo < old->lo){
+            int k = nThresholds - 1;
+            while(thresholds[k] > r.lo){
+                k--;
+            }
+            r.lo = thresholds[k];
+        }
+        if(widen && r.hi > old->hi){
+            int k = 0;
+            while(thresholds[k] < r.hi){
+                k++;
+            }
+            r.hi = thresholds[k];
+        }
+        *old = r;
+        changed = true;
+    }
+    if(to->eq >= 0 && (to->eq != from->eq || to->offset != from->offset)){
+        to->eq = -1;
+        changed = true;
+    }
+    return changed;
+}
+
+//================================================
+// narrows a state to the accumulator values in
+// keep along one side of a branch, and the word
+// the accumulator was loaded from with it.
+// Returns false when no value takes that side
+//================================================
+static bool refineState(AnalysisState *s, Interval keep){
+    s->acc = intervalMeet(s->acc, keep);
+    if(IS_EMPTY(s->acc)){
+        return false;
+    }
+    if(s->eq >= 0){
+        s->mem[s->eq] = intervalMeet(s->mem[s->eq], (Interval){s->acc.lo - s->offset, s->acc.hi - s->offset});
+        return !IS_EMPTY(s->mem[s->eq]);
+    }
+    return true;
+}
+
+//================================================
+// load-time static analysis of the program in
+// memory. Follows every path from the
+// instruction counter through the branches,
+// carrying an interval for the accumulator and
+// for every word, to find the words that run as
+// code and the words code reads or writes, and
+// which arithmetic instructions can never
+// overflow or divide by zero. All of it assumes
+// the code never changes, so a reachable STOR or
+// READ into a code word marks the program
+// self-modifying and nothing is proven safe
+//================================================
+void hmlAnalyze(const Hatchling *hatchling, Analysis *analysis){
+    const unsigned short *mem = hatchling->mem;
+    memset(analysis, 0, sizeof(*analysis));
+    AnalysisState *state = calloc(256, sizeof(AnalysisState));
+
+    //widening stops at the extremes, around 0 and around every value in the program
+    bool *seen = calloc(65536, sizeof(bool));
+    int thresholds[256 * 3 + 5];
+    int nThresholds = 0;
+    static const int fixed[] = {-32768, -1, 0, 1, 32767};
+    for(int k = 0; k < 5; k++){
+        seen[fixed[k] + 32768] = true;
+    }
+    for(int i = 0; i < 256; i++){
+        for(int d = -1; d <= 1; d++){
+            int v = (signed short)mem[i] + d;
+            if(v >= -32768 && v <= 32767){
+                seen[v + 32768] = true;
+            }
+        }
+    }
+    for(int v = 0; v < 65536; v++){
+        if(seen[v]){
+            thresholds[nThresholds++] = v - 32768;
+        }
+    }
+    free(seen);
+
+    //FIFO of instructions whose state changed
+    unsigned char queue[256];
+    bool queued[256] = {false};
+    int head = 0, count = 0;
+    #define PROPAGATE(to, s) do{ unsigned char t_ = (to); \
+                                if(joinState(&state[t_], (s), thresholds, nThresholds) && !queued[t_]){ \
+                                    queued[t_] = true; \
+                                    queue[(head + count++) & 0xFF] = t_; \
+                                } }while(0)
+
+    AnalysisState *cur = malloc(sizeof(AnalysisState));
+    AnalysisState *taken = malloc(sizeof(AnalysisState));
+    cur->acc = (Interval){hatchling->accumulator, hatchling->accumulator};
+    cur->eq = -1;
+    cur->offset = 0;
+    for(int i = 0; i < 256; i++){
+        cur->mem[i] = (Interval){(signed short)mem[i], (signed short)mem[i]};
+    }
+    PROPAGATE(hatchling->instructCntr, cur);
+
+    while(count > 0){
+        unsigned char pc = queue[head];
+        head = (head + 1) & 0xFF;
+        count--;
+        queued[pc] = false;
+        *cur = state[pc];
+
+        unsigned char op = mem[pc] >> 8;
+        unsigned char x = mem[pc] & 0xFF;
+        unsigned char next = pc + 1;
+        Interval b = cur->mem[x];
+        unsigned char faults;
+        switch(op){
+            case ADD:
+            case SUB:
+            case MUL:
+            case DIV:
+            case MOD:
+                cur->acc = intervalArith(op, cur->acc, b, &faults);
+                if(IS_EMPTY(cur->acc)){
+                    break;
+                }
+
+                //adding or subtracting a constant keeps track of the word the accumulator came from
+                if((op == ADD || op == SUB) && cur->eq >= 0 && b.lo == b.hi && cur->offset > -65536 && cur->offset < 65536){
+                    cur->offset += op == ADD ? b.lo : -b.lo;
+                }
+                else{
+                    cur->eq = -1;
+                }
+                PROPAGATE(next, cur);
+                break;
+            case AND:
+            case ORR:
+            case XOR:
+                cur->acc = intervalBits(op, cur->acc, b);
+                cur->eq = -1;
+                PROPAGATE(next, cur);
+                break;
+            case NOT:
+            case LSR:
+            case ASR:
+            case LSL:
+                cur->acc = intervalShift(op, cur->acc);
+                cur->eq = -1;
+                PROPAGATE(next, cur);
+                break;
+            case LOAD:
+                cur->acc = b;
+                cur->eq = x;
+                cur->offset = 0;
+                PROPAGATE(next, cur);
+                break;
+            case STOR:
+                cur->mem[x] = cur->acc;
+                cur->eq = x;
+                cur->offset = 0;
+                PROPAGATE(next, cur);
+                break;
+            case READ:
+                cur->mem[x] = FULL_RANGE;
+                if(cur->eq == x){
+                    cur->eq = -1;
+                }
+                PROPAGATE(next, cur);
+                break;
+            case WRTE:
+                PROPAGATE(next, cur);
+                break;
+            case B:
+                PROPAGATE(x, cur);
+                break;
+            case BNEG:
+            case BPOS:
+            case BZRO:
+            {
+                Interval yes = op == BNEG ? (Interval){-32768, -1} : op == BPOS ? (Interval){1, 32767} : (Interval){0, 0};
+                *taken = *cur;
+                if(refineState(taken, yes)){
+                    PROPAGATE(x, taken);
+                }
+
+                //the other side can only lose a bound that is exactly the branch's value
+                Interval no = op == BNEG ? (Interval){0, 32767} : op == BPOS ? (Interval){-32768, 0} : cur->acc;
+                if(op == BZRO){
+                    no.lo += no.lo == 0;
+                    no.hi -= no.hi == 0;
+                }
+                if(refineState(cur, no)){
+                    PROPAGATE(next, cur);
+                }
+                break;
+            }
+            default:
+                //HALT, or an opcode that stops the program with an error
+                break;
+        }
+    }
+    #undef PROPAGATE
+
+    //classify the words the fixpoint reached
+    for(int i = 0; i < 256; i++){
+        analysis->acc[i] = NO_VALUES;
+        analysis->mem[i] = NO_VALUES;
+    }
+    for(int pc = 0; pc < 256; pc++){
+        if(!state[pc].reached){
+            continue;
+        }
+        unsigned char op = mem[pc] >> 8;
+        unsigned char x = mem[pc] & 0xFF;
+        analysis->kind[pc] |= WORD_CODE;
+        analysis->acc[pc] = state[pc].acc;
+        for(int i = 0; i < 256; i++){
+            analysis->mem[i] = intervalJoin(analysis->mem[i], state[pc].mem[i]);
+        }
+        switch(op){
+            case ADD: case SUB: case MUL: case DIV: case MOD:
+                intervalArith(op, state[pc].acc, state[pc].mem[x], &analysis->faults[pc]);
+                analysis->nChecked++;
+                //fall through
+            case AND: case ORR: case XOR: case LOAD: case STOR: case READ: case WRTE:
+                analysis->kind[x] |= WORD_DATA;
+                break;
+        }
+    }
+    for(int pc = 0; pc < 256; pc++){
+        unsigned char op = mem[pc] >> 8;
+        if((analysis->kind[pc] & WORD_CODE) && (op == STOR || op == READ) && (analysis->kind[mem[pc] & 0xFF] & WORD_CODE)){
+            analysis->selfModifying = true;
+        }
+    }
+    for(int pc = 0; pc < 256 && !analysis->selfModifying; pc++){
+        unsigned char op = mem[pc] >> 8;
+        if((analysis->kind[pc] & WORD_CODE) && op >= ADD && op <= MOD && analysis->faults[pc] == 0){
+            analysis->safe[pc] = true;
+            analysis->nSafe++;
+        }
+    }
+    analysis->allSafe = !analysis->selfModifying && analysis->nSafe == analysis->nChecked;
+
+    free(taken);
+    free(cur);
+    free(state);
+}
@@ -0,0 +1,385 @@
+//================================================
+//
+// libhatchling: the multi-core machine. See
+// hatchling.h.
+//
+//================================================
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "hatchling.h"
+
+//================================================
+// multi-core mode. Shared words are read and
+// written with relaxed atomics, which cost no
+// more than plain accesses, FADD and CAS are
+// sequentially consistent read-modify-writes,
+// and a barrier orders everything before it
+// against everything after it.
+//================================================
+#define CORE_READ(a)        ((a) >= CORE_LOCAL ? local[(a) - CORE_LOCAL] : __atomic_load_n(&mem[(a)], __ATOMIC_RELAXED))
+#define CORE_WRITE(a, v)    do{ if((a) >= CORE_LOCAL){ local[(a) - CORE_LOCAL] = (v); }                      \
+                                else{ __atomic_store_n(&mem[(a)], (v), __ATOMIC_RELAXED); } }while(0)
+
+//================================================
+// lets every core waiting at the barrier go on,
+// called with the lock held
+//================================================
+static void coreRelease(Multicore *m){
+    m->arrived = 0;
+    m->generation++;
+    for(int i = 0; i < m->nCores; i++){
+        m->cores[i].waiting = false;
+    }
+    pthread_cond_broadcast(&m->released);
+}
+
+//================================================
+// a core reached a BARR. On its own thread it
+// waits here for the others. Under the
+// deterministic scheduler it's only marked as
+// waiting and the scheduler passes over it until
+// the last core arrives. Returns false if the
+// machine was stopped meanwhile.
+//================================================
+static bool coreArrive(Multicore *m, Core *c){
+    pthread_mutex_lock(&m->lock);
+    unsigned long long generation = m->generation;
+    c->waiting = true;
+    if(++m->arrived == m->live){
+        coreRelease(m);
+    }
+    else if(m->threaded){
+        while(generation == m->generation && !atomic_load(&m->stop)){
+            pthread_cond_wait(&m->released, &m->lock);
+        }
+    }
+    pthread_mutex_unlock(&m->lock);
+    return !atomic_load(&m->stop);
+}
+
+//================================================
+// a core stopped: the barrier no longer waits for
+// it, and if it failed every other core stops
+//================================================
+static void coreFinish(Multicore *m, Core *c){
+    pthread_mutex_lock(&m->lock);
+    m->live--;
+    if(c->status != HML_HALTED){
+        atomic_store(&m->stop, true);
+        pthread_cond_broadcast(&m->released);
+    }
+    else if(m->live && m->arrived == m->live){
+        coreRelease(m);
+    }
+    pthread_mutex_unlock(&m->lock);
+}
+
+//================================================
+// runs one core for up to limit steps (none when
+// limit is 0). Returns HML_OK when the limit is
+// up or the core is waiting at a barrier,
+// otherwise why the core stopped: HML_LIMIT when
+// it ran out of steps or another core stopped
+// the machine. The instructions are
+// hmlExecute()'s on shared and local words, plus
+// the multi-core ones.
+//================================================
+static HmlStatus coreRun(Multicore *m, Core *c, unsigned long long limit){
+    unsigned short *mem = m->mem;
+    unsigned short *local = c->local;
+    Hatchling *regs = &c->regs;
+    signed short acc = regs->accumulator;
+    unsigned char pc = regs->instructCntr;
+    unsigned short word = regs->instructReg;
+    unsigned long long budget = m->maxSteps ? m->maxSteps - c->steps : ~0ULL;
+    unsigned long long n = 0;
+    HmlStatus status = HML_OK;
+
+    while(!limit || n < limit){
+        if(n == budget || atomic_load_explicit(&m->stop, memory_order_relaxed)){
+            status = HML_LIMIT;
+            break;
+        }
+        word = __atomic_load_n(&mem[pc], __ATOMIC_RELAXED);
+        unsigned char a = word & 0xFF;
+        n++;
+        switch(word >> 8){
+            case ADD:
+            {
+                int sum = acc + (signed short)CORE_READ(a);
+                if(sum < -32768 || sum > 32767){
+                    status = HML_OVERFLOW;
+                    goto stop;
+                }
+                acc = sum;
+                break;
+            }
+            case SUB:
+            {
+                int diff = acc - (signed short)CORE_READ(a);
+                if(diff < -32768 || diff > 32767){
+                    status = HML_OVERFLOW;
+                    goto stop;
+                }
+                acc = diff;
+                break;
+            }
+            case MUL:
+            {
+                int prod = acc * (signed short)CORE_READ(a);
+                if(prod < -32768 || prod > 32767){
+                    status = HML_OVERFLOW;
+                    goto stop;
+                }
+                acc = prod;
+                break;
+            }
+            case DIV:
+            case MOD:
+            {
+                signed short d = CORE_READ(a);
+                if(d == 0){
+                    status = HML_DIVIDE_BY_ZERO;
+                    goto stop;
+                }
+                int r = (word >> 8) == DIV ? acc / d : acc % d;
+                if(r < -32768 || r > 32767){
+                    status = HML_OVERFLOW;
+                    goto stop;
+                }
+                acc = r;
+                break;
+            }
+            case AND:
+                acc &= CORE_READ(a);
+                break;
+            case ORR:
+                acc |= CORE_READ(a);
+                break;
+            case NOT:
+                acc = !acc;
+                break;
+            case XOR:
+                acc ^= CORE_READ(a);
+                break;
+            case LSR:
+                acc = acc >> 1;
+                break;
+            case ASR:
+                acc = acc < 0 ? ~(~acc >> 1) : acc >> 1;
+                break;
+            case LSL:
+                acc = acc << 1;
+                break;
+            case B:
+                pc = a;
+                continue;
+            case BNEG:
+                if(acc < 0){
+                    pc = a;
+                    continue;
+                }
+                break;
+            case BPOS:
+                if(acc > 0){
+                    pc = a;
+                    continue;
+                }
+                break;
+            case BZRO:
+                if(acc == 0){
+                    pc = a;
+                    continue;
+                }
+                break;
+            case LOAD:
+                acc = (signed short)CORE_READ(a);
+                break;
+            case STOR:
+                CORE_WRITE(a, acc);
+                break;
+            case READ:
+            {
+                long dat;
+                pthread_mutex_lock(&m->ioLock);
+                HmlStatus got = regs->read ? regs->read(regs, &dat) : HML_END_OF_INPUT;
+                if(got == HML_OK && (dat < -32768 || dat > 32767)){
+                    if(m->report){
+                        m->report(regs, HML_BAD_INPUT);
+                    }
+                    pthread_mutex_unlock(&m->ioLock);
+                    continue;
+                }
+                pthread_mutex_unlock(&m->ioLock);
+                if(got != HML_OK){
+                    status = HML_END_OF_INPUT;
+                    goto stop;
+                }
+                CORE_WRITE(a, (signed short)dat);
+                break;
+            }
+            case WRTE:
+                if(regs->write){
+                    pthread_mutex_lock(&m->ioLock);
+                    regs->write(regs, (signed short)CORE_READ(a));
+                    pthread_mutex_unlock(&m->ioLock);
+                }
+                break;
+            case FADD:
+                if(a >= CORE_LOCAL){
+                    unsigned short old = local[a - CORE_LOCAL];
+                    local[a - CORE_LOCAL] = old + acc;
+                    acc = old;
+                }
+                else{
+                    acc = __atomic_fetch_add(&mem[a], (unsigned short)acc, __ATOMIC_SEQ_CST);
+                }
+                break;
+            case CAS:
+            {
+                unsigned short old = acc;
+                if(a >= CORE_LOCAL){
+                    old = local[a - CORE_LOCAL];
+                    if(old == (unsigned short)acc){
+                        local[a - CORE_LOCAL] = local[CAS_NEW - CORE_LOCAL];
+                    }
+                }
+                else{
+                    __atomic_compare_exchange_n(&mem[a], &old, local[CAS_NEW - CORE_LOCAL], false,
+                                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+                }
+                acc = old;
+                break;
+            }
+            case CORE:
+                acc = c->id;
+                break;
+            case NCOR:
+                acc = m->nCores;
+                break;
+            case BARR:
+                pc++;
+                if(!coreArrive(m, c)){
+                    status = HML_LIMIT;
+                    goto stop;
+                }
+                if(!m->threaded){
+                    goto stop;
+                }
+                continue;
+            case HALT:
+                status = HML_HALTED;
+                goto stop;
+            default:
+                status = HML_UNDEFINED_OPCODE;
+                goto stop;
+        }
+        pc++;
+    }
+
+stop:
+    regs->accumulator = acc;
+    regs->instructCntr = pc;
+    regs->instructReg = word;
+    regs->opCode = word >> 8;
+    regs->operand = word & 0xFF;
+    regs->fatalError = status != HML_OK && status != HML_HALTED;
+    c->steps += n;
+    return status;
+}
+
+static void *coreThread(void *arg){
+    Core *c = arg;
+    c->status = coreRun(c->machine, c, 0);
+    coreFinish(c->machine, c);
+    return NULL;
+}
+
+//================================================
+// the deterministic scheduler: every running
+// core that isn't waiting at a barrier gets
+// quantum steps in turn, in core order, so a
+// run always interleaves the same way
+//================================================
+static void scheduleCores(Multicore *m, int quantum){
+    int running = m->nCores;
+    while(running > 0 && !atomic_load(&m->stop)){
+        bool ran = false;
+        for(int i = 0; i < m->nCores && !atomic_load(&m->stop); i++){
+            Core *c = &m->cores[i];
+            if(c->status != HML_OK || c->waiting){
+                continue;
+            }
+            ran = true;
+            c->status = coreRun(m, c, quantum);
+            if(c->status != HML_OK){
+                coreFinish(m, c);
+                running--;
+            }
+        }
+        if(!ran){
+            break;
+        }
+    }
+}
+
+//================================================
+// sets up nCores cores on a loaded program, all
+// starting at its first word with their local
+// words copied from it and its I/O. Every core
+// gets maxSteps steps (none when 0).
+//================================================
+Multicore *hmlCoresCreate(const Hatchling *prog, int nCores, bool deterministic, unsigned long long maxSteps, HmlReportFn report){
+    Multicore *m = calloc(1, sizeof(Multicore));
+    m->cores = aligned_alloc(64, nCores * sizeof(Core));
+    memset(m->cores, 0, nCores * sizeof(Core));
+    memcpy(m->mem, prog->mem, sizeof(m->mem));
+    m->nCores = nCores;
+    m->live = nCores;
+    m->threaded = !deterministic;
+    m->maxSteps = maxSteps;
+    m->report = report;
+    atomic_init(&m->stop, false);
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->released, NULL);
+    pthread_mutex_init(&m->ioLock, NULL);
+    for(int i = 0; i < nCores; i++){
+        Core *c = &m->cores[i];
+        hmlInit(&c->regs);
+        hmlSetIo(&c->regs, prog->read, prog->write, prog->in, prog->out);
+        c->regs.instructCntr = prog->instructCntr;
+        memcpy(c->local, &prog->mem[CORE_LOCAL], sizeof(c->local));
+        c->id = i;
+        c->status = HML_OK;
+        c->machine = m;
+    }
+    return m;
+}
+
+void hmlCoresDestroy(Multicore *m){
+    pthread_mutex_destroy(&m->lock);
+    pthread_cond_destroy(&m->released);
+    pthread_mutex_destroy(&m->ioLock);
+    free(m->cores);
+    free(m);
+}
+
+//================================================
+// runs every core to the end, on threads or
+// under the deterministic scheduler with
+// quantum steps a turn
+//================================================
+void hmlCoresRun(Multicore *m, int quantum){
+    if(!m->threaded){
+        scheduleCores(m, quantum);
+        return;
+    }
+    for(int i = 0; i < m->nCores; i++){
+        pthread_create(&m->cores[i].thread, NULL, coreThread, &m->cores[i]);
+    }
+    for(int i = 0; i < m->nCores; i++){
+        pthread_join(m->cores[i].thread, NULL);
+    }
+}
@@ -0,0 +1,742 @@
+//================================================
+//
+// libhatchling: loading and running Hatchling
+// programs. See hatchling.h.
+//
+//================================================
+#include <stdlib.h>
+#include <string.h>
+#include "hatchling.h"
+#include "semantics.h"
+
+//================================================
+// allocates a new, empty context
+//================================================
+Hatchling *hmlCreate(void){
+    Hatchling *hatchling = malloc(sizeof(Hatchling));
+    if(hatchling){
+        hmlInit(hatchling);
+    }
+    return hatchling;
+}
+
+//================================================
+// sets up a context in storage the caller owns:
+// empty memory, cleared registers and no I/O
+//================================================
+void hmlInit(Hatchling *hatchling){
+    memset(hatchling, 0, sizeof(Hatchling));
+    hatchling->stop = TERM_HALT;
+}
+
+//================================================
+// clears memory and registers for the next
+// program, keeping the context's I/O
+//================================================
+void hmlReset(Hatchling *hatchling){
+    HmlReadFn read = hatchling->read;
+    HmlWriteFn write = hatchling->write;
+    void *in = hatchling->in;
+    void *out = hatchling->out;
+    hmlInit(hatchling);
+    hmlSetIo(hatchling, read, write, in, out);
+}
+
+void hmlDestroy(Hatchling *hatchling){
+    free(hatchling);
+}
+
+//================================================
+// installs the READ/WRTE callbacks and the
+// input and output they're handed
+//================================================
+void hmlSetIo(Hatchling *hatchling, HmlReadFn read, HmlWriteFn write, void *in, void *out){
+    hatchling->read = read;
+    hatchling->write = write;
+    hatchling->in = in;
+    hatchling->out = out;
+}
+
+//================================================
+// context pools
+//================================================
+HmlPool *hmlPoolCreate(int size){
+    HmlPool *pool = malloc(sizeof(HmlPool));
+    if(pool == NULL){
+        return NULL;
+    }
+    pool->contexts = malloc(size * sizeof(Hatchling));
+    pool->free = malloc(size * sizeof(Hatchling *));
+    if(pool->contexts == NULL || pool->free == NULL){
+        free(pool->contexts);
+        free(pool->free);
+        free(pool);
+        return NULL;
+    }
+    pool->size = size;
+    pool->nFree = size;
+    for(int i = 0; i < size; i++){
+        pool->free[i] = &pool->contexts[size - 1 - i];
+    }
+    return pool;
+}
+
+//================================================
+// hands out an initialized context, or NULL when
+// every context is in use
+//================================================
+Hatchling *hmlPoolAcquire(HmlPool *pool){
+    if(pool->nFree == 0){
+        return NULL;
+    }
+    Hatchling *hatchling = pool->free[--pool->nFree];
+    hmlInit(hatchling);
+    return hatchling;
+}
+
+void hmlPoolRelease(HmlPool *pool, Hatchling *hatchling){
+    pool->free[pool->nFree++] = hatchling;
+}
+
+void hmlPoolDestroy(HmlPool *pool){
+    free(pool->contexts);
+    free(pool->free);
+    free(pool);
+}
+
+//================================================
+// loads a program from the contents of a .hml,
+// .hmb or .hmc file, telling them apart by the
+// binary magic numbers. Containers hold more
+// than one program, so they aren't loaded.
+//================================================
+HmlStatus hmlLoad(Hatchling *hatchling, const char *data, size_t len, unsigned long *detail){
+    if(len >= 4 && memcmp(data, IMAGE_MAGIC, 4) == 0){
+        if(len < sizeof(ProgramImage)){
+            hmlReset(hatchling);
+            hatchling->fatalError = true;
+            if(detail){
+                *detail = len;
+            }
+            return HML_TRUNCATED_IMAGE;
+        }
+        return hmlLoadImage(hatchling, (const ProgramImage *)data);
+    }
+    const ContainerHeader *hdr = hmlAsContainer(data, len);
+    if(hdr){
+        hmlReset(hatchling);
+        hatchling->fatalError = true;
+        if(detail){
+            *detail = LE32(hdr->count);
+        }
+        return HML_CONTAINER;
+    }
+    return hmlLoadText(hatchling, data, len, detail);
+}
+
+//================================================
+// returns the container header if the data is a
+// multi-program container, NULL otherwise
+//================================================
+const ContainerHeader *hmlAsContainer(const char *data, size_t len){
+    const ContainerHeader *hdr = (const ContainerHeader *)data;
+    if(len < sizeof(ContainerHeader) || memcmp(hdr->magic, CONTAINER_MAGIC, 4) != 0){
+        return NULL;
+    }
+    return hdr;
+}
+
+//================================================
+// loads a binary program image, which is used
+// in place: the words are copied straight into
+// memory with no parsing
+//================================================
+HmlStatus hmlLoadImage(Hatchling *hatchling, const ProgramImage *image){
+    hmlReset(hatchling);
+    if(memcmp(image->magic, IMAGE_MAGIC, 4) != 0 || LE16(image->version) != IMAGE_VERSION){
+        hatchling->fatalError = true;
+        return HML_BAD_IMAGE;
+    }
+    memcpy(hatchling->mem, image->words, sizeof(hatchling->mem));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for(int i = 0; i < 256; i++){
+        hatchling->mem[i] = LE16(hatchling->mem[i]);
+    }
+#endif
+    if(LE16(image->flags) & IMAGE_HAS_ENTRY){
+        hatchling->instructCntr = image->entry;
+    }
+    return HML_OK;
+}
+
+//================================================
+// value of each character as a hex digit with
+// 0x10 set, 0 for anything that isn't one
+//================================================
+const unsigned char hexDigit[256] = {
+    ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+    ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+    ['A'] = 0x1A, ['B'] = 0x1B, ['C'] = 0x1C, ['D'] = 0x1D, ['E'] = 0x1E, ['F'] = 0x1F,
+    ['a'] = 0x1A, ['b'] = 0x1B, ['c'] = 0x1C, ['d'] = 0x1D, ['e'] = 0x1E, ['f'] = 0x1F
+};
+
+//================================================
+// parses .hml text already in memory. Words are
+// split exactly the way fgets(line, 6, f) split
+// them (at most 5 characters, ending after a
+// newline) so numbering of bad lines is
+// unchanged. The common "XXXX\n" word is decoded
+// with four table lookups, anything else goes
+// through strtol() like before.
+//================================================
+HmlStatus hmlLoadText(Hatchling *hatchling, const char *text, size_t len, unsigned long *detail){
+    hmlReset(hatchling);
+    size_t pos = 0;
+    int i = 0;
+    while(pos < len){
+        long ins;
+        const unsigned char *w = (const unsigned char *)text + pos;
+
+        if(len - pos >= 5 && w[4] == '\n' && (hexDigit[w[0]] & hexDigit[w[1]] & hexDigit[w[2]] & hexDigit[w[3]] & 0x10)){
+            ins = (hexDigit[w[0]] & 0xF) << 12 | (hexDigit[w[1]] & 0xF) << 8 | (hexDigit[w[2]] & 0xF) << 4 | (hexDigit[w[3]] & 0xF);
+            pos += 5;
+        }
+        else{
+            char line[6];
+            int n = 0;
+            while(n < 5 && pos < len){
+                line[n] = text[pos++];
+                if(line[n++] == '\n'){
+                    break;
+                }
+            }
+            line[n] = '\0';
+
+            //converts line into a base-16 number
+            ins = strtol(line,NULL,16);
+        }
+
+        //checks for valid instruction words
+        if(ins < 0x0000 || ins > 0xFFFF){
+            if(detail){
+                *detail = i;
+            }
+            hatchling->fatalError = true;
+            return HML_BAD_WORD;
+        }
+        if(i == 256){
+            hatchling->fatalError = true;
+            return HML_TOO_LONG;
+        }
+
+        hatchling->mem[i] = (unsigned short) ins;
+        i++;
+    }
+    return HML_OK;
+}
+
+//================================================
+// executes the instruction already fetched into
+// the instruction register, which is determined
+// by the Hatchling's opCode, and manipulates the
+// Hatchling program instance's state
+// accordingly. The instructions come from
+// HML_SEMANTICS in semantics.h, the same list
+// the threaded engines are built from. A fatal
+// error sets fatalError and leaves the
+// registers as they were.
+//================================================
+#define OVERFLOW_CHECK(r)   if((r) < -32768 || (r) > 32767){ status = HML_OVERFLOW; goto fatal; }
+#define ZERO_CHECK(d)       if((d) == 0){ status = HML_DIVIDE_BY_ZERO; goto fatal; }
+#define JUMP(t)             { hatchling->accumulator = acc; hatchling->instructCntr = (t); return HML_OK; }
+#define READ_WORD(a)        HML_READ_WORD(a, return HML_BAD_INPUT)
+#define STORED(a)
+#define EXECUTE_CASE(op, body)  case op: body break;
+
+HmlStatus hmlExecute(Hatchling *hatchling){
+    unsigned short *mem = hatchling->mem;
+    signed short acc = hatchling->accumulator;
+    unsigned char a = hatchling->operand;
+    HmlStatus status;
+
+    switch(hatchling->opCode){
+        HML_SEMANTICS(EXECUTE_CASE)
+
+        case HALT:
+            //do nothing here, the caller handles program behavior
+            return HML_HALTED;
+
+        default:
+            //halts program if we reach undefined opcode
+            status = HML_UNDEFINED_OPCODE;
+            goto fatal;
+    }
+    hatchling->accumulator = acc;
+    hatchling->instructCntr++;
+    return HML_OK;
+
+fatal:
+    hatchling->fatalError = true;
+    return status;
+}
+
+#undef OVERFLOW_CHECK
+#undef ZERO_CHECK
+#undef JUMP
+#undef READ_WORD
+#undef STORED
+#undef EXECUTE_CASE
+
+//================================================
+// fetches the instruction at the instruction
+// counter and executes it
+//================================================
+HmlStatus hmlStep(Hatchling *hatchling){
+    //a stopped program stays stopped
+    if(hatchling->fatalError){
+        switch(hmlTermination(hatchling)){
+            case TERM_OVERFLOW:         return HML_OVERFLOW;
+            case TERM_DIVIDE_BY_ZERO:   return HML_DIVIDE_BY_ZERO;
+            case TERM_UNDEFINED_OPCODE: return HML_UNDEFINED_OPCODE;
+            case TERM_END_OF_INPUT:     return HML_END_OF_INPUT;
+            default:                    return HML_LIMIT;
+        }
+    }
+    hatchling->instructReg = hatchling->mem[hatchling->instructCntr];
+    hatchling->opCode = hatchling->instructReg >> 8;
+    hatchling->operand = hatchling->instructReg & 0xFF;
+    return hmlExecute(hatchling);
+}
+
+//================================================
+// runs until HALT, a fatal error, or limit
+// instructions (none when limit is 0). The
+// number of instructions run is added to steps.
+//================================================
+HmlStatus hmlRun(Hatchling *hatchling, unsigned long long limit, unsigned long long *steps){
+    unsigned long long n = 0;
+    HmlStatus status = HML_OK;
+    while(status == HML_OK || status == HML_BAD_INPUT){
+        if(limit && n == limit){
+            status = HML_LIMIT;
+            break;
+        }
+        status = hmlStep(hatchling);
+        n++;
+    }
+    if(steps){
+        *steps += n;
+    }
+    return status;
+}
+
+//================================================
+// works out why a stopped program stopped from
+// the instruction it stopped on
+//================================================
+Termination hmlTermination(const Hatchling *hatchling){
+    if(hatchling->stop != TERM_HALT){
+        return hatchling->stop;
+    }
+    if(!hatchling->fatalError){
+        return TERM_HALT;
+    }
+    switch(hatchling->opCode){
+        case ADD:
+        case SUB:
+        case MUL:
+            return TERM_OVERFLOW;
+        case DIV:
+        case MOD:
+            return hatchling->mem[hatchling->operand] == 0 ? TERM_DIVIDE_BY_ZERO : TERM_OVERFLOW;
+        case READ:
+            return TERM_END_OF_INPUT;
+        default:
+            return TERM_UNDEFINED_OPCODE;
+    }
+}
+
+//================================================
+// short upper-case name of a status for logs
+// and reports
+//================================================
+const char *hmlStatusName(HmlStatus status){
+    static const char *const names[] = {"OK", "HALTED", "OVERFLOW", "DIVIDE_BY_ZERO", "UNDEFINED_OPCODE",
+        "END_OF_INPUT", "BAD_INPUT", "LIMIT", "BAD_WORD", "TOO_LONG", "BAD_IMAGE", "TRUNCATED_IMAGE", "CONTAINER"};
+    if((unsigned)status >= sizeof(names) / sizeof(names[0])){
+        return "UNKNOWN";
+    }
+    return names[status];
+}
+
+//================================================
+// extended addressing. Addresses are split into
+// a first-level table index, an entry in that
+// table and the word in the page.
+//================================================
+#define WIDE_TABLE(a)   ((a) >> (HML_PAGE_BITS + HML_TABLE_BITS))
+#define WIDE_ENTRY(a)   (((a) >> HML_PAGE_BITS) & ((1 << HML_TABLE_BITS) - 1))
+#define WIDE_OFFSET(a)  ((a) & ((1 << HML_PAGE_BITS) - 1))
+#define WIDE_PAGE(s, a) ((s)->tables[WIDE_TABLE(a)][WIDE_ENTRY(a)])
+#define WIDE_WORD(s, a) (WIDE_PAGE(s, a)[WIDE_OFFSET(a)])
+
+//the page every word no one has written reads from
+static const unsigned short zeroPage[1 << HML_PAGE_BITS] __attribute__((aligned(HML_PAGE_ALIGN)));
+
+//================================================
+// allocates an extended context with an empty
+// address space of addressBits (8 to 24) bits
+//================================================
+HmlWide *hmlWideCreate(int addressBits){
+    if(addressBits < HML_PAGE_BITS || addressBits > HML_MAX_BITS){
+        return NULL;
+    }
+    HmlWide *wide = calloc(1, sizeof(HmlWide));
+    if(wide == NULL){
+        return NULL;
+    }
+    hmlInit(&wide->core);
+    HmlSpace *space = &wide->space;
+    space->mask = (1u << addressBits) - 1;
+    for(int i = 0; i < 1 << HML_TABLE_BITS; i++){
+        space->zeroTable[i] = (unsigned short *)zeroPage;
+    }
+    for(size_t i = 0; i < sizeof(space->tables) / sizeof(space->tables[0]); i++){
+        space->tables[i] = space->zeroTable;
+    }
+    return wide;
+}
+
+void hmlWideDestroy(HmlWide *wide){
+    if(wide == NULL){
+        return;
+    }
+    HmlSpace *space = &wide->space;
+    for(size_t i = 0; i < sizeof(space->tables) / sizeof(space->tables[0]); i++){
+        if(space->tables[i] == space->zeroTable){
+            continue;
+        }
+        for(int j = 0; j < 1 << HML_TABLE_BITS; j++){
+            if(space->tables[i][j] != zeroPage){
+                free(space->tables[i][j]);
+            }
+        }
+        free(space->tables[i]);
+    }
+    free(wide);
+}
+
+//================================================
+// the word at addr for reading, unwritten words
+// read as 0
+//================================================
+unsigned short hmlSpaceRead(const HmlSpace *space, unsigned int addr){
+    addr &= space->mask;
+    return WIDE_WORD(space, addr);
+}
+
+//================================================
+// the word at addr for writing, allocating its
+// table and page if this is the first write to
+// them. If they can't be allocated, failed is
+// set and the write goes to the space's own
+// scratch word.
+//================================================
+unsigned short *hmlSpaceWord(HmlSpace *space, unsigned int addr){
+    addr &= space->mask;
+    unsigned short ***table = &space->tables[WIDE_TABLE(addr)];
+    if(*table == space->zeroTable){
+        unsigned short **fresh = malloc(sizeof(space->zeroTable));
+        if(fresh == NULL){
+            space->failed = true;
+            return &space->scratch;
+        }
+        memcpy(fresh, space->zeroTable, sizeof(space->zeroTable));
+        *table = fresh;
+        space->nTables++;
+    }
+    unsigned short **entry = &(*table)[WIDE_ENTRY(addr)];
+    if(*entry == zeroPage){
+        size_t size = sizeof(unsigned short) << HML_PAGE_BITS;
+        unsigned short *page = aligned_alloc(HML_PAGE_ALIGN, size);
+        if(page == NULL){
+            space->failed = true;
+            return &space->scratch;
+        }
+        memset(page, 0, size);
+        *entry = page;
+        space->pages++;
+    }
+    return &(*entry)[WIDE_OFFSET(addr)];
+}
+
+//================================================
+// the words of a page, NULL if it was never
+// written and is all zeros
+//================================================
+const unsigned short *hmlSpacePage(const HmlSpace *space, unsigned int page){
+    unsigned int addr = (page << HML_PAGE_BITS) & space->mask;
+    const unsigned short *words = WIDE_PAGE(space, addr);
+    return words == zeroPage ? NULL : words;
+}
+
+//================================================
+// parses extended .hml text into a new context:
+// one hex word per line like .hml, loaded from
+// address 0, where a line "@ADDRESS" moves the
+// rest of the words to a new hex address. An
+// empty line loads a 0 word, like it does in
+// the 256-word loader. A line too long to hold
+// a word or an address is HML_BAD_WORD, with
+// its line number in detail.
+//================================================
+HmlStatus hmlWideLoadText(HmlWide *wide, const char *text, size_t len, unsigned long *detail){
+    HmlSpace *space = &wide->space;
+    unsigned long line = 0;
+    unsigned long addr = 0;
+    size_t pos = 0;
+    bool bad = false;
+    for(; pos < len && !bad; line++){
+        const char *start = text + pos;
+        const char *nl = memchr(start, '\n', len - pos);
+        size_t n = nl ? (size_t)(nl - start) : len - pos;
+        pos += n + (nl != NULL);
+
+        //cutting a long line short could turn garbage into a word, so it doesn't load
+        char buf[16];
+        if(n >= sizeof(buf)){
+            bad = true;
+            continue;
+        }
+        memcpy(buf, start, n);
+        buf[n] = '\0';
+
+        if(buf[0] == '@'){
+            char *end;
+            addr = strtoul(buf + 1, &end, 16);
+            bad = end == buf + 1 || addr > space->mask;
+            continue;
+        }
+
+        long ins = strtol(buf, NULL, 16);
+        if(ins < 0x0000 || ins > 0xFFFF){
+            bad = true;
+            continue;
+        }
+        if(addr > space->mask){
+            wide->core.fatalError = true;
+            return HML_TOO_LONG;
+        }
+        *hmlSpaceWord(space, addr++) = (unsigned short)ins;
+    }
+    if(bad){
+        if(detail){
+            *detail = line - 1;
+        }
+        wide->core.fatalError = true;
+        return HML_BAD_WORD;
+    }
+    return HML_OK;
+}
+
+//================================================
+// stores v at addr, going through hmlSpaceWord()
+// only when the page isn't there yet
+//================================================
+#define WIDE_STORE(s, a, v) do{ unsigned short *page_ = WIDE_PAGE(s, a);                      \
+                                if(page_ == zeroPage){ *hmlSpaceWord(s, a) = (v); }           \
+                                else{ page_[WIDE_OFFSET(a)] = (v); } }while(0)
+
+//================================================
+// runs an extended context until HALT, a fatal
+// error, a READ of a value out of range, or
+// limit instructions (none when limit is 0).
+// Prefix words count as instructions. The
+// semantics are hmlExecute()'s with wide
+// addresses: the registers live in locals and
+// are written back when the run stops, where
+// the status is also kept. HML_BAD_INPUT leaves
+// the READ to run again on the next call.
+//================================================
+HmlStatus hmlWideRun(HmlWide *wide, unsigned long long limit, unsigned long long *steps){
+    Hatchling *core = &wide->core;
+    if(core->fatalError){
+        return wide->status;
+    }
+    HmlSpace *space = &wide->space;
+    const unsigned int mask = space->mask;
+    signed short acc = core->accumulator;
+    unsigned int pc = wide->instructCntr;
+    unsigned int ext = wide->extend;
+    unsigned short word = core->instructReg;
+    unsigned int addr = wide->operand;
+    unsigned long long n = 0;
+    HmlStatus status = HML_LIMIT;
+
+    while(!limit || n < limit){
+        word = WIDE_WORD(space, pc);
+        addr = (ext | (word & 0xFF)) & mask;
+        n++;
+        switch(word >> 8){
+            case EXT:
+                ext = (ext & 0xFF0000) | (word & 0xFF) << 8;
+                pc = (pc + 1) & mask;
+                continue;
+            case EXTH:
+                ext = (ext & 0x00FF00) | (word & 0xFF) << 16;
+                pc = (pc + 1) & mask;
+                continue;
+            case ADD:
+            {
+                int sum = acc + (signed short)WIDE_WORD(space, addr);
+                if(sum < -32768 || sum > 32767){
+                    status = HML_OVERFLOW;
+                    goto fatal;
+                }
+                acc = sum;
+                break;
+            }
+            case SUB:
+            {
+                int diff = acc - (signed short)WIDE_WORD(space, addr);
+                if(diff < -32768 || diff > 32767){
+                    status = HML_OVERFLOW;
+                    goto fatal;
+                }
+                acc = diff;
+                break;
+            }
+            case MUL:
+            {
+                int prod = acc * (signed short)WIDE_WORD(space, addr);
+                if(prod < -32768 || prod > 32767){
+                    status = HML_OVERFLOW;
+                    goto fatal;
+                }
+                acc = prod;
+                break;
+            }
+            case DIV:
+            case MOD:
+            {
+                signed short d = WIDE_WORD(space, addr);
+                if(d == 0){
+                    status = HML_DIVIDE_BY_ZERO;
+                    goto fatal;
+                }
+                int r = (word >> 8) == DIV ? acc / d : acc % d;
+                if(r < -32768 || r > 32767){
+                    status = HML_OVERFLOW;
+                    goto fatal;
+                }
+                acc = r;
+                break;
+            }
+            case AND:
+                acc &= WIDE_WORD(space, addr);
+                break;
+            case ORR:
+                acc |= WIDE_WORD(space, addr);
+                break;
+            case NOT:
+                acc = !acc;
+                break;
+            case XOR:
+                acc ^= WIDE_WORD(space, addr);
+                break;
+            case LSR:
+                acc = acc >> 1;
+                break;
+            case ASR:
+                acc = acc < 0 ? ~(~acc >> 1) : acc >> 1;
+                break;
+            case LSL:
+                acc = acc << 1;
+                break;
+            case B:
+                pc = addr;
+                ext = 0;
+                continue;
+            case BNEG:
+                if(acc < 0){
+                    pc = addr;
+                    ext = 0;
+                    continue;
+                }
+                break;
+            case BPOS:
+                if(acc > 0){
+                    pc = addr;
+                    ext = 0;
+                    continue;
+                }
+                break;
+            case BZRO:
+                if(acc == 0){
+                    pc = addr;
+                    ext = 0;
+                    continue;
+                }
+                break;
+            case LOAD:
+                acc = (signed short)WIDE_WORD(space, addr);
+                break;
+            case STOR:
+                WIDE_STORE(space, addr, acc);
+                break;
+            case READ:
+            {
+                long dat;
+                core->accumulator = acc;
+                if(core->read == NULL || core->read(core, &dat) != HML_OK){
+                    status = HML_END_OF_INPUT;
+                    goto fatal;
+                }
+                if(dat < -32768 || dat > 32767){
+                    status = HML_BAD_INPUT;
+                    goto stop;
+                }
+                WIDE_STORE(space, addr, (signed short)dat);
+                break;
+            }
+            case WRTE:
+                if(core->write){
+                    core->write(core, (signed short)WIDE_WORD(space, addr));
+                }
+                break;
+            case HALT:
+                status = HML_HALTED;
+                goto stop;
+            default:
+                status = HML_UNDEFINED_OPCODE;
+                goto fatal;
+        }
+        pc = (pc + 1) & mask;
+        ext = 0;
+    }
+    goto stop;
+
+fatal:
+    core->fatalError = true;
+stop:
+    core->accumulator = acc;
+    core->instructReg = word;
+    core->opCode = word >> 8;
+    core->operand = word & 0xFF;
+    wide->instructCntr = pc;
+    wide->operand = addr;
+    wide->extend = ext;
+    wide->status = status;
+    if(steps){
+        *steps += n;
+    }
+    return status;
+}
+
+//================================================
+// runs one instruction of an extended context
+//================================================
+HmlStatus hmlWideStep(HmlWide *wide){
+    HmlStatus status = hmlWideRun(wide, 1, NULL);
+    return status == HML_LIMIT ? HML_OK : status;
+}
@@ -0,0 +1,426 @@
+//================================================
+//
+// libhatchling: the Hatchling machine as a
+// library. Contexts are reentrant and share no
+// state, the core does no stdio and never exits
+// the process: READ and WRTE go through
+// callbacks and everything that goes wrong comes
+// back as a status code.
+//
+// The engines are part of the library too: the
+// threaded interpreter and its analysis, the
+// JIT, the SIMD lockstep lanes and the
+// multi-core machine. hmlsim is a front end
+// over them, `make` builds libhatchling.a and
+// hmlsim.
+//
+//================================================
+#ifndef HATCHLING_H
+#define HATCHLING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// ACC-MEM Arithmetic Instructions
+#define ADD     0x10    // Add a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
+#define SUB     0x11    // Subtract a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
+#define MUL     0x12    // Multiply a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
+#define DIV     0x13    // Divide a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
+#define MOD     0x14    // Compute the integer remainder when dividing a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
+
+// ACC-MEM Logical Instructions
+#define AND     0x20    // Compute the binary AND of a specific memory location and the accumulator (leave the result in the accumulator)
+#define ORR     0x21    // Compute the binary OR of a specific memory location and the accumulator (leave the result in the accumulator)
+#define NOT     0x22    // Compute the logical NOT of the accumulator (leave the result in the accumulator)
+#define XOR     0x23    // Compute the binary XOR of a specific memory location and the accumulator (leave the result in the accumulator)
+#define LSR     0x24    // Compute the binary logical shift right (1-bit) of the accumulator (leave the result in the accumulator)
+#define ASR     0x25    // Compute the binary arithmetic shift right (1-bit) of the accumulator (leave the result in the accumulator)
+#define LSL     0x26    // Compute the binary logical shift left of the accumulator (leave the result in the accumulator)
+
+// Branch Instructions
+#define B       0X30    // Branch to a specific location in memory
+#define BNEG    0X31    // Branch to a specific location in memory if the accumulator is negative
+#define BPOS    0X32    // Branch to a specific location in memory if the accumulator is positive
+#define BZRO    0X33    // Branch to a specific location in memory if the accumulator is zero
+
+// ACC-MEM Load/Store Instructions
+#define LOAD    0X40    // Load a word from a specific location in memory into the accumulator
+#define STOR    0X41    // Store a word from the accumulator into a specific memory location
+
+// I/O (Standard) Instructions
+#define READ    0X50    // Read a word from the terminal into a specific location in memory
+#define WRTE    0X51    // Write a word from a specific location in memory to the terminal
+
+// HALT Instruction
+#define HALT    0XFF   // Halt, i.e. the program has completed its task
+
+// Extended Addressing Prefixes (--address-bits only)
+#define EXT     0X60    // The operand becomes bits 8-15 of the next instruction's address
+#define EXTH    0X61    // The operand becomes bits 16-23 of the next instruction's address
+
+// Multi-core Instructions (--cores only)
+#define FADD    0X70    // Atomically add the accumulator to a specific memory location (leave the old word in the accumulator)
+#define CAS     0X71    // Atomically replace a specific memory location with the core's local word FF if it equals the accumulator (leave the old word in the accumulator)
+#define CORE    0X72    // Load the core's ID into the accumulator
+#define NCOR    0X73    // Load the number of cores into the accumulator
+#define BARR    0X74    // Wait until every running core has reached a BARR
+
+
+
+//================================================
+// why a program stopped running
+//================================================
+enum termination{
+    TERM_HALT,                      //reached a HALT instruction
+    TERM_OVERFLOW,                  //ACCUMULATOR OVERFLOW
+    TERM_DIVIDE_BY_ZERO,            //ATTEMPT TO DIVIDE BY ZERO
+    TERM_UNDEFINED_OPCODE,          //UNDEFINED HATCHLING OPCODE
+    TERM_END_OF_INPUT,              //READ with no input left
+    TERM_STEP_LIMIT,                //ran out of its step budget
+    TERM_TIME_LIMIT,                //ran out of its wall-clock budget
+    TERM_INFINITE_LOOP              //came back to a state it had already been in
+};
+typedef enum termination Termination;
+
+//================================================
+// what a library call did
+//================================================
+enum hmlStatus{
+    HML_OK,                         //loaded, or the instruction ran and the program goes on
+    HML_HALTED,                     //the instruction is HALT
+    HML_OVERFLOW,                   //fatal: the result doesn't fit in the accumulator
+    HML_DIVIDE_BY_ZERO,             //fatal: DIV or MOD by a zero word
+    HML_UNDEFINED_OPCODE,           //fatal: no such instruction
+    HML_END_OF_INPUT,               //fatal: READ had no input left
+    HML_BAD_INPUT,                  //READ got a value out of range, the READ runs again
+    HML_LIMIT,                      //hmlRun() used up its instruction limit
+    HML_BAD_WORD,                   //load: word out of range, detail is its line
+    HML_TOO_LONG,                   //load: more than 256 words
+    HML_BAD_IMAGE,                  //load: wrong image magic number or version
+    HML_TRUNCATED_IMAGE,            //load: image shorter than a full one, detail is its length
+    HML_CONTAINER                   //load: a multi-program container, detail is its program count
+};
+typedef enum hmlStatus HmlStatus;
+
+typedef struct hatchling Hatchling;
+
+//READ asks for the next value, returns HML_OK or HML_END_OF_INPUT; the core range-checks it
+typedef HmlStatus (*HmlReadFn)(Hatchling *hatchling, long *value);
+
+//WRTE hands over the value to write
+typedef void (*HmlWriteFn)(Hatchling *hatchling, signed short value);
+
+//engines running many contexts at once hand over a bad READ value or a fatal error as it happens
+typedef void (*HmlReportFn)(Hatchling *hatchling, HmlStatus status);
+
+//================================================
+// struct that holds all relevant information 
+// and memory for a Hatchling program
+//================================================
+struct hatchling{
+    signed short int accumulator;   //used to represent the accumulator register
+    unsigned short int instructReg; //used to store the instruction being performed
+    unsigned char instructCntr;     //keeps track of the location in memory that contains the instruction being performed
+    unsigned char opCode;           //upper byte of the instruction register
+    unsigned char operand;          //lower byte of the instruction register
+    unsigned short int mem[256];    //an array of 256 short int
+    bool fatalError;                //flags whether we've encoured a fatal error in the program
+    void *in;                       //input the READ callback reads from, owned by the caller
+    void *out;                      //output the WRTE callback writes to, owned by the caller
+    Termination stop;               //budget or loop check that stopped the run, TERM_HALT otherwise
+    HmlReadFn read;                 //READ callback, NULL reads as end of input
+    HmlWriteFn write;               //WRTE callback, NULL discards output
+};
+
+//================================================
+// binary program images (.hmb): a 16 byte header
+// followed by all 256 memory words. Multi-program
+// containers (.hmc) are a 16 byte header followed
+// by count images back to back. Every field is
+// little-endian so files can be mapped and used
+// in place.
+//================================================
+#define IMAGE_MAGIC       "HMLB"
+#define CONTAINER_MAGIC   "HMLC"
+#define IMAGE_VERSION     1
+#define IMAGE_HAS_ENTRY   0x0001    //the image sets the initial instruction counter
+
+struct programImage{
+    char magic[4];                  //IMAGE_MAGIC
+    unsigned short version;         //IMAGE_VERSION
+    unsigned short flags;           //IMAGE_HAS_ENTRY
+    unsigned char entry;            //initial instruction counter when IMAGE_HAS_ENTRY is set
+    unsigned char reserved[7];      //zero
+    unsigned short words[256];      //the memory image
+};
+typedef struct programImage ProgramImage;
+
+struct containerHeader{
+    char magic[4];                  //CONTAINER_MAGIC
+    unsigned short version;         //IMAGE_VERSION
+    unsigned short reserved;        //zero
+    unsigned int count;             //number of ProgramImages that follow
+    unsigned int reserved2;         //zero
+};
+typedef struct containerHeader ContainerHeader;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LE16(x) ((unsigned short)(((x) >> 8) | ((x) << 8)))
+#define LE32(x) __builtin_bswap32(x)
+#define LE64(x) __builtin_bswap64(x)
+#else
+#define LE16(x) (x)
+#define LE32(x) (x)
+#define LE64(x) (x)
+#endif
+
+//================================================
+// a fixed set of contexts handed out and taken
+// back without allocating. A pool isn't locked,
+// give each thread its own.
+//================================================
+struct hmlPool{
+    Hatchling *contexts;
+    Hatchling **free;
+    int size;
+    int nFree;
+};
+typedef struct hmlPool HmlPool;
+
+//================================================
+// extended addressing: a 16 or 24-bit address
+// space of 16-bit words. Addresses are the
+// 8-bit operand widened by the EXT and EXTH
+// prefix words in front of the instruction, so
+// the opcodes keep their encoding and a plain
+// program runs unchanged in page 0. Memory is a
+// two-level page table of cache-line aligned
+// pages, allocated the first time a word in them
+// is written. Every page never written is the
+// one shared zero page, and every table never
+// written is the space's zeroTable, so reads
+// need no checks and an empty space costs
+// nothing but the first level.
+//================================================
+#define HML_PAGE_BITS     8         //words per page, 2^n
+#define HML_TABLE_BITS    8         //pages per second-level table, 2^n
+#define HML_MAX_BITS      24        //widest address space
+#define HML_PAGE_ALIGN    64        //pages start on a cache line
+
+struct hmlSpace{
+    unsigned short **tables[1 << (HML_MAX_BITS - HML_PAGE_BITS - HML_TABLE_BITS)];
+    unsigned short *zeroTable[1 << HML_TABLE_BITS];    //table every unwritten table entry points at
+    unsigned int mask;              //addresses wrap to the space
+    size_t pages;                   //pages allocated
+    size_t nTables;                 //second-level tables allocated
+    bool failed;                    //a page couldn't be allocated, the write was dropped
+    unsigned short scratch;         //where dropped writes go
+};
+typedef struct hmlSpace HmlSpace;
+
+struct hmlWide{
+    Hatchling core;                 //accumulator, instruction register, opcode, fatalError and I/O; core.mem isn't used
+    unsigned int instructCntr;      //wide instruction counter
+    unsigned int operand;           //address of the last instruction, with its prefixes
+    unsigned int extend;            //address bits the pending EXT/EXTH prefixes set
+    HmlStatus status;               //why the last run stopped
+    HmlSpace space;
+};
+typedef struct hmlWide HmlWide;
+
+//================================================
+// what the load-time analysis proved about a
+// program, see hmlAnalyze()
+//================================================
+#define WORD_CODE       0x01        //an instruction the program can reach
+#define WORD_DATA       0x02        //a word a reachable instruction reads or writes
+#define MAY_OVERFLOW    0x01        //faults hmlAnalyze() couldn't rule out
+#define MAY_DIVIDE_ZERO 0x02
+
+struct interval{
+    int lo;
+    int hi;                         //lo > hi for no values at all
+};
+typedef struct interval Interval;
+
+struct analysis{
+    unsigned char kind[256];        //WORD_CODE | WORD_DATA, 0 for words nothing reaches
+    unsigned char faults[256];      //MAY_OVERFLOW | MAY_DIVIDE_ZERO for the instruction here
+    bool safe[256];                 //a reachable ADD/SUB/MUL/DIV/MOD proven not to fault
+    Interval acc[256];              //accumulator every time the instruction runs
+    Interval mem[256];              //values the word can hold while the program runs
+    bool selfModifying;             //a reachable STOR or READ writes into code, nothing is proven
+    bool allSafe;                   //every reachable ADD/SUB/MUL/DIV/MOD is safe
+    int nChecked;                   //reachable ADD/SUB/MUL/DIV/MOD
+    int nSafe;                      //those proven safe
+};
+typedef struct analysis Analysis;
+
+//================================================
+// how many superinstructions the threaded
+// engine's peephole pass makes of a program
+//================================================
+#define PEEPHOLE_KINDS  7           //LOAD/ADD/STOR, LOAD/SUB/STOR, LOAD/SUB/BZRO, STOR/LOAD and three folded ones
+
+struct peepholeStats{
+    int fused[PEEPHOLE_KINDS];
+    int words;                      //instruction words covered by superinstructions
+};
+typedef struct peepholeStats PeepholeStats;
+
+//================================================
+// specialized interpreter loops picked once up
+// front, built on the threaded engine, see
+// threaded_loop.h
+//================================================
+enum variant{
+    VARIANT_NONE,                   //no specialized loop, the caller picks an engine
+    VARIANT_STRICT,                 //every check, the library's semantics
+    VARIANT_WRAPPING,               //no overflow checks, results wrap to 16 bits
+    VARIANT_INSTRUMENTED            //strict, calling a hook before every instruction
+};
+typedef enum variant Variant;
+
+//called by the instrumented variant before every instruction
+typedef void (*StepHook)(void *ctx, unsigned char pc, unsigned short word, signed short acc);
+
+struct instrument{
+    StepHook step;
+    void *ctx;                      //handed to step
+};
+typedef struct instrument Instrument;
+
+typedef HmlStatus (*VariantFn)(Hatchling *hatchling, const Instrument *instrument);
+
+//================================================
+// JIT tier
+//================================================
+enum jitMode{
+    JIT_OFF,                        //only use the selected interpreter engine
+    JIT_ON,                         //compile blocks once they've run JIT_THRESHOLD times
+    JIT_ALWAYS                      //compile every block the first time it's reached
+};
+typedef enum jitMode JitMode;
+
+//================================================
+// SIMD lockstep lanes: N copies of one program,
+// each with its own I/O, run as vectors across
+// lanes. The kernel is picked with SimdMode.
+// hmlLanesCreate() returns NULL in builds
+// without vector extensions (HML_NO_SIMD).
+//================================================
+enum simdMode{
+    SIMD_AUTO,                      //AVX2 if the CPU has it, otherwise SSE2
+    SIMD_AVX2,                      //256-bit kernel
+    SIMD_SSE2,                      //kernel built for the baseline target (SSE2 on x86-64)
+    SIMD_SCALAR                     //no lockstep, every lane runs on its own
+};
+typedef enum simdMode SimdMode;
+
+typedef struct hmlLanes HmlLanes;
+
+//================================================
+// multi-core machine: K cores, each with its own
+// registers, run one program against one shared
+// memory. Words CORE_LOCAL and up are private to
+// each core instead, every core starting with
+// its own copy of the loaded words, since a core
+// has no other way to keep more than the
+// accumulator to itself. Cores run on their own
+// threads, or round-robin on one thread for
+// reproducible runs.
+//================================================
+#define MAX_CORES       64
+#define CORE_LOCAL      0xF0        //first private word
+#define CAS_NEW         0xFF        //local word CAS stores when it succeeds
+#define CORE_QUANTUM    64          //default steps a core runs per turn under the deterministic scheduler
+
+typedef struct multicore Multicore;
+
+struct core{
+    Hatchling regs;                 //registers and I/O, regs.mem isn't used
+    unsigned short local[256 - CORE_LOCAL];    //the core's private words
+    int id;
+    HmlStatus status;               //HML_OK while the core runs, then why it stopped
+    unsigned long long steps;
+    bool waiting;                   //stopped at a BARR until the other cores get there
+    pthread_t thread;
+    Multicore *machine;
+} __attribute__((aligned(64)));
+typedef struct core Core;
+
+struct multicore{
+    unsigned short mem[256];        //shared memory
+    Core *cores;
+    int nCores;
+    bool threaded;                  //a thread per core, false for the deterministic scheduler
+    unsigned long long maxSteps;    //step budget of each core, 0 for none
+    _Atomic bool stop;              //a core failed or ran out of steps, the rest stop too
+    pthread_mutex_t lock;           //barrier state
+    pthread_cond_t released;
+    int live;                       //cores that haven't stopped
+    int arrived;                    //cores waiting at the barrier
+    unsigned long long generation;  //barriers released so far
+    pthread_mutex_t ioLock;         //one READ or WRTE at a time
+    HmlReportFn report;             //told about READ values out of range, NULL for no one
+};
+
+//context lifetime
+Hatchling *hmlCreate(void);
+void hmlInit(Hatchling *hatchling);
+void hmlReset(Hatchling *hatchling);
+void hmlDestroy(Hatchling *hatchling);
+void hmlSetIo(Hatchling *hatchling, HmlReadFn read, HmlWriteFn write, void *in, void *out);
+
+HmlPool *hmlPoolCreate(int size);
+Hatchling *hmlPoolAcquire(HmlPool *pool);
+void hmlPoolRelease(HmlPool *pool, Hatchling *hatchling);
+void hmlPoolDestroy(HmlPool *pool);
+
+//loading
+HmlStatus hmlLoad(Hatchling *hatchling, const char *data, size_t len, unsigned long *detail);
+HmlStatus hmlLoadImage(Hatchling *hatchling, const ProgramImage *image);
+HmlStatus hmlLoadText(Hatchling *hatchling, const char *text, size_t len, unsigned long *detail);
+const ContainerHeader *hmlAsContainer(const char *data, size_t len);
+
+//running
+HmlStatus hmlExecute(Hatchling *hatchling);
+HmlStatus hmlStep(Hatchling *hatchling);
+HmlStatus hmlRun(Hatchling *hatchling, unsigned long long limit, unsigned long long *steps);
+Termination hmlTermination(const Hatchling *hatchling);
+const char *hmlStatusName(HmlStatus status);
+
+//extended addressing
+HmlWide *hmlWideCreate(int addressBits);
+void hmlWideDestroy(HmlWide *wide);
+HmlStatus hmlWideLoadText(HmlWide *wide, const char *text, size_t len, unsigned long *detail);
+HmlStatus hmlWideStep(HmlWide *wide);
+HmlStatus hmlWideRun(HmlWide *wide, unsigned long long limit, unsigned long long *steps);
+unsigned short hmlSpaceRead(const HmlSpace *space, unsigned int addr);
+unsigned short *hmlSpaceWord(HmlSpace *space, unsigned int addr);
+const unsigned short *hmlSpacePage(const HmlSpace *space, unsigned int page);
+
+//engines: each runs until HALT or a fatal error and returns hmlExecute()'s status for it,
+//HML_BAD_INPUT leaves the READ to run again on the next call
+void hmlAnalyze(const Hatchling *hatchling, Analysis *analysis);
+void hmlPeepholeStats(const Hatchling *hatchling, PeepholeStats *stats);
+HmlStatus hmlRunThreaded(Hatchling *hatchling, const Analysis *analysis);
+HmlStatus hmlRunStrict(Hatchling *hatchling, const Instrument *instrument);
+HmlStatus hmlRunWrapping(Hatchling *hatchling, const Instrument *instrument);
+HmlStatus hmlRunInstrumented(Hatchling *hatchling, const Instrument *instrument);
+HmlStatus hmlRunJit(Hatchling *hatchling, JitMode mode);
+
+//SIMD lockstep lanes
+HmlLanes *hmlLanesCreate(const Hatchling *prog, int nLanes, HmlReportFn report);
+void hmlLanesDestroy(HmlLanes *lanes);
+void hmlLanesSetIo(HmlLanes *lanes, int lane, HmlReadFn read, HmlWriteFn write, void *in, void *out);
+void hmlLanesRun(HmlLanes *lanes, SimdMode mode);
+void hmlLanesGet(const HmlLanes *lanes, int lane, Hatchling *hatchling);
+
+//multi-core machine
+Multicore *hmlCoresCreate(const Hatchling *prog, int nCores, bool deterministic, unsigned long long maxSteps, HmlReportFn report);
+void hmlCoresRun(Multicore *m, int quantum);
+void hmlCoresDestroy(Multicore *m);
+
+#endif
@@ -14,99 +14,883 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/file.h>
+#include <stdatomic.h>
 
-// ACC-MEM Arithmetic Instructions
-#define ADD     0x10    // Add a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
-#define SUB     0x11    // Subtract a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
-#define MUL     0x12    // Multiply a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
-#define DIV     0x13    // Divide a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
-#define MOD     0x14    // Compute the integer remainder when dividing a word from a specific location in memory to the word in the accumulator (leave the result in the accumulator)
+#include "hatchling.h"
 
-// ACC-MEM Logical Instructions
-#define AND     0x20    // Compute the binary AND of a specific memory location and the accumulator (leave the result in the accumulator)
-#define ORR     0x21    // Compute the binary OR of a specific memory location and the accumulator (leave the result in the accumulator)
-#define NOT     0x22    // Compute the logical NOT of the accumulator (leave the result in the accumulator)
-#define XOR     0x23    // Compute the binary XOR of a specific memory location and the accumulator (leave the result in the accumulator)
-#define LSR     0x24    // Compute the binary logical shift right (1-bit) of the accumulator (leave the result in the accumulator)
-#define ASR     0x25    // Compute the binary arithmetic shift right (1-bit) of the accumulator (leave the result in the accumulator)
-#define LSL     0x26    // Compute the binary logical shift left of the accumulator (leave the result in the accumulator)
+//the simulation daemon's event loop is built on epoll
+#if defined(__linux__) && !defined(HML_NO_SERVE)
+#define HML_SERVE 1
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
-// Branch Instructions
-#define B       0X30    // Branch to a specific location in memory
-#define BNEG    0X31    // Branch to a specific location in memory if the accumulator is negative
-#define BPOS    0X32    // Branch to a specific location in memory if the accumulator is positive
-#define BZRO    0X33    // Branch to a specific location in memory if the accumulator is zero
+//================================================
+// saved Hatchling state that a run can be reset
+// back to
+//================================================
+struct snapshot{
+    signed short accumulator;
+    unsigned short instructReg;
+    unsigned char instructCntr;
+    unsigned char opCode;
+    unsigned char operand;
+    bool fatalError;
+    Termination stop;
+    unsigned short mem[256];
+};
+typedef struct snapshot Snapshot;
+
+//steps between looks at the clock when a run has a --max-time budget
+#define TIME_CHECK_STEPS    65536
+
+//one bit per memory word a run may have written since the last restore
+#define DIRTY_WORDS     (256 / 64)
+#define MARK_DIRTY(dirty, addr) ((dirty)[(addr) >> 6] |= 1ULL << ((addr) & 63))
+
+//================================================
+// execution profile collected by --profile
+//================================================
+struct profile{
+    unsigned long long steps;           //instructions executed
+    unsigned long long opCount[256];    //executions per opcode
+    unsigned long long hits[256];       //executions per address
+    unsigned long long taken[256];      //conditional branch at address taken
+    unsigned long long notTaken[256];   //conditional branch at address fell through
+    unsigned long long backEdges[256];  //taken jumps back to address, which makes it a loop header
+};
+typedef struct profile Profile;
+
+//================================================
+// execution traces (--trace). The traced run
+// hands one TraceRecord per step to a writer
+// thread through a lock-free single producer,
+// single consumer ring, and every
+// TRACE_KEYFRAME steps copies the whole state
+// into a keyframe slot. The writer delta-encodes
+// the steps a batch at a time and writes them in
+// compressed chunks, each starting with its
+// keyframe so --replay can jump straight to the
+// chunk holding the step it wants.
+//
+// A run with a CPU to spare never waits for the
+// writer: when the ring is full it stops
+// recording until the writer has caught up and
+// the next keyframe is due, so the chunk it was
+// in ends early and the steps up to that
+// keyframe are missing from the trace. With one
+// CPU the writer can only run when the run gives
+// way, so the run waits for it instead.
+//
+// Tracing isn't cheap. On one CPU the run pays
+// for the writer's encoding and compression as
+// well as its own records, and takes 3 to 5
+// times as long as an untraced run on the
+// threaded engine (the arith_loop and
+// traced_loop stages of --bench, and the
+// bench/ workloads). The records alone, with
+// nothing encoded, come to about twice.
+//
+// A trace file is a TraceHeader followed by
+// chunks: a TraceChunk, then packedLen bytes of
+// compressed step records. Integers are in host
+// byte order. Once decompressed, a chunk's steps
+// are four streams one after the other: a flags
+// byte per step, then the jump addresses, the
+// accumulator differences and the memory writes
+// (an address, and a value after a TRACE_WRITE
+// one) of the steps whose flags call for them.
+// Steps between one chunk's end and the next
+// chunk's firstStep weren't recorded.
+//================================================
+#define TRACE_MAGIC       "HMLT"
+#define TRACE_VERSION     2
+#define TRACE_KEYFRAME    65536     //steps per chunk, a keyframe starts every chunk
+#define TRACE_RING        (1 << 16) //records in the ring, a power of two
+#define TRACE_PUBLISH     256       //records the producer batches before publishing them
+#define TRACE_KEYS        (TRACE_RING / TRACE_KEYFRAME + 2)    //keyframe slots, enough for every chunk in the ring
+
+//flags byte of every encoded step
+#define TRACE_JUMP        0x01      //the next instruction isn't the following word, its address is in the jump stream
+#define TRACE_ACC         0x02      //the accumulator changed, the 16-bit difference is in the accumulator stream
+#define TRACE_WRITE       0x04      //a memory word was written, its address and value are in the write stream
+#define TRACE_STORE       0x08      //the accumulator was written to memory, its address is in the write stream
+
+struct traceHeader{
+    char magic[4];                  //TRACE_MAGIC
+    unsigned short version;         //TRACE_VERSION
+    unsigned short reserved;        //zero
+    unsigned int keyframe;          //steps per chunk
+    unsigned int reserved2;         //zero
+};
+typedef struct traceHeader TraceHeader;
+
+struct traceChunk{
+    unsigned long long firstStep;   //steps run before the keyframe
+    unsigned int nSteps;            //steps encoded in the chunk
+    unsigned int rawLen;            //bytes of encoded steps once decompressed
+    unsigned int packedLen;         //bytes of compressed steps following the chunk header
+    signed short accumulator;       //keyframe: the whole state before the chunk's first step
+    unsigned short instructReg;
+    unsigned char instructCntr;
+    unsigned char reserved[3];
+    unsigned short mem[256];
+};
+typedef struct traceChunk TraceChunk;
+
+//================================================
+// one step as the traced run sees it. The step
+// number is the record's position in the ring
+// and the opcode and operand are the word at the
+// instruction counter in the replayed memory,
+// so neither is stored.
+//================================================
+struct traceRecord{
+    signed short accumulator;       //accumulator after the step
+    unsigned short value;           //word written, when wrote is set
+    unsigned char next;             //instruction counter after the step
+    unsigned char addr;             //address written, when wrote is set
+    bool wrote;
+};
+typedef struct traceRecord TraceRecord;
+
+//================================================
+// where the next byte of each of a chunk's
+// streams goes, or comes from when replaying
+//================================================
+struct traceStreams{
+    unsigned char *flags;
+    unsigned char *jump;
+    unsigned char *acc;
+    unsigned char *write;
+};
+typedef struct traceStreams TraceStreams;
+
+//================================================
+// a keyframe the run took for the writer
+//================================================
+struct traceKey{
+    Snapshot state;                 //the state before step firstStep
+    unsigned long long firstStep;
+    _Atomic unsigned long long end; //step the chunk's recording stops before
+};
+typedef struct traceKey TraceKey;
+
+//================================================
+// ring and writer thread of a traced run
+//================================================
+struct tracer{
+    TraceRecord *ring;              //TRACE_RING records
+    _Atomic unsigned long long head;    //records published by the run
+    _Atomic unsigned long long tail;    //records the writer has taken
+    _Atomic bool done;              //the run has published its last record
+    FILE *f;
+    pthread_t thread;
+    TraceKey keys[TRACE_KEYS];      //keyframe before step k * TRACE_KEYFRAME is in keys[k % TRACE_KEYS]
+    bool lossy;                     //the run stops recording rather than wait for the writer
+    unsigned long long maxSteps;    //step budget of the run, 0 for none
+    double maxTime;                 //wall-clock budget in seconds, 0 for none
+    Snapshot last;                  //state the run ended in, set before done
+    unsigned long long steps;       //steps the run took, set before done
+    unsigned long long dropped;     //steps missing from the trace, set by the writer
+    bool failed;                    //a write failed, set by the writer
+};
+typedef struct tracer Tracer;
+
+#define COVERAGE_BYTES  8192        //one bit per (branch address, next address) edge
+
+//================================================
+// execution engines selectable from the
+// command line
+//================================================
+enum engine{
+    ENGINE_SWITCH,                  //fetch, decode and switch every step (executeInstruction)
+    ENGINE_THREADED,                //predecoded, direct-threaded dispatch (hmlRunThreaded)
+    ENGINE_AOT                      //program translated ahead of time by --emit-c (executeCompiled)
+};
+typedef enum engine Engine;
+
+//================================================
+// what the computer dump at the end of a run
+// shows, picked with --dump=full|changed|none
+//================================================
+enum dumpMode{
+    DUMP_FULL,                      //registers and all 256 memory words
+    DUMP_CHANGED,                   //registers and only the words the run changed
+    DUMP_NONE                       //only the termination banner
+};
+typedef enum dumpMode DumpMode;
+
+//================================================
+// result cache (--cache, --cache-file). A run
+// of a --stream program is keyed by a 128-bit
+// hash of its loaded memory, entry point and
+// READ values, and what it did is kept so the
+// same program on the same input can be answered
+// without running it. Entries live in a bounded
+// in-memory LRU and optionally in a shared,
+// memory-mapped file other processes use too.
+//================================================
+#define CACHE_MAX_OUTPUTS   128     //WRTE values kept per result, runs that write more aren't cached
+#define CACHE_MAGIC         "HMLR"
+#define CACHE_VERSION       1
+#define CACHE_WAYS          4       //slots a key may live in in the cache file
+#define CACHE_SLOTS         4096    //slots in a new cache file
+
+struct cacheKey{
+    unsigned long long lo;
+    unsigned long long hi;
+};
+typedef struct cacheKey CacheKey;
+
+//================================================
+// everything a run left behind
+//================================================
+struct cacheResult{
+    signed short accumulator;       //final registers
+    unsigned short instructReg;
+    unsigned char instructCntr;
+    unsigned char opCode;
+    unsigned char operand;
+    unsigned char termination;      //Termination the run ended with
+    bool fatalError;
+    unsigned short nOutputs;        //WRTE values in outputs
+    signed short outputs[CACHE_MAX_OUTPUTS];
+    unsigned short mem[256];        //final memory
+};
+typedef struct cacheResult CacheResult;
+
+//================================================
+// one in-memory entry, linked into its hash
+// bucket and the LRU list by index
+//================================================
+struct cacheEntry{
+    CacheKey key;
+    CacheResult result;
+    int chain;                      //next entry in the bucket, -1 at the end
+    int newer;                      //LRU neighbours, -1 at either end
+    int older;
+};
+typedef struct cacheEntry CacheEntry;
+
+//================================================
+// the cache file: a header, then nSlots slots in
+// sets of CACHE_WAYS. A slot's seq is odd while
+// a process is writing it, readers retry or skip
+// a slot whose seq moved while they copied it.
+//================================================
+struct cacheFileHeader{
+    char magic[4];                  //CACHE_MAGIC
+    unsigned short version;         //CACHE_VERSION
+    unsigned short reserved;        //zero
+    unsigned int nSlots;            //a multiple of CACHE_WAYS
+    _Atomic unsigned int clock;     //bumped on every use, stamps slots for replacement
+};
+typedef struct cacheFileHeader CacheFileHeader;
+
+struct cacheSlot{
+    _Atomic unsigned int seq;       //0 for a slot never written, odd while being written
+    _Atomic unsigned int stamp;     //clock at the slot's last use
+    CacheKey key;
+    CacheResult result;
+};
+typedef struct cacheSlot CacheSlot;
 
-// ACC-MEM Load/Store Instructions
-#define LOAD    0X40    // Load a word from a specific location in memory into the accumulator
-#define STOR    0X41    // Store a word from the accumulator into a specific memory location
+//================================================
+// a process's result cache, shared by every
+// thread it runs programs on
+//================================================
+struct resultCache{
+    pthread_mutex_t lock;           //guards the in-memory entries
+    CacheEntry *entries;            //capacity entries, used of them in use
+    int capacity;
+    int used;
+    int *buckets;                   //first entry of each hash bucket, -1 for none
+    int nBuckets;
+    int newest;                     //LRU ends, -1 while empty
+    int oldest;
+    CacheFileHeader *file;          //mapped cache file, NULL for none
+    CacheSlot *slots;
+    size_t fileLen;
+    int verifyEvery;                //re-run one hit in this many to check it, 0 for none
+    _Atomic unsigned long long hits;
+    _Atomic unsigned long long misses;
+    _Atomic unsigned long long stores;
+    _Atomic unsigned long long verified;
+    _Atomic unsigned long long mismatches;
+};
+typedef struct resultCache ResultCache;
+
+//================================================
+// READ input of a --stream run: the whole input
+// mapped or read up front and taken a token at
+// a time
+//================================================
+struct streamInput{
+    const char *data;
+    size_t len;
+    size_t pos;                     //next byte to look at
+    bool mapped;                    //data is an mmap'd file, see mapStream()
+    CacheResult *record;            //result cache entry WRTE values are collected into, NULL for none
+    bool uncacheable;               //the run did something its cached result couldn't reproduce
+};
+typedef struct streamInput StreamInput;
+
+//================================================
+// input explorer (--explore): every READ takes
+// the next value of an input. Workers mutate
+// inputs from a shared corpus, keep the ones
+// that take a branch edge nothing took before
+// and shrink the ones that fault. The corpus
+// only grows, so workers read it without the
+// lock and only take it to add what they found.
+//================================================
+#define EXPLORE_SECONDS     10      //default --explore budget
+#define EXPLORE_MAX_READS   32      //values in one input
+#define EXPLORE_CORPUS      4096    //inputs the corpus holds
+#define EXPLORE_STEPS       100000  //step budget of every run without --max-steps
+#define EXPLORE_BATCH       256     //runs a worker makes between updates of its shared counter
+#define EXPLORE_DICT        (256 * 3 + 8)   //values around the program's own words and the extremes
+
+struct exploreInput{
+    signed short values[EXPLORE_MAX_READS];
+    int n;                          //values in the input
+    int used;                       //values its last run read
+};
+typedef struct exploreInput ExploreInput;
+
+struct exploreCrash{
+    Termination stop;               //TERM_OVERFLOW, TERM_DIVIDE_BY_ZERO or TERM_UNDEFINED_OPCODE
+    unsigned char at;               //address of the faulting instruction
+    double found;                   //seconds into the search
+    ExploreInput input;             //minimized
+};
+typedef struct exploreCrash ExploreCrash;
+
+typedef struct explorer Explorer;
+
+struct exploreWorker{
+    Explorer *explorer;
+    int id;
+    unsigned long long rng;         //xorshift state
+    _Atomic unsigned long long runs;
+    unsigned long long cov[COVERAGE_BYTES / 8];     //edges of the current run
+    unsigned long long seen[COVERAGE_BYTES / 8];    //edges the worker knows are covered
+    unsigned long long scratch[COVERAGE_BYTES / 8]; //edges of minimizing runs, never read
+    unsigned long long dirty[DIRTY_WORDS];          //words the last run wrote
+    pthread_t thread;
+} __attribute__((aligned(64)));
+typedef struct exploreWorker ExploreWorker;
+
+struct explorer{
+    Snapshot start;                 //the program as loaded
+    unsigned long long maxSteps;    //step budget of every run
+    signed short dict[EXPLORE_DICT];
+    int nDict;
+    int nWorkers;
+    double t0;                      //nowNs() when the search started
+    _Atomic bool stop;
+    pthread_mutex_t lock;           //coverage, corpus appends and crashes
+    unsigned long long coverage[COVERAGE_BYTES / 8];
+    int edges;                      //bits set in coverage
+    ExploreInput *corpus;
+    _Atomic int nCorpus;            //entries published to the workers
+    bool crashSeen[3][256];         //by termination and address
+    ExploreCrash *crashes;
+    int nCrashes;
+};
+
+//================================================
+// settings parsed from the command line
+//================================================
+struct options{
+    Engine engine;                  //interpreter engine to run on
+    JitMode jit;                    //JIT tier mode
+    bool emitC;                     //translate the program to C instead of running it
+    const char *emitPath;           //file to write the C translation to, NULL for stdout
+    const char *batchPath;          //manifest or directory of programs for batch mode, NULL for one program
+    int threads;                    //batch worker threads, 0 for one per core
+    const char *lanesPath;          //file of READ input sets for the lockstep engine, one lane per line
+    SimdMode simd;                  //kernel the lockstep engine runs with
+    const char *convertPath;        //file to convert the input programs into, NULL to run them
+    int entry;                      //entry point recorded by --convert, -1 for none
+    bool forkServer;                //serve fuzzing runs over stdin/stdout
+    const char *coveragePath;       //file the fork server shares its coverage bitmap through, NULL to send it inline
+    unsigned long long maxSteps;    //step budget, 0 for none
+    double maxTime;                 //wall-clock budget in seconds, 0 for none
+    bool detectLoops;               //stop as soon as the program provably loops forever
+    bool peepholeStats;             //print what the peephole pass fused
+    bool profile;                   //count steps per opcode, address and branch
+    const char *profilePath;        //JSON file the profile is also written to, NULL for the table only
+    bool bench;                     //run the benchmark suite instead of a program
+    const char *benchPath;          //file the benchmark results are written to, NULL for none
+    const char *baselinePath;       //earlier results to compare the benchmark against, NULL for none
+    int benchLength;                //loop body length of the generated programs
+    int benchDepth;                 //loop nesting depth of the generated programs
+    int benchReps;                  //timed repetitions per stage
+    const char *servePath;          //Unix socket to serve simulations on, NULL to run a program
+    const char *loadPath;           //Unix socket of a server to generate load against, NULL for none
+    int connections;                //load generator connections
+    int requests;                   //load generator requests per connection
+    int pipeline;                   //load generator requests in flight per connection
+    bool stream;                    //READ without prompts, output buffered and written at once
+    const char *inputPath;          //file --stream reads READ input from, NULL for stdin
+    DumpMode dump;                  //what the final computer dump shows
+    const char *dumpImagePath;      //.hmb image the final memory is also written to, NULL for none
+    const char *tracePath;          //file every step is recorded to, NULL for no trace
+    const char *replayPath;         //trace to rebuild a step of instead of running a program
+    unsigned long long replayStep;  //step --replay rebuilds, ~0 for the last
+    int cacheEntries;               //in-memory result cache entries, 0 for none
+    const char *cachePath;          //shared result cache file, NULL for none
+    int cacheVerify;                //re-run one cache hit in this many, 0 for none
+    bool cacheStats;                //print the cache counters once everything has run
+    ResultCache *cache;             //result cache --stream runs go through, NULL for none
+    int addressBits;                //16 or 24 to run in the sparse extended address space, 0 for 256 words
+    int cores;                      //cores sharing memory, 0 for a single Hatchling
+    bool deterministic;             //run the cores round-robin on one thread
+    int quantum;                    //steps per turn under the deterministic scheduler
+    bool scaling;                   //time the program on 1 to 16 cores
+    Variant variant;                //specialized loop to run programs with
+    VariantFn variantFn;            //its loop, picked in main() from variant
+    Instrument instrument;          //hook the instrumented variant calls
+    const char *stepLogPath;        //file the instrumented variant logs every step to, NULL for stderr
+    bool analyze;                   //print what the static analysis proves instead of running the program
+    bool optimize;                  //let the engines drop the checks and invalidation the analysis proved unneeded
+    double explore;                 //seconds to explore the program's READ inputs for, 0 to run it
+    const char *corpusPath;         //directory --explore writes its corpus and crashes to, NULL for none
+};
+typedef struct options Options;
+
+//================================================
+// one program run by the batch runner
+//================================================
+struct batchJob{
+    char *path;                     //.hml program to run, or a label for a container image
+    const ProgramImage *image;      //image inside a mapped container, NULL to load path
+    char *inputPath;                //file READ takes input from, NULL for none
+    char *output;                   //everything the run printed
+    size_t outputLen;               //length of output
+    bool done;                      //set by the worker once output is ready
+};
+typedef struct batchJob BatchJob;
+
+//================================================
+// a worker's deque of job indices. The owner
+// takes jobs from the tail and idle workers
+// steal from the head.
+//================================================
+struct workQueue{
+    pthread_mutex_t lock;
+    int *jobs;                      //job indices
+    int head;                       //next job to be stolen
+    int tail;                       //one past the owner's next job
+};
+typedef struct workQueue WorkQueue;
+
+//================================================
+// shared state of one batch run
+//================================================
+struct batch{
+    BatchJob *jobs;
+    int nJobs;
+    WorkQueue *queues;              //one per worker
+    int nWorkers;
+    const Options *opts;
+    pthread_mutex_t doneLock;       //guards done flags for the in-order writer
+    pthread_cond_t doneCond;        //signalled whenever a job finishes
+    const char *container;          //mapped container the jobs' images live in, NULL if none
+    size_t containerLen;            //length of the container mapping
+    bool containerMapped;           //container was mmap'd rather than read
+};
+typedef struct batch Batch;
+
+//================================================
+// a worker thread's view of the batch
+//================================================
+struct batchWorker{
+    Batch *batch;
+    int id;                         //index of the worker's own queue
+};
+typedef struct batchWorker BatchWorker;
+
+//================================================
+// --serve wire format. A request is a u32 body
+// length, then the body: a ServeRequest, nInputs
+// READ values and the program (.hml text or a
+// .hmb image) filling the rest. A response is a
+// u32 body length, then a ServeResponse followed
+// by nOutputs WRTE values. Responses on a
+// connection come back in request order. All
+// integers are in host byte order.
+//================================================
+struct serveRequest{
+    unsigned int tag;               //echoed back in the response
+    unsigned short nInputs;         //READ values following the header
+    unsigned short reserved;        //zero
+};
+typedef struct serveRequest ServeRequest;
+
+struct serveResponse{
+    unsigned int tag;               //tag of the request
+    unsigned int status;            //HmlStatus the run (or the load) ended with, HML_LIMIT for the step budget
+    unsigned int steps;             //instructions executed, saturating
+    unsigned int written;           //WRTE instructions executed, more than nOutputs once they're capped
+    unsigned int nOutputs;          //WRTE values following the response
+    signed short accumulator;       //final registers
+    unsigned short instructReg;
+    unsigned char instructCntr;
+    unsigned char opCode;
+    unsigned char operand;
+    unsigned char reserved;
+    unsigned short mem[256];        //final memory
+};
+typedef struct serveResponse ServeResponse;
 
-// I/O (Standard) Instructions
-#define READ    0X50    // Read a word from the terminal into a specific location in memory
-#define WRTE    0X51    // Write a word from a specific location in memory to the terminal
+#ifdef HML_SERVE
+typedef struct serveJob ServeJob;
+typedef struct serveConn ServeConn;
 
-// HALT Instruction
-#define HALT    0XFF   // Halt, i.e. the program has completed its task
+//================================================
+// one request accepted by the server
+//================================================
+struct serveJob{
+    ServeConn *conn;                //connection the request came in on
+    ServeJob *next;                 //next request on the same connection
+    ServeJob *link;                 //next job in the work queue or the done list
+    char *request;                  //request body
+    size_t requestLen;
+    char *response;                 //framed response, set by the worker
+    size_t responseLen;
+    bool done;                      //the event loop has collected the response
+};
 
+//================================================
+// a client connection. Requests are answered in
+// the order they arrived, whatever order the
+// workers finish them in.
+//================================================
+struct serveConn{
+    int fd;
+    char *in;                       //received bytes not yet made into jobs
+    size_t inLen;
+    size_t inCap;
+    char *out;                      //response bytes not yet sent
+    size_t outLen;
+    size_t outPos;
+    size_t outCap;
+    ServeJob *head;                 //oldest unanswered request
+    ServeJob *tail;                 //newest unanswered request
+    int inFlight;                   //requests not yet answered
+    unsigned int events;            //epoll events currently asked for
+    bool eof;                       //the client has sent its last request
+    bool closed;                    //fd is gone, freed once inFlight is 0
+};
 
 //================================================
-// struct that holds all relevant information 
-// and memory for a Hatchling program
+// shared state of the simulation daemon
 //================================================
-struct hatchling{
-    signed short int accumulator;   //used to represent the accumulator register
-    unsigned short int instructReg; //used to store the instruction being performed
-    unsigned char instructCntr;     //keeps track of the location in memory that contains the instruction being performed
-    unsigned char opCode;           //upper byte of the instruction register
-    unsigned char operand;          //lower byte of the instruction register
-    unsigned short int mem[256];    //an array of 256 short int
-    bool fatalError;                //flags whether we've encoured a fatal error in the program
+struct server{
+    int epfd;
+    int listenFd;
+    int wakeFd;                     //eventfd workers signal finished jobs on
+    pthread_mutex_t lock;           //guards the queue, the done list and pending
+    pthread_cond_t work;            //signalled when a job is queued
+    ServeJob *queueHead;            //jobs waiting for a worker
+    ServeJob *queueTail;
+    ServeJob *doneList;             //finished jobs the event loop hasn't collected
+    int pending;                    //jobs queued or running
+    int capacity;                   //pending jobs at which the server stops reading requests
+    bool stopping;
+    unsigned long long maxSteps;    //step budget of every run
+    ServeConn **conns;              //open connections
+    int nConns;
+    int connsCap;
+    unsigned int rotate;            //connection serveCollect() starts from
 };
-typedef struct hatchling Hatchling;
+typedef struct server Server;
+#endif
 
 //================================================
 // function prototypes
 //================================================
-Hatchling readFile(FILE *f);
-Hatchling readProgram();
+HmlStatus stdioRead(Hatchling * hatchling, long *value);
+void stdioWrite(Hatchling * hatchling, signed short value);
+void stdioInit(Hatchling * hatchling);
+char *hex2(char *p, unsigned char b);
+char *hex4(char *p, unsigned short w);
+bool streamToken(StreamInput *input, long *value);
+HmlStatus streamRead(Hatchling * hatchling, long *value);
+void streamWrite(Hatchling * hatchling, signed short value);
+void streamOpen(Hatchling * hatchling, StreamInput *input, FILE *f);
+void streamClose(StreamInput *input);
+const char *mapStream(FILE *f, size_t *len, bool *mapped);
+void unmapStream(const char *data, size_t len, bool mapped);
+void readFile(Hatchling * hatchling, FILE *f, FILE *out);
+void readProgram(Hatchling * hatchling);
+void parseProgram(Hatchling * hatchling, const char *data, size_t len, FILE *out);
+void loadImage(Hatchling * hatchling, const ProgramImage *image, FILE *out);
 void execute(Hatchling * hatchling);
+void printPeepholeStats(FILE *out, const Hatchling * hatchling);
 void executeInstruction(Hatchling * hatchling);
+void reportStatus(FILE *out, HmlStatus status);
+void executeGuarded(Hatchling * hatchling, const Options * opts);
+void stopRun(Hatchling * hatchling, signed short acc, unsigned char pc, Termination stop, unsigned long long steps, double maxTime);
+void printAnalysis(FILE *out, const Hatchling * hatchling, const Analysis *analysis);
+void run(Hatchling * hatchling, Engine engine, JitMode jit, const Analysis *analysis);
+VariantFn selectVariant(Variant variant);
+void stepLog(void *ctx, unsigned char pc, unsigned short word, signed short acc);
+void emitC(FILE *out, Hatchling * hatchling);
+void simulate(Hatchling * hatchling, const Options * opts);
+void simulateStream(Hatchling * hatchling, const Options * opts);
+void simulateCached(Hatchling * hatchling, StreamInput *input, const Options * opts);
+ResultCache *cacheCreate(int capacity, const char *path, int verifyEvery);
+void cacheDestroy(ResultCache *cache);
+void printCacheStats(FILE *out, ResultCache *cache);
+bool writeFully(int fd, const void *buf, size_t n);
+int runBatch(const char *path, const Options * opts);
+void reportLane(Hatchling * hatchling, HmlStatus status);
+int runLanes(Hatchling * hatchling, const char *path, const Options * opts);
+void takeSnapshot(Snapshot *snap, const Hatchling * hatchling);
+void restoreSnapshot(Hatchling * hatchling, const Snapshot *snap, unsigned long long *dirty);
+int runForkServer(Hatchling * hatchling, const Options * opts);
+char *formatRegisters(char *p, const Hatchling * hatchling);
+char *formatMemory(char *p, const unsigned short *mem);
+void printDump(Hatchling * hatchling);
+void printDumpChanged(Hatchling * hatchling, const unsigned short *loaded);
+void finishDump(Hatchling * hatchling, const unsigned short *loaded, const Options * opts);
+void executeProfiled(Hatchling * hatchling, Profile *prof, unsigned long long maxSteps, double maxTime);
+void printProfile(FILE *out, const Hatchling * hatchling, const Profile *prof);
+bool writeProfileJson(const char *path, const Hatchling * hatchling, const Profile *prof);
+bool traceRun(Hatchling * hatchling, const char *path, unsigned long long maxSteps, double maxTime, unsigned long long *dropped);
+int runReplay(const char *path, unsigned long long step);
+int runBench(const Options * opts, char **paths, int nPaths);
+double nowNs();
+void printWideDump(FILE *out, const HmlWide *wide);
+int runCores(const char *path, const Options * opts);
+int runScaling(const char *path, const Options * opts);
+HmlStatus exploreRead(Hatchling * hatchling, long *value);
+unsigned long long exploreRandom(ExploreWorker *w);
+Termination exploreRun(Hatchling * hatchling, const Explorer *ex, ExploreInput *input, unsigned long long *coverage,
+                       unsigned long long *dirty);
+void exploreMutate(ExploreWorker *w, ExploreInput *input);
+bool exploreMerge(ExploreWorker *w, const ExploreInput *input);
+void exploreMinimize(ExploreWorker *w, Hatchling * hatchling, ExploreInput *input, Termination stop, unsigned char at);
+void exploreTry(ExploreWorker *w, Hatchling * hatchling, ExploreInput *input);
+void *exploreThread(void *arg);
+char *formatInput(char *p, const ExploreInput *input);
+int runExplore(Hatchling * hatchling, const char *path, const Options * opts);
+int runWide(const char *path, const Options * opts);
+const char *mnemonic(unsigned char opCode);
+int runServer(const char *path, const Options * opts);
+int runLoad(const char *path, const char *programPath, const Options * opts);
+
+
+//================================================
+// stdio front end for the library's READ and
+// WRTE callbacks. in and out are FILE streams,
+// NULL meaning stdin and stdout.
+//
+// A READ with no input left ends the run with
+// *** END OF INPUT *** and the dump. The
+// original simulator parsed the uninitialized
+// line buffer there, so it had no behaviour to
+// keep: the value read was whatever was on the
+// stack, and a program reading up to a sentinel
+// could loop forever.
+//================================================
+HmlStatus stdioRead(Hatchling * hatchling, long *value){
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+    fprintf(out, "INPUT A SIGNED SHORT INT (BASE 16, USE - FOR NEGATIVE):  ");
+    char line[80];
+    if(fscanf(hatchling->in ? hatchling->in : stdin, "%79s", line) != 1){
+        return HML_END_OF_INPUT;
+    }
+
+    //read in the number as a base 16 value
+    *value = strtol(line,NULL,16);
+    return HML_OK;
+}
+
+void stdioWrite(Hatchling * hatchling, signed short value){
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+
+    //writes the value to standard output as a hex number in 2's complement
+    fprintf(out, "OUTPUT: %04hX (REPRESENTED IN BASE 16, 2'S COMPLEMENT)\n", value);
+}
+
+//================================================
+// two hex digits for every byte, the table the
+// fast output paths format words with instead
+// of going through printf
+//================================================
+#define HEX_ROW(h) h"0" h"1" h"2" h"3" h"4" h"5" h"6" h"7" h"8" h"9" h"A" h"B" h"C" h"D" h"E" h"F"
+const char hexPairs[] = HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3") HEX_ROW("4") HEX_ROW("5")
+                        HEX_ROW("6") HEX_ROW("7") HEX_ROW("8") HEX_ROW("9") HEX_ROW("A") HEX_ROW("B")
+                        HEX_ROW("C") HEX_ROW("D") HEX_ROW("E") HEX_ROW("F");
+
+//writes a byte as two hex digits, returns the end
+char *hex2(char *p, unsigned char b){
+    memcpy(p, &hexPairs[b * 2], 2);
+    return p + 2;
+}
+
+//writes a word as four hex digits, returns the end
+char *hex4(char *p, unsigned short w){
+    return hex2(hex2(p, w >> 8), w & 0xFF);
+}
+
+//copies a string literal without its terminator, returns the end
+#define PUT_LITERAL(p, s) (memcpy((p), (s), sizeof(s) - 1), (p) + sizeof(s) - 1)
+
+//================================================
+// --stream front end: READ takes whitespace
+// separated base 16 values from a buffer with no
+// prompt, WRTE formats its line with the hex
+// table. in is a StreamInput, out the FILE the
+// run's output is buffered in.
+//================================================
+//takes the next whitespace separated token as a base 16 value, false at the end
+bool streamToken(StreamInput *input, long *value){
+    const char *data = input->data;
+    size_t pos = input->pos;
+    while(pos < input->len && (data[pos] == ' ' || (data[pos] >= '\t' && data[pos] <= '\r'))){
+        pos++;
+    }
+    if(pos == input->len){
+        input->pos = pos;
+        return false;
+    }
+
+    //same token as stdioRead()'s %79s
+    char line[80];
+    int n = 0;
+    while(pos < input->len && n < 79 && data[pos] != ' ' && (data[pos] < '\t' || data[pos] > '\r')){
+        line[n++] = data[pos++];
+    }
+    line[n] = '\0';
+    input->pos = pos;
+    *value = strtol(line,NULL,16);
+    return true;
+}
+
+HmlStatus streamRead(Hatchling * hatchling, long *value){
+    StreamInput *input = hatchling->in;
+    if(!streamToken(input, value)){
+        return HML_END_OF_INPUT;
+    }
+
+    //the core turns this down and prints a warning a cached result can't reproduce
+    if(*value < -32768 || *value > 32767){
+        input->uncacheable = true;
+    }
+    return HML_OK;
+}
+
+void streamWrite(Hatchling * hatchling, signed short value){
+    char line[64];
+    char *p = PUT_LITERAL(line, "OUTPUT: ");
+    p = hex4(p, (unsigned short)value);
+    p = PUT_LITERAL(p, " (REPRESENTED IN BASE 16, 2'S COMPLEMENT)\n");
+    fwrite(line, 1, p - line, hatchling->out ? hatchling->out : stdout);
+
+    StreamInput *input = hatchling->in;
+    CacheResult *record = input ? input->record : NULL;
+    if(record){
+        if(record->nOutputs == CACHE_MAX_OUTPUTS){
+            input->uncacheable = true;
+        }
+        else{
+            record->outputs[record->nOutputs++] = value;
+        }
+    }
+}
+
+//================================================
+// switches a loaded program over to --stream
+// I/O, with READ input taken from all of f
+//================================================
+void streamOpen(Hatchling * hatchling, StreamInput *input, FILE *f){
+    input->data = mapStream(f, &input->len, &input->mapped);
+    input->pos = 0;
+    input->record = NULL;
+    input->uncacheable = false;
+    hatchling->read = streamRead;
+    hatchling->write = streamWrite;
+    hatchling->in = input;
+}
+
+void streamClose(StreamInput *input){
+    unmapStream(input->data, input->len, input->mapped);
+}
 
+//================================================
+// sets up an empty context that reads and
+// writes through stdio
+//================================================
+void stdioInit(Hatchling * hatchling){
+    hmlInit(hatchling);
+    hmlSetIo(hatchling, stdioRead, stdioWrite, NULL, NULL);
+}
 
 //================================================
 // reads and loads Hatchling program using
 // standard input supplied by the user into the 
-// terminal (using -99999 as a sentinel), and 
-// returns the loaded Hatchling program
+// terminal (using -99999 as a sentinel) into
+// prog. A bad word is reported and flagged in
+// fatalError
 //================================================
-Hatchling readProgram(){
-    Hatchling prog = (Hatchling){0, 0, 0, 0, 0, {}, false};
+void readProgram(Hatchling * prog){
+    stdioInit(prog);
     int i = 0;
     char line[80];
     printf("%02X    ", i); //print memory location/line number
 
-    //read first line
-    scanf("%s", line);
+    //read first line, end of input works like the sentinel
+    if(scanf("%79s", line) != 1){
+        strcpy(line, "-99999");
+    }
     long ins = strtol(line,NULL,16);
     
-    //halts execution if bad instruction is entered
+    //flags a load error if bad instruction is entered
     if((ins < 0x0000 || ins > 0xFFFF) && ins != -0x99999){
         printf("BAD INSTRUCTION ON LINE %02x ", i);
-        exit(0);
+        prog->fatalError = true;
+        return;
     }
 
     /* reads and loads loading instruction/data words into
         the Hatchling program's memory until the
         sentinel value (-99999) is entered */ 
     while(strcmp(line,"-99999")){
+        if(i == 256){
+            printf("PROGRAM DOES NOT FIT IN MEMORY (MORE THAN 256 WORDS)\n");
+            prog->fatalError = true;
+            return;
+        }
 
         /* assigns input word (casted as an unsigned short) into respective place in 
             program memory */
-        prog.mem[i] = (unsigned short)ins;
+        prog->mem[i] = (unsigned short)ins;
         int c = i + 1;
         i = c;
         printf("%02X    ", i);
-        scanf("%s",line);
+        if(scanf("%79s",line) != 1){
+            strcpy(line, "-99999");
+        }
 
         //converts input C-string into a base-16 number
         ins = strtol(line,NULL,16);
@@ -114,42 +898,232 @@ Hatchling readProgram(){
                 int d = i;
                 printf("BAD INSTRUCTION ON LINE %02X\n", d);
                 printf("PLEASE RE-RUN THE SIMULATOR WITH VALID INSTRUCTION WORDS IN RANGE [0000-FFFF]\n");
-                exit(0);
+                prog->fatalError = true;
+                return;
             
         }
 
     }
-    return prog;
+    return;
 }
 
 //================================================
-// reads and loads a Hatchling program into memory
-//  using a valid user-supplied .hml file
-//  Returns the loaded Hatchling program.
+// maps a whole stream into memory for parsing,
+// or reads it into a buffer when it can't be
+// mapped (pipes, terminals, empty files).
+// *mapped tells unmapStream() which it was.
 //================================================
-Hatchling readFile(FILE *f){
-    Hatchling prog = (Hatchling){0, 0, 0, 0, 0, {}, false};
-    char line[80];
-    long ins;
-    int i = 0;
-    while (fgets(line, 6, f)) {
+const char *mapStream(FILE *f, size_t *len, bool *mapped){
+    struct stat st;
+    int fd = fileno(f);
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && ftell(f) == 0){
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED){
+            *len = st.st_size;
+            *mapped = true;
+            return data;
+        }
+    }
 
-        //converts line into a base-16 number
-        ins = strtol(line,NULL,16);
+    size_t cap = 4096;
+    char *buf = malloc(cap);
+    *len = 0;
+    size_t n;
+    while((n = fread(buf + *len, 1, cap - *len, f)) > 0){
+        *len += n;
+        if(*len == cap){
+            cap *= 2;
+            buf = realloc(buf, cap);
+        }
+    }
+    *mapped = false;
+    return buf;
+}
 
-        //checks for valid instruction words
-        if(ins < 0x0000 || ins > 0xFFFF){
-            
-                printf("BAD INSTRUCTION ON LINE %02X \n", i);
-                printf("PLEASE RE-RUN THE SIMULATOR WITH VALID INSTRUCTION WORDS IN RANGE [0000-FFFF]\n");
-                exit(0);
-            
+void unmapStream(const char *data, size_t len, bool mapped){
+    if(mapped){
+        munmap((void *)data, len);
+    }
+    else{
+        free((void *)data);
+    }
+}
+
+//================================================
+// reads and loads a Hatchling program into prog
+//  from a valid user-supplied .hml file, or a
+//  binary .hmb image. A bad word is reported on
+//  out and flagged in fatalError instead of
+//  ending the process.
+//================================================
+void readFile(Hatchling * prog, FILE *f, FILE *out){
+    size_t len;
+    bool mapped;
+    const char *data = mapStream(f, &len, &mapped);
+    parseProgram(prog, data, len, out);
+    unmapStream(data, len, mapped);
+}
+
+//================================================
+// reports why the library couldn't load a
+// program the way the simulator always has
+//================================================
+void reportLoad(HmlStatus status, unsigned long detail, FILE *out){
+    switch(status){
+        case HML_BAD_WORD:
+            fprintf(out, "BAD INSTRUCTION ON LINE %02lX \n", detail);
+            fprintf(out, "PLEASE RE-RUN THE SIMULATOR WITH VALID INSTRUCTION WORDS IN RANGE [0000-FFFF]\n");
+            return;
+        case HML_TOO_LONG:
+            fprintf(out, "PROGRAM DOES NOT FIT IN MEMORY (MORE THAN 256 WORDS)\n");
+            return;
+        case HML_TRUNCATED_IMAGE:
+            fprintf(out, "BAD PROGRAM IMAGE (TRUNCATED TO %lu BYTES)\n", detail);
+            return;
+        case HML_BAD_IMAGE:
+            fprintf(out, "BAD PROGRAM IMAGE (EXPECTED %s VERSION %d)\n", IMAGE_MAGIC, IMAGE_VERSION);
+            return;
+        case HML_CONTAINER:
+            fprintf(out, "CONTAINER HOLDS %lu PROGRAMS, RUN IT WITH --batch\n", detail);
+            return;
+        default:
+            return;
+    }
+}
+
+//================================================
+// loads a program from the contents of a .hml,
+// .hmb or .hmc file into prog
+//================================================
+void parseProgram(Hatchling * prog, const char *data, size_t len, FILE *out){
+    unsigned long detail = 0;
+    stdioInit(prog);
+    HmlStatus status = hmlLoad(prog, data, len, &detail);
+    reportLoad(status, detail, out);
+}
+
+//================================================
+// loads a binary program image into prog, the
+// words are copied straight into memory with no
+// parsing
+//================================================
+void loadImage(Hatchling * prog, const ProgramImage *image, FILE *out){
+    stdioInit(prog);
+    reportLoad(hmlLoadImage(prog, image), 0, out);
+}
+
+//================================================
+// writes a loaded program as a binary image
+//================================================
+void writeImage(FILE *f, Hatchling * hatchling, int entry){
+    ProgramImage image;
+    memset(&image, 0, sizeof(image));
+    memcpy(image.magic, IMAGE_MAGIC, 4);
+    image.version = LE16(IMAGE_VERSION);
+    if(entry >= 0){
+        image.flags = LE16(IMAGE_HAS_ENTRY);
+        image.entry = entry;
+    }
+    for(int i = 0; i < 256; i++){
+        image.words[i] = LE16(hatchling->mem[i]);
+    }
+    fwrite(&image, sizeof(image), 1, f);
+}
+
+//================================================
+// writes a loaded program as .hml text, one word
+// per line up to the last non-zero word
+//================================================
+void writeText(FILE *f, Hatchling * hatchling){
+    int last = 255;
+    while(last >= 0 && hatchling->mem[last] == 0){
+        last--;
+    }
+    for(int i = 0; i <= last; i++){
+        fprintf(f, "%04X\n", hatchling->mem[i]);
+    }
+}
+
+//================================================
+// --convert: converts programs between .hml
+// text, .hmb images and .hmc containers. The
+// output format follows the output file's
+// extension, every input may be in any format
+// (containers contribute all of their images).
+//================================================
+int runConvert(char **paths, int nPaths, const char *outPath, int entry){
+    size_t outLen = strlen(outPath);
+    bool toContainer = outLen > 4 && strcmp(outPath + outLen - 4, ".hmc") == 0;
+    bool toImage = outLen > 4 && strcmp(outPath + outLen - 4, ".hmb") == 0;
+
+    //gather every input program
+    Hatchling *progs = NULL;
+    int nProgs = 0;
+    for(int p = 0; p < nPaths; p++){
+        FILE *f = fopen(paths[p], "r");
+        if(f == NULL){
+            printf("Please enter a valid filepath\n");
+            free(progs);
+            return 1;
+        }
+        size_t len;
+        bool mapped;
+        const char *data = mapStream(f, &len, &mapped);
+        const ContainerHeader *hdr = hmlAsContainer(data, len);
+        unsigned int count = hdr ? LE32(hdr->count) : 1;
+        if(hdr && len < sizeof(ContainerHeader) + (size_t)count * sizeof(ProgramImage)){
+            printf("TRUNCATED CONTAINER %s\n", paths[p]);
+            count = 0;
+        }
+        progs = realloc(progs, (nProgs + count) * sizeof(Hatchling));
+        for(unsigned int k = 0; k < count; k++){
+            if(hdr){
+                loadImage(&progs[nProgs], (const ProgramImage *)(data + sizeof(ContainerHeader)) + k, stdout);
+            }
+            else{
+                parseProgram(&progs[nProgs], data, len, stdout);
+            }
+            if(progs[nProgs++].fatalError){
+                unmapStream(data, len, mapped);
+                fclose(f);
+                free(progs);
+                return 1;
+            }
         }
+        unmapStream(data, len, mapped);
+        fclose(f);
+    }
+    if(!toContainer && nProgs != 1){
+        printf("Only a .hmc container can hold %d programs\n", nProgs);
+        free(progs);
+        return 1;
+    }
 
-        prog.mem[i] = (unsigned short) ins;
-        i++;
+    FILE *out = fopen(outPath, toContainer || toImage ? "wb" : "w");
+    if(out == NULL){
+        printf("Could not open %s for writing\n", outPath);
+        free(progs);
+        return 1;
+    }
+    if(toContainer){
+        ContainerHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, CONTAINER_MAGIC, 4);
+        hdr.version = LE16(IMAGE_VERSION);
+        hdr.count = LE32((unsigned int)nProgs);
+        fwrite(&hdr, sizeof(hdr), 1, out);
+    }
+    for(int k = 0; k < nProgs; k++){
+        if(toContainer || toImage){
+            writeImage(out, &progs[k], entry >= 0 ? entry : progs[k].instructCntr ? progs[k].instructCntr : -1);
+        }
+        else{
+            writeText(out, &progs[k]);
+        }
     }
-    return prog;
+    fclose(out);
+    free(progs);
+    return 0;
 }
 
 //================================================
@@ -178,280 +1152,4699 @@ void execute(Hatchling * hatchling){
 
 //================================================
 // executes a single instruction in the provided
-// Hatchling program, which is determined by
-// the Hatchling's opCode. Function
-// manipulates the Hatchling program
-// instance's state accordingly
+// Hatchling program with the library and prints
+// the banner for any fatal error it reports
 //================================================
 void executeInstruction(Hatchling * hatchling){
-    
-    switch(hatchling->opCode){
-        
-        case ADD:
-        {
-            //check for potential overflow
-            int sum = hatchling->accumulator + (signed short)hatchling->mem[hatchling->operand];
-            if(sum < -32768 || sum > 32767){
-                printf("*** ACCUMULATOR OVERFLOW ***\n");
-                printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
-
-                //halts program if operation results in accumulator overflow
-                hatchling->fatalError = true;
-                return;
-            }
+    reportStatus(hatchling->out ? hatchling->out : stdout, hmlExecute(hatchling));
+}
 
-            /* replace accumulator value with the sum of itself and the signed data word at the memory 
-                location specified by the operand */
-            hatchling->accumulator += (signed short)hatchling->mem[hatchling->operand];
-            hatchling->instructCntr++;
+//================================================
+// prints the banner for a status an instruction
+// ended with, nothing if the program goes on
+//================================================
+void reportStatus(FILE *out, HmlStatus status){
+    switch(status){
+        case HML_OVERFLOW:
+            fprintf(out, "*** ACCUMULATOR OVERFLOW ***\n");
+            break;
+        case HML_DIVIDE_BY_ZERO:
+            fprintf(out, "*** ATTEMPT TO DIVIDE BY ZERO ***\n");
+            break;
+        case HML_UNDEFINED_OPCODE:
+            fprintf(out, "*** UNDEFINED HATCHLING OPCODE ***\n");
+            break;
+        case HML_END_OF_INPUT:
+            fprintf(out, "\n*** END OF INPUT ***\n");
+            break;
+        case HML_BAD_INPUT:
+            fprintf(out, "Value out of range (-32768 to 32767, base 10)\n");
             return;
-        }
-        
-        case SUB:
-        {
-            int diff = hatchling->accumulator - (signed short)hatchling->mem[hatchling->operand];
-            if(diff < -32768 || diff > 32767){
-                printf("*** ACCUMULATOR OVERFLOW ***\n");
-                printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
-
-                //halts program if operation results in accumulator overflow
-                hatchling->fatalError = true;
-                return;
-            }
-
-            /* replace accumulator value with the difference of itself and the signed data word 
-                at the memory location specified by the operand */
-            hatchling->accumulator -= (signed short)hatchling->mem[hatchling->operand];
-            hatchling->instructCntr++;
+        default:
             return;
-        }
-        
-        case MUL:
-        {
-            int prod = hatchling->accumulator * (signed short)hatchling->mem[hatchling->operand];
-            if(prod < -32768 || prod > 32767){
-                printf("*** ACCUMULATOR OVERFLOW ***\n");
-                printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
-
-                //halts program if operation results in accumulator overflow
-                hatchling->fatalError = true;
-                return;
-            }
+    }
+    fprintf(out, "*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
+}
+
+//================================================
+// the loop for a --variant, NULL for none
+//================================================
+VariantFn selectVariant(Variant variant){
+    switch(variant){
+        case VARIANT_STRICT:
+            return hmlRunStrict;
+        case VARIANT_WRAPPING:
+            return hmlRunWrapping;
+        case VARIANT_INSTRUMENTED:
+            return hmlRunInstrumented;
+        default:
+            return NULL;
+    }
+}
+
+//================================================
+// the instrumented variant's hook for --step-log:
+// one line per instruction, before it runs
+//================================================
+void stepLog(void *ctx, unsigned char pc, unsigned short word, signed short acc){
+    fprintf(ctx, "%02X  %04hX  %-4s  ACC %04hX\n", pc, word, mnemonic(word >> 8), (unsigned short)acc);
+}
+
+//================================================
+// --peephole-stats: runs the peephole pass over
+// the loaded program and prints how many of
+// each superinstruction it made
+//================================================
+void printPeepholeStats(FILE *out, const Hatchling * hatchling){
+    static const char *const names[] = {"LOAD/ADD/STOR", "LOAD/SUB/STOR", "LOAD/SUB/BZRO", "STOR/LOAD",
+                                        "FOLDED LOAD", "FOLDED LOAD/ADD|SUB/STOR", "FOLDED LOAD/SUB/BZRO"};
+    PeepholeStats stats;
+    hmlPeepholeStats(hatchling, &stats);
+
+    fprintf(out, "\n*** PEEPHOLE: %d WORDS IN SUPERINSTRUCTIONS ***\n", stats.words);
+    for(int k = 0; k < PEEPHOLE_KINDS; k++){
+        fprintf(out, "%-26s %4d\n", names[k], stats.fused[k]);
+    }
+}
+
+//================================================
+// --analyze: what hmlAnalyze() found, a summary and
+// a row for every word the program reaches, with
+// the accumulator range for code and the value
+// range for data
+//================================================
+void printAnalysis(FILE *out, const Hatchling * hatchling, const Analysis *analysis){
+    static const char *const kinds[] = {"", "CODE", "DATA", "BOTH"};
+    int counts[4] = {0, 0, 0, 0};
+    for(int i = 0; i < 256; i++){
+        counts[analysis->kind[i]]++;
+    }
+
+    fprintf(out, "*** ANALYSIS: %d CODE, %d DATA, %d BOTH, %d UNREACHED WORDS ***\n",
+            counts[WORD_CODE], counts[WORD_DATA], counts[WORD_CODE | WORD_DATA], counts[0]);
+    if(analysis->selfModifying){
+        fprintf(out, "*** SELF-MODIFYING: THE PROGRAM CAN WRITE INTO ITS CODE, NOTHING PROVEN ***\n");
+    }
+    else{
+        fprintf(out, "*** %d OF %d ARITHMETIC INSTRUCTIONS PROVEN SAFE ***\n", analysis->nSafe, analysis->nChecked);
+    }
+
+    fprintf(out, "\nADDR  WORD  KIND  INSTR  ACC               VALUES            CHECK\n");
+    for(int i = 0; i < 256; i++){
+        unsigned char kind = analysis->kind[i];
+        if(kind == 0){
+            continue;
+        }
+        unsigned char op = hatchling->mem[i] >> 8;
+        const char *name = kind & WORD_CODE ? mnemonic(op) : NULL;
+        char acc[24] = "", values[24] = "";
+        if(kind & WORD_CODE){
+            snprintf(acc, sizeof(acc), "[%d, %d]", analysis->acc[i].lo, analysis->acc[i].hi);
+        }
+        if(kind & WORD_DATA){
+            snprintf(values, sizeof(values), "[%d, %d]", analysis->mem[i].lo, analysis->mem[i].hi);
+        }
+
+        const char *check = "";
+        if((kind & WORD_CODE) && op >= ADD && op <= MOD){
+            unsigned char faults = analysis->faults[i];
+            check = analysis->selfModifying ? "UNPROVEN"
+                    : faults == (MAY_OVERFLOW | MAY_DIVIDE_ZERO) ? "MAY OVERFLOW, MAY DIVIDE BY ZERO"
+                    : faults == MAY_OVERFLOW ? "MAY OVERFLOW"
+                    : faults == MAY_DIVIDE_ZERO ? "MAY DIVIDE BY ZERO" : "SAFE";
+        }
+        char line[128];
+        int n = snprintf(line, sizeof(line), "%02X    %04hX  %-4s  %-5s  %-16s  %-16s  %s", i, hatchling->mem[i],
+                         kinds[kind], name ? name : "", acc, values, check);
+        while(n > 0 && line[n - 1] == ' '){
+            n--;
+        }
+        fprintf(out, "%.*s\n", n, line);
+    }
+}
+
+//================================================
+// returns the assembler mnemonic for an opcode,
+// or NULL if the opcode is undefined
+//================================================
+const char *mnemonic(unsigned char opCode){
+    switch(opCode){
+        case ADD:  return "ADD";
+        case SUB:  return "SUB";
+        case MUL:  return "MUL";
+        case DIV:  return "DIV";
+        case MOD:  return "MOD";
+        case AND:  return "AND";
+        case ORR:  return "ORR";
+        case NOT:  return "NOT";
+        case XOR:  return "XOR";
+        case LSR:  return "LSR";
+        case ASR:  return "ASR";
+        case LSL:  return "LSL";
+        case B:    return "B";
+        case BNEG: return "BNEG";
+        case BPOS: return "BPOS";
+        case BZRO: return "BZRO";
+        case LOAD: return "LOAD";
+        case STOR: return "STOR";
+        case READ: return "READ";
+        case WRTE: return "WRTE";
+        case HALT: return "HALT";
+        default:   return NULL;
+    }
+}
+
+//================================================
+// helpers used by code generated with --emit-c,
+// which is compiled into the simulator with
+// -DHML_AOT='"file.c"'. AOT_SLOW runs one word
+// through executeInstruction() and re-enters the
+// generated code wherever it left the counter.
+// AOT_WRITABLE does the same for words the
+// program may overwrite, and leaves the rest of
+// the run to execute() if a rewritten word
+// stores outside the addresses the translation
+// expected to change.
+//================================================
+#ifdef HML_AOT
+#define AOT_SYNC(i)     do{ hatchling->accumulator = acc; hatchling->instructCntr = (i); hatchling->instructReg = mem[(i)]; \
+                            hatchling->opCode = mem[(i)] >> 8; hatchling->operand = mem[(i)] & 0xFF; }while(0)
+#define AOT_SLOW(i)     do{ AOT_SYNC(i); executeInstruction(hatchling); if(hatchling->fatalError){ return true; } \
+                            acc = hatchling->accumulator; pc = hatchling->instructCntr; goto dispatch; }while(0)
+#define AOT_WRITABLE(i) do{ AOT_SYNC(i); executeInstruction(hatchling); \
+                            if(hatchling->opCode == HALT || hatchling->fatalError){ return true; } \
+                            if((hatchling->opCode == STOR || hatchling->opCode == READ) && !compiledWritable[hatchling->operand]){ \
+                                execute(hatchling); return true; } \
+                            acc = hatchling->accumulator; pc = hatchling->instructCntr; goto dispatch; }while(0)
+#define AOT_HALT(i)     do{ AOT_SYNC(i); return true; }while(0)
+bool executeCompiled(Hatchling * hatchling);
+#include HML_AOT
+#endif
+
+//================================================
+// translates the loaded Hatchling program into a
+// C function, executeCompiled(), with one label
+// per memory address and a direct goto for each
+// branch. Words that some STOR or READ in the
+// image can write to are left to the interpreter
+// (AOT_WRITABLE), everything else is inlined.
+// Faulting, I/O and DIV/MOD words go through
+// AOT_SLOW so their behaviour is the same as
+// executeInstruction()'s.
+//================================================
+void emitC(FILE *out, Hatchling * hatchling){
+    unsigned short *mem = hatchling->mem;
+
+    //any address named by a STOR or READ word might be rewritten at run time
+    bool writable[256] = {false};
+    for(int i = 0; i < 256; i++){
+        if((mem[i] >> 8) == STOR || (mem[i] >> 8) == READ){
+            writable[mem[i] & 0xFF] = true;
+        }
+    }
+
+    fprintf(out, "//================================================\n");
+    fprintf(out, "// Hatchling program translated by hmlsim --emit-c\n");
+    fprintf(out, "//================================================\n");
+    fprintf(out, "const unsigned short compiledImage[256] = {");
+    for(int i = 0; i < 256; i++){
+        fprintf(out, "%s0x%04X%s", i % 8 == 0 ? "\n    " : " ", mem[i], i < 255 ? "," : "\n");
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "const bool compiledWritable[256] = {");
+    for(int i = 0; i < 256; i++){
+        fprintf(out, "%s%d%s", i % 16 == 0 ? "\n    " : " ", writable[i], i < 255 ? "," : "\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "//returns false if the loaded image isn't the one this was translated from\n");
+    fprintf(out, "bool executeCompiled(Hatchling * hatchling){\n");
+    fprintf(out, "    if(memcmp(hatchling->mem, compiledImage, sizeof(compiledImage)) != 0){\n");
+    fprintf(out, "        return false;\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    if(hatchling->opCode == HALT || hatchling->fatalError){\n");
+    fprintf(out, "        return true;\n");
+    fprintf(out, "    }\n\n");
+    fprintf(out, "    unsigned short *mem = hatchling->mem;\n");
+    fprintf(out, "    signed short acc = hatchling->accumulator;\n");
+    fprintf(out, "    unsigned char pc = hatchling->instructCntr;\n\n");
+    fprintf(out, "dispatch:\n");
+    fprintf(out, "    switch(pc){\n");
+    for(int i = 0; i < 256; i++){
+        fprintf(out, "        case 0x%02X: goto L%02X;\n", i, i);
+    }
+    fprintf(out, "    }\n\n");
+
+    for(int i = 0; i < 256; i++){
+        unsigned char op = mem[i] >> 8;
+        unsigned char a = mem[i] & 0xFF;
+        const char *name = mnemonic(op);
+
+        fprintf(out, "L%02X: //%04X %s %02X\n", i, mem[i], name ? name : "???", a);
+        if(writable[i]){
+            fprintf(out, "    AOT_WRITABLE(0x%02X);\n", i);
+            continue;
+        }
+        switch(op){
+            case ADD:
+            case SUB:
+            case MUL:
+                fprintf(out, "    { int r = acc %c (signed short)mem[0x%02X];\n", op == ADD ? '+' : op == SUB ? '-' : '*', a);
+                fprintf(out, "      if(r < -32768 || r > 32767){ AOT_SLOW(0x%02X); }\n", i);
+                fprintf(out, "      acc = r; }\n");
+                break;
+            case AND:
+            case ORR:
+            case XOR:
+                fprintf(out, "    acc %c= mem[0x%02X];\n", op == AND ? '&' : op == ORR ? '|' : '^', a);
+                break;
+            case NOT:
+                fprintf(out, "    acc = !acc;\n");
+                break;
+            case LSR:
+                fprintf(out, "    acc = acc >> 1;\n");
+                break;
+            case ASR:
+                fprintf(out, "    acc = acc < 0 ? ~(~acc >> 1) : acc >> 1;\n");
+                break;
+            case LSL:
+                fprintf(out, "    acc = acc << 1;\n");
+                break;
+            case B:
+                fprintf(out, "    goto L%02X;\n", a);
+                continue;
+            case BNEG:
+                fprintf(out, "    if(acc < 0){ goto L%02X; }\n", a);
+                break;
+            case BPOS:
+                fprintf(out, "    if(acc > 0){ goto L%02X; }\n", a);
+                break;
+            case BZRO:
+                fprintf(out, "    if(acc == 0){ goto L%02X; }\n", a);
+                break;
+            case LOAD:
+                fprintf(out, "    acc = (signed short)mem[0x%02X];\n", a);
+                break;
+            case STOR:
+                fprintf(out, "    mem[0x%02X] = acc;\n", a);
+                break;
+            case HALT:
+                fprintf(out, "    AOT_HALT(0x%02X);\n", i);
+                continue;
+            default:
+                //DIV, MOD, READ, WRTE and undefined opcodes
+                fprintf(out, "    AOT_SLOW(0x%02X);\n", i);
+                continue;
+        }
+
+        //the counter wraps from the last word back to the first
+        if(i == 255){
+            fprintf(out, "    goto L00;\n");
+        }
+    }
+    fprintf(out, "}\n");
+}
+
+//================================================
+// runs the loaded Hatchling program on the
+// selected execution engine, or the JIT tier
+// when it's turned on
+//================================================
+void run(Hatchling * hatchling, Engine engine, JitMode jit, const Analysis *analysis){
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+    HmlStatus status;
+    if(jit != JIT_OFF){
+        do{
+            status = hmlRunJit(hatchling, jit);
+            reportStatus(out, status);
+        }while(status == HML_BAD_INPUT);
+        return;
+    }
+    switch(engine){
+        case ENGINE_SWITCH:
+            execute(hatchling);
+            return;
+        case ENGINE_AOT:
+#ifdef HML_AOT
+            if(executeCompiled(hatchling)){
+                return;
+            }
+#endif
+            //not built with a translation of this program
+            //fall through
+        case ENGINE_THREADED:
+            do{
+                status = hmlRunThreaded(hatchling, analysis);
+                reportStatus(out, status);
+            }while(status == HML_BAD_INPUT);
+            return;
+    }
+}
+
+//================================================
+// runs (or translates) a loaded Hatchling
+// program and prints the computer dump
+//================================================
+void simulate(Hatchling * hatchling, const Options * opts){
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+
+    //the program didn't load, readFile()/readProgram() reported why
+    if(hatchling->fatalError){
+        return;
+    }
+
+    if(opts->emitC){
+        FILE *emit = opts->emitPath ? fopen(opts->emitPath, "w") : out;
+        if(emit == NULL){
+            fprintf(out, "Could not open %s for writing\n", opts->emitPath);
+            return;
+        }
+        emitC(emit, hatchling);
+        if(emit != out){
+            fclose(emit);
+        }
+        return;
+    }
+
+    //the analysis either replaces the run or tells the engine what it may skip
+    Analysis analysis;
+    if(opts->analyze || opts->optimize){
+        hmlAnalyze(hatchling, &analysis);
+    }
+    if(opts->analyze){
+        printAnalysis(out, hatchling, &analysis);
+        return;
+    }
+
+    fprintf(out, "*** PROGRAM LOADING COMPLETED ***\n");
+    fprintf(out, "*** PROGRAM EXECUTION BEGINS ***\n");
+
+    //statistics and --dump=changed describe the program as loaded, before it can rewrite itself
+    Hatchling loaded;
+    if(opts->peepholeStats || opts->dump == DUMP_CHANGED){
+        loaded = *hatchling;
+    }
+
+    //profiling runs its own counting loop so the engines above never pay for it
+    if(opts->profile){
+        Profile *prof = calloc(1, sizeof(Profile));
+        executeProfiled(hatchling, prof, opts->maxSteps, opts->maxTime);
+        finishDump(hatchling, loaded.mem, opts);
+        if(opts->peepholeStats){
+            printPeepholeStats(out, &loaded);
+        }
+        printProfile(out, hatchling, prof);
+        if(opts->profilePath && !writeProfileJson(opts->profilePath, hatchling, prof)){
+            fprintf(out, "Could not open %s for writing\n", opts->profilePath);
+        }
+        free(prof);
+        return;
+    }
+    if(opts->tracePath){
+        unsigned long long dropped = 0;
+        if(!traceRun(hatchling, opts->tracePath, opts->maxSteps, opts->maxTime, &dropped)){
+            fprintf(out, "Could not write trace %s\n", opts->tracePath);
+        }
+        else if(dropped){
+            fprintf(out, "*** TRACE IS MISSING %llu STEPS, THE WRITER FELL BEHIND ***\n", dropped);
+        }
+    }
+    else if(opts->maxSteps || opts->maxTime > 0 || opts->detectLoops){
+        executeGuarded(hatchling, opts);
+    }
+    else if(opts->variantFn){
+        //a program that provably never faults doesn't need the strict loop's checks
+        VariantFn loop = opts->variantFn;
+        if(opts->optimize && analysis.allSafe && loop == hmlRunStrict){
+            loop = hmlRunWrapping;
+        }
+        HmlStatus status;
+        do{
+            status = loop(hatchling, &opts->instrument);
+            reportStatus(out, status);
+        }while(status == HML_BAD_INPUT);
+    }
+    else{
+        run(hatchling, opts->engine, opts->jit, opts->optimize ? &analysis : NULL);
+    }
+
+    //Hatchling computer dump
+    finishDump(hatchling, loaded.mem, opts);
+    if(opts->peepholeStats){
+        printPeepholeStats(out, &loaded);
+    }
+}
+
+//================================================
+// 64-bit mixing for cache keys, one word at a
+// time, with a final avalanche
+//================================================
+unsigned long long cacheMix(unsigned long long h, unsigned long long v){
+    h ^= v * 0x9E3779B97F4A7C15ULL;
+    h = (h << 31 | h >> 33) * 0xC2B2AE3D27D4EB4FULL;
+    return h;
+}
+
+unsigned long long cacheFinish(unsigned long long h){
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    return h ^ (h >> 33);
+}
+
+//================================================
+// keys a loaded program and every READ value in
+// its --stream input
+//================================================
+CacheKey cacheKey(const Hatchling * hatchling, const StreamInput *input){
+    unsigned long long lo = 0x243F6A8885A308D3ULL;
+    unsigned long long hi = 0x13198A2E03707344ULL;
+    for(int i = 0; i < 256; i += 4){
+        unsigned long long w;
+        memcpy(&w, &hatchling->mem[i], sizeof(w));
+        lo = cacheMix(lo, w);
+        hi = cacheMix(hi, w ^ i);
+    }
+    lo = cacheMix(lo, hatchling->instructCntr);
+    hi = cacheMix(hi, hatchling->instructCntr);
+
+    StreamInput tokens = *input;
+    tokens.pos = 0;
+    long value;
+    unsigned long long n = 0;
+    while(streamToken(&tokens, &value)){
+        lo = cacheMix(lo, value);
+        hi = cacheMix(hi, value + n);
+        n++;
+    }
+    CacheKey key = {cacheFinish(cacheMix(lo, n)), cacheFinish(cacheMix(hi, ~n))};
+    return key;
+}
+
+//================================================
+// sets up a cache with capacity in-memory
+// entries (0 for none) and the cache file at
+// path, created with CACHE_SLOTS slots if it
+// doesn't exist (NULL for none). Returns NULL if
+// the file can't be used.
+//================================================
+ResultCache *cacheCreate(int capacity, const char *path, int verifyEvery){
+    ResultCache *cache = calloc(1, sizeof(ResultCache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->verifyEvery = verifyEvery;
+    cache->newest = cache->oldest = -1;
+    if(capacity > 0){
+        cache->capacity = capacity;
+        cache->entries = malloc(capacity * sizeof(CacheEntry));
+        cache->nBuckets = capacity * 2;
+        cache->buckets = malloc(cache->nBuckets * sizeof(int));
+        for(int b = 0; b < cache->nBuckets; b++){
+            cache->buckets[b] = -1;
+        }
+    }
+    if(path == NULL){
+        return cache;
+    }
+
+    //whoever creates the file sets it up while holding the lock, everyone else waits for it
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0){
+        cacheDestroy(cache);
+        return NULL;
+    }
+    flock(fd, LOCK_EX);
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if(ok && st.st_size == 0){
+        CacheFileHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, CACHE_MAGIC, 4);
+        hdr.version = CACHE_VERSION;
+        hdr.nSlots = CACHE_SLOTS;
+        ok = ftruncate(fd, sizeof(hdr) + (off_t)CACHE_SLOTS * sizeof(CacheSlot)) == 0 && pwrite(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr);
+        st.st_size = sizeof(hdr) + (off_t)CACHE_SLOTS * sizeof(CacheSlot);
+    }
+    flock(fd, LOCK_UN);
+    void *map = ok ? mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(map == MAP_FAILED){
+        cacheDestroy(cache);
+        return NULL;
+    }
+    CacheFileHeader *hdr = map;
+    if((size_t)st.st_size < sizeof(*hdr) || memcmp(hdr->magic, CACHE_MAGIC, 4) != 0 || hdr->version != CACHE_VERSION ||
+       hdr->nSlots == 0 || hdr->nSlots % CACHE_WAYS != 0 || (size_t)st.st_size < sizeof(*hdr) + hdr->nSlots * sizeof(CacheSlot)){
+        munmap(map, st.st_size);
+        cacheDestroy(cache);
+        return NULL;
+    }
+    cache->file = hdr;
+    cache->slots = (CacheSlot *)(hdr + 1);
+    cache->fileLen = st.st_size;
+    return cache;
+}
+
+void cacheDestroy(ResultCache *cache){
+    if(cache->file){
+        munmap(cache->file, cache->fileLen);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache);
+}
+
+//================================================
+// in-memory LRU, called with the lock held
+//================================================
+void cacheUnlink(ResultCache *cache, int e){
+    CacheEntry *entry = &cache->entries[e];
+    if(entry->newer >= 0){
+        cache->entries[entry->newer].older = entry->older;
+    }
+    else{
+        cache->newest = entry->older;
+    }
+    if(entry->older >= 0){
+        cache->entries[entry->older].newer = entry->newer;
+    }
+    else{
+        cache->oldest = entry->newer;
+    }
+}
+
+void cachePushNewest(ResultCache *cache, int e){
+    CacheEntry *entry = &cache->entries[e];
+    entry->newer = -1;
+    entry->older = cache->newest;
+    if(cache->newest >= 0){
+        cache->entries[cache->newest].newer = e;
+    }
+    cache->newest = e;
+    if(cache->oldest < 0){
+        cache->oldest = e;
+    }
+}
+
+int cacheFind(ResultCache *cache, CacheKey key){
+    int e = cache->buckets[key.lo % cache->nBuckets];
+    while(e >= 0 && (cache->entries[e].key.lo != key.lo || cache->entries[e].key.hi != key.hi)){
+        e = cache->entries[e].chain;
+    }
+    return e;
+}
+
+void cacheInsertMemory(ResultCache *cache, CacheKey key, const CacheResult *result){
+    int e = cacheFind(cache, key);
+    if(e >= 0){
+        cacheUnlink(cache, e);
+    }
+    else{
+        if(cache->used < cache->capacity){
+            e = cache->used++;
+        }
+        else{
+            //evict the least recently used entry and take it out of its bucket
+            e = cache->oldest;
+            cacheUnlink(cache, e);
+            int *link = &cache->buckets[cache->entries[e].key.lo % cache->nBuckets];
+            while(*link != e){
+                link = &cache->entries[*link].chain;
+            }
+            *link = cache->entries[e].chain;
+        }
+        int *bucket = &cache->buckets[key.lo % cache->nBuckets];
+        cache->entries[e].chain = *bucket;
+        *bucket = e;
+        cache->entries[e].key = key;
+    }
+    cache->entries[e].result = *result;
+    cachePushNewest(cache, e);
+}
+
+//================================================
+// cache file: first slot of the set key lives in
+//================================================
+CacheSlot *cacheSet(ResultCache *cache, CacheKey key){
+    return &cache->slots[key.lo % (cache->file->nSlots / CACHE_WAYS) * CACHE_WAYS];
+}
+
+bool cacheReadFile(ResultCache *cache, CacheKey key, CacheResult *result){
+    CacheSlot *set = cacheSet(cache, key);
+    for(int w = 0; w < CACHE_WAYS; w++){
+        CacheSlot *slot = &set[w];
+        unsigned int seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if(seq == 0 || seq & 1 || slot->key.lo != key.lo || slot->key.hi != key.hi){
+            continue;
+        }
+        memcpy(result, &slot->result, sizeof(*result));
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq && slot->key.lo == key.lo && slot->key.hi == key.hi){
+            atomic_store_explicit(&slot->stamp, atomic_fetch_add(&cache->file->clock, 1), memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void cacheWriteFile(ResultCache *cache, CacheKey key, const CacheResult *result){
+    CacheSlot *set = cacheSet(cache, key);
+    unsigned int now = atomic_fetch_add(&cache->file->clock, 1);
+
+    //the slot already holding the key, otherwise the least recently used one
+    CacheSlot *victim = &set[0];
+    for(int w = 0; w < CACHE_WAYS; w++){
+        CacheSlot *slot = &set[w];
+        if(slot->key.lo == key.lo && slot->key.hi == key.hi){
+            victim = slot;
+            break;
+        }
+        if(now - atomic_load_explicit(&slot->stamp, memory_order_relaxed) > now - atomic_load_explicit(&victim->stamp, memory_order_relaxed)){
+            victim = slot;
+        }
+    }
+
+    //another process writing the slot wins, this result just isn't shared
+    unsigned int seq = atomic_load_explicit(&victim->seq, memory_order_relaxed);
+    if(seq & 1 || !atomic_compare_exchange_strong_explicit(&victim->seq, &seq, seq + 1, memory_order_acquire, memory_order_relaxed)){
+        return;
+    }
+    atomic_thread_fence(memory_order_release);
+    victim->key = key;
+    memcpy(&victim->result, result, sizeof(*result));
+    atomic_store_explicit(&victim->stamp, now, memory_order_relaxed);
+    atomic_store_explicit(&victim->seq, seq + 2, memory_order_release);
+}
+
+//================================================
+// looks a key up in memory, then in the file.
+// File hits are copied into memory.
+//================================================
+bool cacheLookup(ResultCache *cache, CacheKey key, CacheResult *result){
+    bool found = false;
+    if(cache->capacity){
+        pthread_mutex_lock(&cache->lock);
+        int e = cacheFind(cache, key);
+        if(e >= 0){
+            *result = cache->entries[e].result;
+            cacheUnlink(cache, e);
+            cachePushNewest(cache, e);
+            found = true;
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+    if(!found && cache->file && cacheReadFile(cache, key, result)){
+        found = true;
+        if(cache->capacity){
+            pthread_mutex_lock(&cache->lock);
+            cacheInsertMemory(cache, key, result);
+            pthread_mutex_unlock(&cache->lock);
+        }
+    }
+    atomic_fetch_add(found ? &cache->hits : &cache->misses, 1);
+    return found;
+}
+
+void cacheStore(ResultCache *cache, CacheKey key, const CacheResult *result){
+    if(cache->capacity){
+        pthread_mutex_lock(&cache->lock);
+        cacheInsertMemory(cache, key, result);
+        pthread_mutex_unlock(&cache->lock);
+    }
+    if(cache->file){
+        cacheWriteFile(cache, key, result);
+    }
+    atomic_fetch_add(&cache->stores, 1);
+}
+
+//================================================
+// the registers and memory a finished run left
+// in hatchling, into the result being recorded
+//================================================
+void cacheCapture(CacheResult *result, const Hatchling * hatchling){
+    result->accumulator = hatchling->accumulator;
+    result->instructReg = hatchling->instructReg;
+    result->instructCntr = hatchling->instructCntr;
+    result->opCode = hatchling->opCode;
+    result->operand = hatchling->operand;
+    result->fatalError = hatchling->fatalError;
+    result->termination = hmlTermination(hatchling);
+    memcpy(result->mem, hatchling->mem, sizeof(result->mem));
+}
+
+bool cacheSame(const CacheResult *a, const CacheResult *b){
+    return a->accumulator == b->accumulator && a->instructReg == b->instructReg && a->instructCntr == b->instructCntr &&
+           a->fatalError == b->fatalError && a->termination == b->termination && a->nOutputs == b->nOutputs &&
+           memcmp(a->outputs, b->outputs, a->nOutputs * sizeof(signed short)) == 0 && memcmp(a->mem, b->mem, sizeof(a->mem)) == 0;
+}
+
+//================================================
+// whether a run with these options prints only
+// what a cached result can reproduce
+//================================================
+bool cacheable(const Options * opts){
+    return opts->cache && !opts->emitC && !opts->profile && !opts->peepholeStats && !opts->tracePath &&
+           !opts->maxSteps && opts->maxTime <= 0 && !opts->detectLoops &&
+           (opts->variant == VARIANT_NONE || opts->variant == VARIANT_STRICT);
+}
+
+//================================================
+// --stream run through the result cache. A hit
+// prints what the run would have printed without
+// running it, a miss runs the program and stores
+// what it did. One hit in --cache-verify runs
+// anyway, silently, and is checked against the
+// cached result.
+//================================================
+void simulateCached(Hatchling * hatchling, StreamInput *input, const Options * opts){
+    if(hatchling->fatalError || !cacheable(opts)){
+        simulate(hatchling, opts);
+        return;
+    }
+    ResultCache *cache = opts->cache;
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+    CacheKey key = cacheKey(hatchling, input);
+    CacheResult *result = malloc(sizeof(CacheResult));
+    Hatchling loaded = *hatchling;
+
+    if(cacheLookup(cache, key, result)){
+        bool trusted = true;
+        if(cache->verifyEvery > 0 && atomic_load(&cache->hits) % cache->verifyEvery == 0){
+            CacheResult *check = calloc(1, sizeof(CacheResult));
+            Hatchling h = loaded;
+            StreamInput in = *input;
+            in.record = check;
+            h.in = &in;
+            h.out = fopen("/dev/null", "w");
+            run(&h, opts->engine, opts->jit, NULL);
+            fclose(h.out);
+            cacheCapture(check, &h);
+            atomic_fetch_add(&cache->verified, 1);
+            if(!cacheSame(check, result)){
+                atomic_fetch_add(&cache->mismatches, 1);
+                trusted = false;
+            }
+            free(check);
+        }
+        if(trusted){
+            fprintf(out, "*** PROGRAM LOADING COMPLETED ***\n");
+            fprintf(out, "*** PROGRAM EXECUTION BEGINS ***\n");
+            for(int i = 0; i < result->nOutputs; i++){
+                streamWrite(hatchling, result->outputs[i]);
+            }
+            hatchling->accumulator = result->accumulator;
+            hatchling->instructReg = result->instructReg;
+            hatchling->instructCntr = result->instructCntr;
+            hatchling->opCode = result->opCode;
+            hatchling->operand = result->operand;
+            hatchling->fatalError = result->fatalError;
+            memcpy(hatchling->mem, result->mem, sizeof(hatchling->mem));
+            static const HmlStatus banners[] = {HML_HALTED, HML_OVERFLOW, HML_DIVIDE_BY_ZERO, HML_UNDEFINED_OPCODE, HML_END_OF_INPUT};
+            if(result->termination < sizeof(banners) / sizeof(banners[0])){
+                reportStatus(out, banners[result->termination]);
+            }
+            finishDump(hatchling, loaded.mem, opts);
+            free(result);
+            return;
+        }
+    }
+
+    //a miss, or a hit that didn't check out: run it and keep what it did
+    memset(result, 0, sizeof(*result));
+    input->record = result;
+    input->uncacheable = false;
+    simulate(hatchling, opts);
+    input->record = NULL;
+    if(!input->uncacheable){
+        cacheCapture(result, hatchling);
+        cacheStore(cache, key, result);
+    }
+    free(result);
+}
+
+//================================================
+// --cache-stats: the counters of every run this
+// process made through the cache
+//================================================
+void printCacheStats(FILE *out, ResultCache *cache){
+    fprintf(out, "*** RESULT CACHE: %llu HITS, %llu MISSES, %llu STORED, %llu VERIFIED, %llu MISMATCHED ***\n",
+            atomic_load(&cache->hits), atomic_load(&cache->misses), atomic_load(&cache->stores),
+            atomic_load(&cache->verified), atomic_load(&cache->mismatches));
+}
+
+//================================================
+// --stream: runs a loaded program with READ
+// input from --input (or the rest of stdin) and
+// no prompts. Everything the run prints is
+// buffered and written to stdout at once.
+//================================================
+void simulateStream(Hatchling * hatchling, const Options * opts){
+    FILE *in = opts->inputPath ? fopen(opts->inputPath, "r") : stdin;
+    if(in == NULL){
+        printf("Could not open input file %s\n", opts->inputPath);
+        return;
+    }
+    char *output;
+    size_t outputLen;
+    FILE *out = open_memstream(&output, &outputLen);
+    StreamInput input;
+    streamOpen(hatchling, &input, in);
+    hatchling->out = out;
+    simulateCached(hatchling, &input, opts);
+    fclose(out);
+
+    //whatever the loader printed goes first
+    fflush(stdout);
+    writeFully(STDOUT_FILENO, output, outputLen);
+    free(output);
+    streamClose(&input);
+    if(in != stdin){
+        fclose(in);
+    }
+}
+
+//================================================
+// runs one batch job in its own Hatchling
+// context: input comes from the job's input
+// file and everything the run prints is
+// buffered in the job's output
+//================================================
+void runBatchJob(BatchJob *job, const Options * opts){
+    FILE *out = open_memstream(&job->output, &job->outputLen);
+    FILE *in = fopen(job->inputPath ? job->inputPath : "/dev/null", "r");
+    FILE *hp = job->image ? NULL : fopen(job->path, "r");
+
+    if(job->image && in){
+        Hatchling h;
+        loadImage(&h, job->image, out);
+        h.in = in;
+        h.out = out;
+        if(opts->stream){
+            StreamInput input;
+            streamOpen(&h, &input, in);
+            simulateCached(&h, &input, opts);
+            streamClose(&input);
+        }
+        else{
+            simulate(&h, opts);
+        }
+    }
+    else if(hp == NULL){
+        fprintf(out, "Please enter a valid filepath\n");
+    }
+    else if(in == NULL){
+        fprintf(out, "Could not open input file %s\n", job->inputPath);
+    }
+    else{
+        Hatchling h;
+        readFile(&h, hp, out);
+        h.in = in;
+        h.out = out;
+        if(opts->stream){
+            StreamInput input;
+            streamOpen(&h, &input, in);
+            simulateCached(&h, &input, opts);
+            streamClose(&input);
+        }
+        else{
+            simulate(&h, opts);
+        }
+    }
+
+    if(hp){
+        fclose(hp);
+    }
+    if(in){
+        fclose(in);
+    }
+    fclose(out);
+}
+
+//================================================
+// takes the next job for a worker: from the
+// tail of its own queue, otherwise stolen from
+// the head of another worker's queue. Returns
+// -1 once every queue is empty.
+//================================================
+int nextBatchJob(Batch *batch, int id){
+    for(int k = 0; k < batch->nWorkers; k++){
+        WorkQueue *q = &batch->queues[(id + k) % batch->nWorkers];
+        int job = -1;
+        pthread_mutex_lock(&q->lock);
+        if(q->head < q->tail){
+            job = k == 0 ? q->jobs[--q->tail] : q->jobs[q->head++];
+        }
+        pthread_mutex_unlock(&q->lock);
+        if(job >= 0){
+            return job;
+        }
+    }
+    return -1;
+}
+
+//================================================
+// batch worker thread
+//================================================
+void *batchWorker(void *arg){
+    BatchWorker *worker = arg;
+    Batch *batch = worker->batch;
+    int job;
+    while((job = nextBatchJob(batch, worker->id)) >= 0){
+        runBatchJob(&batch->jobs[job], batch->opts);
+        pthread_mutex_lock(&batch->doneLock);
+        batch->jobs[job].done = true;
+        pthread_cond_broadcast(&batch->doneCond);
+        pthread_mutex_unlock(&batch->doneLock);
+    }
+    return NULL;
+}
+
+//================================================
+// adds a job to the batch, growing the job
+// array as needed
+//================================================
+void addBatchJob(Batch *batch, int *capacity, const char *path, const char *inputPath){
+    if(batch->nJobs == *capacity){
+        *capacity = *capacity ? *capacity * 2 : 64;
+        batch->jobs = realloc(batch->jobs, *capacity * sizeof(BatchJob));
+    }
+    BatchJob *job = &batch->jobs[batch->nJobs++];
+    memset(job, 0, sizeof(BatchJob));
+    job->path = strdup(path);
+    job->inputPath = inputPath ? strdup(inputPath) : NULL;
+}
+
+int compareNames(const void *a, const void *b){
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+//================================================
+// collects batch jobs from a directory: every
+// .hml file in name order, with input read from
+// a matching .in file when there is one
+//================================================
+bool readBatchDirectory(Batch *batch, const char *path){
+    DIR *dir = opendir(path);
+    if(dir == NULL){
+        return false;
+    }
+    char **names = NULL;
+    int nNames = 0;
+    struct dirent *entry;
+    while((entry = readdir(dir))){
+        size_t len = strlen(entry->d_name);
+        if(len > 4 && strcmp(entry->d_name + len - 4, ".hml") == 0){
+            names = realloc(names, (nNames + 1) * sizeof(char *));
+            names[nNames++] = strdup(entry->d_name);
+        }
+    }
+    closedir(dir);
+    qsort(names, nNames, sizeof(char *), compareNames);
+
+    int capacity = 0;
+    for(int i = 0; i < nNames; i++){
+        size_t len = strlen(path) + strlen(names[i]) + 2;
+        char *prog = malloc(len);
+        char *input = malloc(len);
+        snprintf(prog, len, "%s/%s", path, names[i]);
+        snprintf(input, len, "%s/%s", path, names[i]);
+        strcpy(input + strlen(input) - 4, ".in");
+        addBatchJob(batch, &capacity, prog, access(input, R_OK) == 0 ? input : NULL);
+        free(prog);
+        free(input);
+        free(names[i]);
+    }
+    free(names);
+    return true;
+}
+
+//================================================
+// collects batch jobs from a .hmc container, one
+// per image. The container stays mapped for the
+// whole batch and jobs load their image in place.
+// Prints its own diagnostic when it fails.
+//================================================
+bool readBatchContainer(Batch *batch, const char *path){
+    FILE *f = fopen(path, "r");
+    if(f == NULL){
+        printf("Please enter a valid manifest or directory\n");
+        return false;
+    }
+    batch->container = mapStream(f, &batch->containerLen, &batch->containerMapped);
+    fclose(f);
+
+    //the magic alone doesn't make a header, a shorter file has no count to read
+    const ContainerHeader *hdr = hmlAsContainer(batch->container, batch->containerLen);
+    if(hdr == NULL || batch->containerLen < sizeof(ContainerHeader) + (size_t)LE32(hdr->count) * sizeof(ProgramImage)){
+        printf("TRUNCATED CONTAINER %s\n", path);
+        unmapStream(batch->container, batch->containerLen, batch->containerMapped);
+        batch->container = NULL;
+        return false;
+    }
+
+    int capacity = 0;
+    unsigned int count = LE32(hdr->count);
+    const ProgramImage *images = (const ProgramImage *)(batch->container + sizeof(ContainerHeader));
+    for(unsigned int k = 0; k < count; k++){
+        char label[4096];
+        snprintf(label, sizeof(label), "%s#%u", path, k + 1);
+        addBatchJob(batch, &capacity, label, NULL);
+        batch->jobs[batch->nJobs - 1].image = &images[k];
+    }
+    return true;
+}
+
+//================================================
+// true if the file at path starts with the
+// container magic number
+//================================================
+bool isContainerFile(const char *path){
+    char magic[4];
+    FILE *f = fopen(path, "r");
+    if(f == NULL){
+        return false;
+    }
+    bool found = fread(magic, 1, 4, f) == 4 && memcmp(magic, CONTAINER_MAGIC, 4) == 0;
+    fclose(f);
+    return found;
+}
+
+//================================================
+// collects batch jobs from a manifest: one job
+// per line, "program.hml [input-file]". Blank
+// lines and lines starting with # are skipped.
+//================================================
+bool readBatchManifest(Batch *batch, const char *path){
+    FILE *f = fopen(path, "r");
+    if(f == NULL){
+        return false;
+    }
+    int capacity = 0;
+    char line[4096];
+    while(fgets(line, sizeof(line), f)){
+        char prog[2048];
+        char input[2048];
+        int n = sscanf(line, "%2047s %2047s", prog, input);
+        if(n < 1 || prog[0] == '#'){
+            continue;
+        }
+        addBatchJob(batch, &capacity, prog, n == 2 ? input : NULL);
+    }
+    fclose(f);
+    return true;
+}
+
+//================================================
+// batch mode: runs every program listed in a
+// manifest (or found in a directory) on a
+// work-stealing pool of worker threads, and
+// writes each job's output to standard output
+// in manifest order as soon as it's ready
+//================================================
+int runBatch(const char *path, const Options * opts){
+    Batch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.opts = opts;
+
+    DIR *dir = opendir(path);
+    bool loaded;
+    if(dir){
+        closedir(dir);
+        loaded = readBatchDirectory(&batch, path);
+    }
+    else if(isContainerFile(path)){
+        if(!readBatchContainer(&batch, path)){
+            return 1;
+        }
+        loaded = true;
+    }
+    else{
+        loaded = readBatchManifest(&batch, path);
+    }
+    if(!loaded){
+        printf("Please enter a valid manifest or directory\n");
+        return 1;
+    }
+
+    //one worker per core unless told otherwise, but never more than there are jobs
+    int nWorkers = opts->threads > 0 ? opts->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(nWorkers > batch.nJobs){
+        nWorkers = batch.nJobs;
+    }
+    if(nWorkers < 1){
+        nWorkers = 1;
+    }
+    batch.nWorkers = nWorkers;
+
+    //deal jobs out in contiguous runs so workers start on separate parts of the manifest
+    batch.queues = calloc(nWorkers, sizeof(WorkQueue));
+    for(int w = 0; w < nWorkers; w++){
+        WorkQueue *q = &batch.queues[w];
+        int first = (int)((long)batch.nJobs * w / nWorkers);
+        int last = (int)((long)batch.nJobs * (w + 1) / nWorkers);
+        pthread_mutex_init(&q->lock, NULL);
+        q->jobs = malloc((last - first + 1) * sizeof(int));
+        for(int i = last - 1; i >= first; i--){
+            q->jobs[q->tail++] = i;
+        }
+    }
+    pthread_mutex_init(&batch.doneLock, NULL);
+    pthread_cond_init(&batch.doneCond, NULL);
+
+    pthread_t *threads = malloc(nWorkers * sizeof(pthread_t));
+    BatchWorker *workers = malloc(nWorkers * sizeof(BatchWorker));
+    for(int w = 0; w < nWorkers; w++){
+        workers[w].batch = &batch;
+        workers[w].id = w;
+        pthread_create(&threads[w], NULL, batchWorker, &workers[w]);
+    }
+
+    //write results in manifest order while later jobs are still running
+    for(int i = 0; i < batch.nJobs; i++){
+        BatchJob *job = &batch.jobs[i];
+        pthread_mutex_lock(&batch.doneLock);
+        while(!job->done){
+            pthread_cond_wait(&batch.doneCond, &batch.doneLock);
+        }
+        pthread_mutex_unlock(&batch.doneLock);
+
+        printf("*** BATCH JOB %d: %s ***\n", i + 1, job->path);
+        fwrite(job->output, 1, job->outputLen, stdout);
+        free(job->output);
+        free(job->path);
+        free(job->inputPath);
+    }
+
+    for(int w = 0; w < nWorkers; w++){
+        pthread_join(threads[w], NULL);
+        pthread_mutex_destroy(&batch.queues[w].lock);
+        free(batch.queues[w].jobs);
+    }
+    pthread_mutex_destroy(&batch.doneLock);
+    pthread_cond_destroy(&batch.doneCond);
+    free(threads);
+    free(workers);
+    free(batch.queues);
+    free(batch.jobs);
+    if(batch.container){
+        unmapStream(batch.container, batch.containerLen, batch.containerMapped);
+    }
+    return 0;
+}
+
+//================================================
+// prints the banner for a status a lane or core
+// stopped with to its own output
+//================================================
+void reportLane(Hatchling * hatchling, HmlStatus status){
+    reportStatus(hatchling->out ? hatchling->out : stdout, status);
+}
+
+//================================================
+// lockstep mode: runs one program once per line
+// of the lanes file, each line holding the READ
+// inputs of one lane, and prints each lane's
+// output (the same as a run of the program on
+// that input) in order
+//================================================
+int runLanes(Hatchling * hatchling, const char *path, const Options * opts){
+    FILE *f = fopen(path, "r");
+    if(f == NULL){
+        printf("Please enter a valid lanes file\n");
+        return 1;
+    }
+
+    //one input set per line
+    char **inputs = NULL;
+    int nLanes = 0;
+    char *line = NULL;
+    size_t cap = 0;
+    while(getline(&line, &cap, f) > 0){
+        inputs = realloc(inputs, (nLanes + 1) * sizeof(char *));
+        inputs[nLanes++] = strdup(line);
+    }
+    free(line);
+    fclose(f);
+
+    char **outputs = calloc(nLanes, sizeof(char *));
+    size_t *outputLens = calloc(nLanes, sizeof(size_t));
+    FILE **ins = calloc(nLanes, sizeof(FILE *));
+    FILE **outs = calloc(nLanes, sizeof(FILE *));
+    for(int i = 0; i < nLanes; i++){
+        ins[i] = fmemopen(inputs[i], strlen(inputs[i]), "r");
+        outs[i] = open_memstream(&outputs[i], &outputLens[i]);
+    }
+
+    //hmlLanesCreate gives NULL when the library was built without SIMD
+    HmlLanes *lanes = NULL;
+    if(opts->simd != SIMD_SCALAR && nLanes > 0){
+        lanes = hmlLanesCreate(hatchling, nLanes, reportLane);
+    }
+    if(lanes){
+        for(int i = 0; i < nLanes; i++){
+            hmlLanesSetIo(lanes, i, stdioRead, stdioWrite, ins[i], outs[i]);
+            fprintf(outs[i], "*** PROGRAM LOADING COMPLETED ***\n");
+            fprintf(outs[i], "*** PROGRAM EXECUTION BEGINS ***\n");
+        }
+
+        hmlLanesRun(lanes, opts->simd);
+
+        //gather each lane back into a Hatchling for its dump
+        for(int i = 0; i < nLanes; i++){
+            Hatchling h;
+            stdioInit(&h);
+            h.out = outs[i];
+            hmlLanesGet(lanes, i, &h);
+            printDump(&h);
+        }
+        hmlLanesDestroy(lanes);
+    }
+    else
+    {
+        //scalar fallback, every lane is an ordinary run
+        for(int i = 0; i < nLanes; i++){
+            Hatchling h = *hatchling;
+            h.in = ins[i];
+            h.out = outs[i];
+            simulate(&h, opts);
+        }
+    }
+
+    for(int i = 0; i < nLanes; i++){
+        fclose(ins[i]);
+        fclose(outs[i]);
+        printf("*** LANE %d ***\n", i + 1);
+        fwrite(outputs[i], 1, outputLens[i], stdout);
+        free(outputs[i]);
+        free(inputs[i]);
+    }
+    free(inputs);
+    free(outputs);
+    free(outputLens);
+    free(ins);
+    free(outs);
+    return 0;
+}
+
+//================================================
+// saves the complete state of a Hatchling
+//================================================
+void takeSnapshot(Snapshot *snap, const Hatchling * hatchling){
+    snap->accumulator = hatchling->accumulator;
+    snap->instructReg = hatchling->instructReg;
+    snap->instructCntr = hatchling->instructCntr;
+    snap->opCode = hatchling->opCode;
+    snap->operand = hatchling->operand;
+    snap->fatalError = hatchling->fatalError;
+    snap->stop = hatchling->stop;
+    memcpy(snap->mem, hatchling->mem, sizeof(snap->mem));
+}
+
+//================================================
+// puts a Hatchling back into a saved state. With
+// a dirty set filled in by the run since the
+// state was last restored, only the words it
+// marks are written back and the set is
+// cleared, so a run that dirtied a handful of
+// words costs a handful of stores to undo.
+// Without one all of memory is copied.
+//================================================
+void restoreSnapshot(Hatchling * hatchling, const Snapshot *snap, unsigned long long *dirty){
+    hatchling->accumulator = snap->accumulator;
+    hatchling->instructReg = snap->instructReg;
+    hatchling->instructCntr = snap->instructCntr;
+    hatchling->opCode = snap->opCode;
+    hatchling->operand = snap->operand;
+    hatchling->fatalError = snap->fatalError;
+    hatchling->stop = snap->stop;
+    if(dirty == NULL){
+        memcpy(hatchling->mem, snap->mem, sizeof(snap->mem));
+        return;
+    }
+    for(int k = 0; k < DIRTY_WORDS; k++){
+        for(unsigned long long bits = dirty[k]; bits; bits &= bits - 1){
+            int i = k * 64 + __builtin_ctzll(bits);
+            hatchling->mem[i] = snap->mem[i];
+        }
+        dirty[k] = 0;
+    }
+}
+
+//================================================
+// execute() that also records every control
+// transfer out of a branch instruction as an
+// edge (branch address, next address) in the
+// coverage bitmap, and every word a STOR or
+// READ writes in the dirty set
+//================================================
+void executeCovered(Hatchling * hatchling, unsigned char *coverage, unsigned long long maxSteps, unsigned long long *dirty){
+    unsigned long long steps = 0;
+    while(hatchling->opCode != HALT && hatchling->fatalError == false){
+        if(maxSteps && steps++ == maxSteps){
+            hatchling->stop = TERM_STEP_LIMIT;
+            hatchling->fatalError = true;
+            return;
+        }
+        unsigned char from = hatchling->instructCntr;
+        hatchling->instructReg = hatchling->mem[from];
+        hatchling->opCode = hatchling->instructReg >> 8;
+        hatchling->operand = hatchling->instructReg & 0xFF;
+        executeInstruction(hatchling);
+        if(hatchling->opCode == STOR || hatchling->opCode == READ){
+            MARK_DIRTY(dirty, hatchling->operand);
+        }
+        if((hatchling->opCode & 0xF0) == B && hatchling->opCode <= BZRO){
+            unsigned int edge = from << 8 | hatchling->instructCntr;
+            coverage[edge >> 3] |= 1 << (edge & 7);
+        }
+    }
+}
+
+//================================================
+// reads or writes exactly n bytes on a pipe
+//================================================
+bool readFully(int fd, void *buf, size_t n){
+    while(n > 0){
+        ssize_t got = read(fd, buf, n);
+        if(got <= 0){
+            return false;
+        }
+        buf = (char *)buf + got;
+        n -= got;
+    }
+    return true;
+}
+
+bool writeFully(int fd, const void *buf, size_t n){
+    while(n > 0){
+        ssize_t put = write(fd, buf, n);
+        if(put <= 0){
+            return false;
+        }
+        buf = (const char *)buf + put;
+        n -= put;
+    }
+    return true;
+}
+
+//================================================
+// --fork-server: a persistent fuzzing loop. The
+// loaded program is snapshotted once, then for
+// every request on stdin it runs with the
+// request as its READ input until HALT or a
+// fatal error, answers on stdout, and is reset
+// from the snapshot. The program's own output
+// is discarded. --max-steps bounds every run,
+// a run that uses it up answers TERM_STEP_LIMIT.
+//
+// request:  u32 length, then length bytes of
+//           READ input (length 0xFFFFFFFF ends
+//           the server)
+// response: u32 Termination, then the
+//           COVERAGE_BYTES edge bitmap unless
+//           --coverage=FILE shares it through a
+//           mapped file instead
+// All integers are in host byte order.
+//================================================
+int runForkServer(Hatchling * hatchling, const Options * opts){
+    unsigned char *coverage;
+    bool shared = opts->coveragePath != NULL;
+    if(shared){
+        int fd = open(opts->coveragePath, O_RDWR | O_CREAT, 0600);
+        if(fd < 0 || ftruncate(fd, COVERAGE_BYTES) != 0){
+            fprintf(stderr, "Could not open coverage file %s\n", opts->coveragePath);
+            return 1;
+        }
+        coverage = mmap(NULL, COVERAGE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(coverage == MAP_FAILED){
+            fprintf(stderr, "Could not map coverage file %s\n", opts->coveragePath);
+            return 1;
+        }
+    }
+    else{
+        coverage = malloc(COVERAGE_BYTES);
+    }
+
+    Snapshot snap;
+    takeSnapshot(&snap, hatchling);
+    unsigned long long dirty[DIRTY_WORDS] = {0};
+    FILE *sink = fopen("/dev/null", "w");
+    hatchling->out = sink;
+
+    char *input = NULL;
+    unsigned int cap = 0;
+    unsigned int len;
+    while(readFully(STDIN_FILENO, &len, 4) && len != 0xFFFFFFFF){
+        if(len + 1 > cap){
+            cap = len + 1;
+            input = realloc(input, cap);
+        }
+        if(!readFully(STDIN_FILENO, input, len)){
+            break;
+        }
+
+        //fmemopen() can't open an empty buffer, a blank line reads as end of input just the same
+        if(len == 0){
+            input[len++] = '\n';
+        }
+        FILE *in = fmemopen(input, len, "r");
+        hatchling->in = in;
+        memset(coverage, 0, COVERAGE_BYTES);
+        executeCovered(hatchling, coverage, opts->maxSteps, dirty);
+        fclose(in);
+
+        unsigned int status = hmlTermination(hatchling);
+        if(!writeFully(STDOUT_FILENO, &status, 4) || (!shared && !writeFully(STDOUT_FILENO, coverage, COVERAGE_BYTES))){
+            break;
+        }
+        restoreSnapshot(hatchling, &snap, dirty);
+    }
+
+    fclose(sink);
+    free(input);
+    if(shared){
+        munmap(coverage, COVERAGE_BYTES);
+    }
+    else{
+        free(coverage);
+    }
+    return 0;
+}
+
+//================================================
+// execute() with profiling counters: steps per
+// opcode and per address, taken/not-taken per
+// conditional branch, and taken jumps that go
+// back to (or before) themselves, whose targets
+// are the program's loop headers. The fetched
+// word is counted even when it faults, the same
+// way the dump reports it. Loads, stores and
+// branches run inline on local registers, the
+// rest goes through executeInstruction(). The
+// run stops like executeGuarded() does once it
+// uses up maxSteps or maxTime (none when 0).
+//================================================
+void executeProfiled(Hatchling * hatchling, Profile *prof, unsigned long long maxSteps, double maxTime){
+    if(hatchling->opCode == HALT || hatchling->fatalError){
+        return;
+    }
+
+    unsigned short *mem = hatchling->mem;
+    signed short acc = hatchling->accumulator;
+    unsigned char pc = hatchling->instructCntr;
+    unsigned long long steps = 0;
+    bool jumped;
+    unsigned long long limit = maxSteps ? maxSteps : ~0ULL;
+    double deadline = maxTime > 0 ? nowNs() + maxTime * 1e9 : 0;
+    unsigned long long nextCheck = deadline && limit > TIME_CHECK_STEPS ? TIME_CHECK_STEPS : limit;
+
+    for(;;){
+        if(steps == nextCheck){
+            if(steps == limit){
+                stopRun(hatchling, acc, pc, TERM_STEP_LIMIT, steps, maxTime);
+                break;
+            }
+            if(nowNs() > deadline){
+                stopRun(hatchling, acc, pc, TERM_TIME_LIMIT, steps, maxTime);
+                break;
+            }
+            nextCheck = limit - steps > TIME_CHECK_STEPS ? steps + TIME_CHECK_STEPS : limit;
+        }
+
+        unsigned short word = mem[pc];
+        unsigned char op = word >> 8;
+        unsigned char operand = word & 0xFF;
+        steps++;
+        prof->opCount[op]++;
+        prof->hits[pc]++;
+
+        switch(op){
+            case LOAD:
+                acc = (signed short)mem[operand];
+                pc++;
+                continue;
+            case STOR:
+                mem[operand] = acc;
+                pc++;
+                continue;
+            case B:
+                if(operand <= pc){
+                    prof->backEdges[operand]++;
+                }
+                pc = operand;
+                continue;
+            case BNEG:
+                jumped = acc < 0;
+                goto branch;
+            case BPOS:
+                jumped = acc > 0;
+                goto branch;
+            case BZRO:
+                jumped = acc == 0;
+            branch:
+                if(jumped){
+                    prof->taken[pc]++;
+                    if(operand <= pc){
+                        prof->backEdges[operand]++;
+                    }
+                    pc = operand;
+                }
+                else{
+                    prof->notTaken[pc]++;
+                    pc++;
+                }
+                continue;
+        }
+
+        //everything else, including HALT and faults, takes the reference path
+        hatchling->accumulator = acc;
+        hatchling->instructCntr = pc;
+        hatchling->instructReg = word;
+        hatchling->opCode = op;
+        hatchling->operand = operand;
+        executeInstruction(hatchling);
+        if(op == HALT || hatchling->fatalError){
+            break;
+        }
+        acc = hatchling->accumulator;
+        pc = hatchling->instructCntr;
+    }
+    prof->steps += steps;
+}
+
+//================================================
+// prints the profile as tables under the
+// computer dump
+//================================================
+void printProfile(FILE *out, const Hatchling * hatchling, const Profile *prof){
+    double total = prof->steps ? (double)prof->steps : 1.0;
+
+    fprintf(out, "\n*** PROFILE: %llu STEPS ***\n", prof->steps);
+    fprintf(out, "\nOPCODE      COUNT        %%\n");
+    for(int op = 0; op < 256; op++){
+        if(prof->opCount[op]){
+            const char *name = mnemonic(op);
+            char unknown[8];
+            if(name == NULL){
+                snprintf(unknown, sizeof(unknown), "%02X?", op);
+                name = unknown;
+            }
+            fprintf(out, "%-6s %12llu   %6.2f\n", name, prof->opCount[op], 100.0 * prof->opCount[op] / total);
+        }
+    }
+
+    fprintf(out, "\nADDR  WORD        HITS        %%\n");
+    for(int i = 0; i < 256; i++){
+        if(prof->hits[i]){
+            fprintf(out, "%02X    %04X  %12llu   %6.2f\n", i, hatchling->mem[i], prof->hits[i], 100.0 * prof->hits[i] / total);
+        }
+    }
+
+    bool header = false;
+    for(int i = 0; i < 256; i++){
+        if(prof->taken[i] || prof->notTaken[i]){
+            if(!header){
+                fprintf(out, "\nBRANCH        TAKEN    NOT TAKEN\n");
+                header = true;
+            }
+            fprintf(out, "%02X    %12llu %12llu\n", i, prof->taken[i], prof->notTaken[i]);
+        }
+    }
+
+    header = false;
+    for(int i = 0; i < 256; i++){
+        if(prof->backEdges[i]){
+            if(!header){
+                fprintf(out, "\nLOOP HEADER   ITERATIONS\n");
+                header = true;
+            }
+            fprintf(out, "%02X    %12llu\n", i, prof->backEdges[i]);
+        }
+    }
+}
+
+//================================================
+// writes the profile as a JSON object, listing
+// only addresses and opcodes that ran
+//================================================
+bool writeProfileJson(const char *path, const Hatchling * hatchling, const Profile *prof){
+    FILE *f = fopen(path, "w");
+    if(f == NULL){
+        return false;
+    }
+    Termination why = hmlTermination(hatchling);
+    static const char *const reasons[] = {"halt", "overflow", "divide_by_zero", "undefined_opcode", "end_of_input",
+                                          "step_limit", "time_limit", "infinite_loop"};
+
+    fprintf(f, "{\n  \"steps\": %llu,\n  \"termination\": \"%s\",\n  \"opcodes\": {", prof->steps, reasons[why]);
+    const char *sep = "";
+    for(int op = 0; op < 256; op++){
+        if(prof->opCount[op]){
+            const char *name = mnemonic(op);
+            if(name){
+                fprintf(f, "%s\n    \"%s\": %llu", sep, name, prof->opCount[op]);
+            }
+            else{
+                fprintf(f, "%s\n    \"%02X\": %llu", sep, op, prof->opCount[op]);
+            }
+            sep = ",";
+        }
+    }
+
+    fprintf(f, "\n  },\n  \"addresses\": [");
+    sep = "";
+    for(int i = 0; i < 256; i++){
+        if(prof->hits[i]){
+            fprintf(f, "%s\n    {\"addr\": %d, \"word\": %u, \"hits\": %llu}", sep, i, hatchling->mem[i], prof->hits[i]);
+            sep = ",";
+        }
+    }
+
+    fprintf(f, "\n  ],\n  \"branches\": [");
+    sep = "";
+    for(int i = 0; i < 256; i++){
+        if(prof->taken[i] || prof->notTaken[i]){
+            fprintf(f, "%s\n    {\"addr\": %d, \"taken\": %llu, \"not_taken\": %llu}", sep, i, prof->taken[i], prof->notTaken[i]);
+            sep = ",";
+        }
+    }
+
+    fprintf(f, "\n  ],\n  \"loop_headers\": [");
+    sep = "";
+    for(int i = 0; i < 256; i++){
+        if(prof->backEdges[i]){
+            fprintf(f, "%s\n    {\"addr\": %d, \"iterations\": %llu}", sep, i, prof->backEdges[i]);
+            sep = ",";
+        }
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+//================================================
+// byte-oriented LZ77 for trace chunks. A token
+// below 0x80 is followed by token + 1 literal
+// bytes. From 0x80 up it's a match of
+// (token & 0x7F) + TRACE_MIN_MATCH bytes,
+// followed by a varint of how far back they
+// start. Loops encode to the same bytes every
+// iteration, so they come out as long matches.
+//================================================
+#define TRACE_MIN_MATCH   4
+#define TRACE_MAX_MATCH   (0x7F + TRACE_MIN_MATCH)
+#define TRACE_HASH_BITS   14
+#define TRACE_SKIP_SHIFT  5         //a miss streak of 2^n bytes starts skipping a byte more per probe
+
+//bytes traceCompress() may need for n bytes of input
+#define TRACE_PACKED_MAX(n) ((n) + (n) / 128 + 16)
+
+size_t traceLiterals(unsigned char *dst, size_t op, const unsigned char *src, size_t n){
+    while(n > 0){
+        size_t k = n > 128 ? 128 : n;
+        dst[op++] = k - 1;
+        memcpy(dst + op, src, k);
+        op += k;
+        src += k;
+        n -= k;
+    }
+    return op;
+}
+
+size_t traceCompress(const unsigned char *src, size_t n, unsigned char *dst){
+    unsigned int table[1 << TRACE_HASH_BITS];   //last position + 1 of each hashed 4 byte sequence
+    memset(table, 0, sizeof(table));
+    size_t ip = 0;
+    size_t op = 0;
+    size_t lit = 0;                             //first literal not yet emitted
+
+    size_t misses = 0;                          //since the last match, long stretches of literals are skipped faster
+
+    while(ip + TRACE_MIN_MATCH <= n){
+        unsigned int seq;
+        memcpy(&seq, src + ip, 4);
+        unsigned int h = (seq * 2654435761u) >> (32 - TRACE_HASH_BITS);
+        size_t cand = table[h];
+        table[h] = ip + 1;
+        if(cand == 0 || memcmp(src + cand - 1, &seq, 4) != 0){
+            ip += 1 + (misses++ >> TRACE_SKIP_SHIFT);
+            continue;
+        }
+        misses = 0;
+        cand--;
+        size_t max = n - ip < TRACE_MAX_MATCH ? n - ip : TRACE_MAX_MATCH;
+        size_t len = TRACE_MIN_MATCH;
+        //8 bytes at a time, the lowest byte that differs ends the match
+        while(len + 8 <= max){
+            unsigned long long a, b;
+            memcpy(&a, src + cand + len, 8);
+            memcpy(&b, src + ip + len, 8);
+            if(a != b){
+                max = len + __builtin_ctzll(LE64(a ^ b)) / 8;
+                break;
+            }
+            len += 8;
+        }
+        while(len < max && src[cand + len] == src[ip + len]){
+            len++;
+        }
+        op = traceLiterals(dst, op, src + lit, ip - lit);
+        dst[op++] = 0x80 | (len - TRACE_MIN_MATCH);
+        for(size_t dist = ip - cand; ; dist >>= 7){
+            if(dist < 0x80){
+                dst[op++] = dist;
+                break;
+            }
+            dst[op++] = (dist & 0x7F) | 0x80;
+        }
+        ip += len;
+        lit = ip;
+    }
+    return traceLiterals(dst, op, src + lit, n - lit);
+}
+
+bool traceDecompress(const unsigned char *src, size_t n, unsigned char *dst, size_t rawLen){
+    size_t ip = 0;
+    size_t op = 0;
+    while(ip < n){
+        unsigned char token = src[ip++];
+        if(token < 0x80){
+            size_t k = token + 1;
+            if(ip + k > n || op + k > rawLen){
+                return false;
+            }
+            memcpy(dst + op, src + ip, k);
+            ip += k;
+            op += k;
+            continue;
+        }
+        size_t len = (token & 0x7F) + TRACE_MIN_MATCH;
+        size_t dist = 0;
+        for(int shift = 0; ; shift += 7){
+            if(ip == n || shift > 28){
+                return false;
+            }
+            dist |= (size_t)(src[ip] & 0x7F) << shift;
+            if(!(src[ip++] & 0x80)){
+                break;
+            }
+        }
+        if(dist == 0 || dist > op || op + len > rawLen){
+            return false;
+        }
+        for(size_t i = 0; i < len; i++, op++){
+            dst[op] = dst[op - dist];
+        }
+    }
+    return op == rawLen;
+}
+
+//================================================
+// starts a chunk with a keyframe of the state
+//================================================
+void traceKeyframe(TraceChunk *chunk, const Snapshot *state, unsigned long long firstStep){
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->firstStep = firstStep;
+    chunk->accumulator = state->accumulator;
+    chunk->instructReg = state->instructReg;
+    chunk->instructCntr = state->instructCntr;
+    memcpy(chunk->mem, state->mem, sizeof(chunk->mem));
+}
+
+//where each stream starts in the writer's buffer, each with room for a
+//whole chunk and the bytes traceEncode() may store past its end
+#define TRACE_AT_JUMP     (TRACE_KEYFRAME + 2)
+#define TRACE_AT_ACC      (TRACE_AT_JUMP + TRACE_KEYFRAME + 2)
+#define TRACE_AT_WRITE    (TRACE_AT_ACC + 2 * TRACE_KEYFRAME + 2)
+#define TRACE_RAW_MAX     (TRACE_AT_WRITE + 3 * TRACE_KEYFRAME + 3)
+
+//================================================
+// points s at the empty streams of the writer's
+// buffer raw
+//================================================
+void traceStreams(TraceStreams *s, unsigned char *raw){
+    s->flags = raw;
+    s->jump = raw + TRACE_AT_JUMP;
+    s->acc = raw + TRACE_AT_ACC;
+    s->write = raw + TRACE_AT_WRITE;
+}
+
+//================================================
+// delta-encodes n steps against the accumulator
+// and instruction counter before the first and
+// moves them on. Every field is stored whether
+// the step needs it or not and only the streams
+// that need it move on, so there are no branches
+// to mispredict.
+//================================================
+void traceEncode(TraceStreams *s, signed short *acc, unsigned char *pc, const TraceRecord *recs, size_t n){
+    TraceStreams out = *s;
+    signed short lastAcc = *acc;
+    unsigned char lastPc = *pc;
+    for(size_t i = 0; i < n; i++){
+        TraceRecord rec = recs[i];
+        unsigned short delta = LE16((unsigned short)(rec.accumulator - lastAcc));
+        unsigned short value = LE16(rec.value);
+        bool jump = rec.next != (unsigned char)(lastPc + 1);
+        bool changed = delta != 0;
+        bool stored = rec.wrote && rec.value == (unsigned short)rec.accumulator;
+        bool wrote = rec.wrote && !stored;
+
+        *out.flags++ = jump * TRACE_JUMP | changed * TRACE_ACC | wrote * TRACE_WRITE | stored * TRACE_STORE;
+        *out.jump = rec.next;
+        out.jump += jump;
+        memcpy(out.acc, &delta, 2);
+        out.acc += 2 * changed;
+        *out.write = rec.addr;
+        memcpy(out.write + 1, &value, 2);
+        out.write += rec.wrote + 2 * wrote;
+        lastAcc = rec.accumulator;
+        lastPc = rec.next;
+    }
+    *s = out;
+    *acc = lastAcc;
+    *pc = lastPc;
+}
+
+//================================================
+// finds the streams of nSteps decompressed steps
+// in raw, returns false if they don't add up to
+// rawLen bytes
+//================================================
+bool traceSplit(TraceStreams *s, unsigned char *raw, size_t rawLen, unsigned int nSteps){
+    size_t counts[4] = {0};
+    if(rawLen < nSteps){
+        return false;
+    }
+    for(unsigned int i = 0; i < nSteps; i++){
+        counts[0] += !!(raw[i] & TRACE_JUMP);
+        counts[1] += !!(raw[i] & TRACE_ACC);
+        counts[2] += !!(raw[i] & TRACE_WRITE);
+        counts[3] += !!(raw[i] & TRACE_STORE);
+    }
+    s->flags = raw;
+    s->jump = s->flags + nSteps;
+    s->acc = s->jump + counts[0];
+    s->write = s->acc + 2 * counts[1];
+    return (size_t)(s->write + 3 * counts[2] + counts[3] - raw) == rawLen;
+}
+
+//================================================
+// applies the next encoded step to state
+//================================================
+void traceDecode(TraceStreams *s, Snapshot *state){
+    unsigned char flags = *s->flags++;
+    unsigned char next = state->instructCntr + 1;
+    state->instructReg = state->mem[state->instructCntr];
+    if(flags & TRACE_JUMP){
+        next = *s->jump++;
+    }
+    if(flags & TRACE_ACC){
+        state->accumulator += (signed short)(s->acc[0] | s->acc[1] << 8);
+        s->acc += 2;
+    }
+    if(flags & TRACE_WRITE){
+        state->mem[s->write[0]] = s->write[1] | s->write[2] << 8;
+        s->write += 3;
+    }
+    if(flags & TRACE_STORE){
+        state->mem[*s->write++] = state->accumulator;
+    }
+    state->instructCntr = next;
+}
+
+//================================================
+// closes the gaps between a chunk's streams and
+// writes it compressed
+//================================================
+bool traceFlush(Tracer *tr, TraceChunk *chunk, unsigned char *raw, const TraceStreams *s, unsigned char *packed){
+    TraceStreams from;
+    traceStreams(&from, raw);
+    unsigned char *starts[] = {from.flags, from.jump, from.acc, from.write};
+    unsigned char *ends[] = {s->flags, s->jump, s->acc, s->write};
+    size_t rawLen = 0;
+    for(int i = 0; i < 4; i++){
+        memmove(raw + rawLen, starts[i], ends[i] - starts[i]);
+        rawLen += ends[i] - starts[i];
+    }
+    chunk->rawLen = rawLen;
+    chunk->packedLen = traceCompress(raw, rawLen, packed);
+    return fwrite(chunk, sizeof(*chunk), 1, tr->f) == 1 && fwrite(packed, 1, chunk->packedLen, tr->f) == chunk->packedLen;
+}
+
+//================================================
+// writer thread: takes records off the ring as
+// they're published, encodes them a batch at a
+// time and writes a compressed chunk whenever
+// one ends. After a chunk the run cut short it
+// skips to the next keyframe the run took.
+//================================================
+void *traceWriter(void *arg){
+    Tracer *tr = arg;
+    unsigned char *raw = malloc(TRACE_RAW_MAX);
+    unsigned char *packed = malloc(TRACE_PACKED_MAX(TRACE_RAW_MAX));
+    TraceStreams s;
+    TraceChunk chunk;
+    TraceKey *key = &tr->keys[0];
+    traceKeyframe(&chunk, &key->state, 0);
+    traceStreams(&s, raw);
+    bool open = true;               //steps are going into chunk
+    signed short acc = chunk.accumulator;
+    unsigned char pc = chunk.instructCntr;
+    unsigned long long tail = 0;
+
+    for(;;){
+        bool finished = atomic_load_explicit(&tr->done, memory_order_acquire);
+        unsigned long long head = atomic_load_explicit(&tr->head, memory_order_acquire);
+        bool moved = false;
+        if(!open){
+            //the next chunk is the first keyframe the run took from here on
+            unsigned long long k = (tail + TRACE_KEYFRAME - 1) / TRACE_KEYFRAME * TRACE_KEYFRAME;
+            while(k < head && tr->keys[(k / TRACE_KEYFRAME) % TRACE_KEYS].firstStep != k){
+                k += TRACE_KEYFRAME;
+            }
+            if(k < head){
+                key = &tr->keys[(k / TRACE_KEYFRAME) % TRACE_KEYS];
+                tr->dropped += k - tail;
+                traceKeyframe(&chunk, &key->state, k);
+                traceStreams(&s, raw);
+                acc = chunk.accumulator;
+                pc = chunk.instructCntr;
+                tail = k;
+                open = moved = true;
+            }
+        }
+        if(open){
+            unsigned long long end = atomic_load_explicit(&key->end, memory_order_relaxed);
+            unsigned long long stop = head < end ? head : end;
+            while(tail < stop){
+                //a batch can't run past the end of the ring
+                size_t n = stop - tail;
+                size_t wrap = TRACE_RING - (tail & (TRACE_RING - 1));
+                n = n < wrap ? n : wrap;
+                traceEncode(&s, &acc, &pc, &tr->ring[tail & (TRACE_RING - 1)], n);
+                chunk.nSteps += n;
+                tail += n;
+                moved = true;
+            }
+            if(tail == end){
+                tr->failed |= !traceFlush(tr, &chunk, raw, &s, packed);
+                open = false;
+            }
+        }
+        if(moved){
+            atomic_store_explicit(&tr->tail, tail, memory_order_release);
+        }
+        else if(finished){
+            break;
+        }
+        else{
+            struct timespec nap = {0, 20000};
+            nanosleep(&nap, NULL);
+        }
+    }
+
+    if(open){
+        tr->failed |= !traceFlush(tr, &chunk, raw, &s, packed);
+    }
+    //a run that ended while it wasn't recording leaves its final state in a chunk of its own
+    unsigned long long recorded = chunk.firstStep + chunk.nSteps;
+    if(tr->steps > recorded){
+        tr->dropped += tr->steps - recorded;
+        traceKeyframe(&chunk, &tr->last, tr->steps);
+        traceStreams(&s, raw);
+        tr->failed |= !traceFlush(tr, &chunk, raw, &s, packed);
+    }
+    free(raw);
+    free(packed);
+    return NULL;
+}
+
+//================================================
+// runs the loaded program like executeProfiled()
+// but hands every step to the trace writer.
+// Everything but DIV, MOD, I/O, HALT and faults
+// runs inline on local registers, the rest goes
+// through executeInstruction(). While the run
+// isn't recording, its records go to a scratch
+// record instead of the ring. --max-steps and
+// --max-time stop it the way executeGuarded()
+// would.
+//================================================
+void executeTraced(Hatchling * hatchling, Tracer *tr){
+    if(hatchling->opCode == HALT || hatchling->fatalError){
+        return;
+    }
+
+    unsigned short *mem = hatchling->mem;
+    signed short acc = hatchling->accumulator;
+    unsigned char pc = hatchling->instructCntr;
+    unsigned short word = hatchling->instructReg;
+    TraceRecord *ring = tr->ring;
+    TraceRecord scratch;
+    TraceRecord *slots = ring;      //where the records go
+    unsigned long long mask = TRACE_RING - 1;
+    bool recording = true;
+    unsigned long long step = 0;
+    unsigned long long published = 0;
+    unsigned long long resumed = 0;     //step recording last started at
+    unsigned long long nextKey = TRACE_KEYFRAME;
+    unsigned long long limit = TRACE_PUBLISH;  //next step that publishes, checks for room or takes a keyframe
+    unsigned char addr = 0;
+    unsigned short value = 0;
+
+    //the budgets are checked at the same stops, which nextCheck brings forward when due
+    unsigned long long maxSteps = tr->maxSteps ? tr->maxSteps : ~0ULL;
+    double deadline = tr->maxTime > 0 ? nowNs() + tr->maxTime * 1e9 : 0;
+    unsigned long long nextCheck = deadline && maxSteps > TIME_CHECK_STEPS ? TIME_CHECK_STEPS : maxSteps;
+    limit = nextCheck < limit ? nextCheck : limit;
+
+    for(;;){
+        if(step == limit){
+            if(step == nextCheck){
+                Termination stop = step == maxSteps ? TERM_STEP_LIMIT : nowNs() > deadline ? TERM_TIME_LIMIT : TERM_HALT;
+                if(stop != TERM_HALT){
+                    if(recording){
+                        atomic_store_explicit(&tr->head, step, memory_order_release);
+                    }
+                    stopRun(hatchling, acc, pc, stop, step, tr->maxTime);
+                    takeSnapshot(&tr->last, hatchling);
+                    tr->steps = step;
+                    return;
+                }
+                nextCheck = maxSteps - step > TIME_CHECK_STEPS ? step + TIME_CHECK_STEPS : maxSteps;
+            }
+
+            //after a gap the writer's tail lags where recording started again, but it has taken everything before
+            unsigned long long tail = atomic_load_explicit(&tr->tail, memory_order_acquire);
+            unsigned long long room = (tail > resumed ? tail : resumed) + TRACE_RING;
+            bool publish = recording;
+            if(recording && step == room && tr->lossy){
+                //the chunk ends here, the writer learns so with the records before it
+                TraceKey *key = &tr->keys[(step - 1) / TRACE_KEYFRAME % TRACE_KEYS];
+                atomic_store_explicit(&key->end, step, memory_order_relaxed);
+                recording = false;
+                slots = &scratch;
+                mask = 0;
+            }
+            if(publish){
+                atomic_store_explicit(&tr->head, step, memory_order_release);
+                published = step;
+            }
+            if(recording){
+                while(step == room){
+                    sched_yield();
+                    tail = atomic_load_explicit(&tr->tail, memory_order_acquire);
+                    room = tail + TRACE_RING;
+                }
+            }
+            if(step == nextKey){
+                //recording starts again at a keyframe once the writer has taken everything
+                if(!recording && tail == published){
+                    recording = true;
+                    slots = ring;
+                    mask = TRACE_RING - 1;
+                    resumed = step;
+                    room = step + TRACE_RING;
+                }
+                if(recording){
+                    TraceKey *key = &tr->keys[(step / TRACE_KEYFRAME) % TRACE_KEYS];
+                    key->state.accumulator = acc;
+                    key->state.instructCntr = pc;
+                    key->state.instructReg = word;
+                    memcpy(key->state.mem, mem, sizeof(key->state.mem));
+                    key->firstStep = step;
+                    atomic_store_explicit(&key->end, step + TRACE_KEYFRAME, memory_order_relaxed);
+                }
+                nextKey += TRACE_KEYFRAME;
+            }
+            limit = nextKey < nextCheck ? nextKey : nextCheck;
+            if(recording){
+                limit = room < limit ? room : limit;
+                limit = step + TRACE_PUBLISH < limit ? step + TRACE_PUBLISH : limit;
+            }
+        }
+
+        word = mem[pc];
+        unsigned char op = word >> 8;
+        unsigned char operand = word & 0xFF;
+        bool wrote = false;
+
+        switch(op){
+            case LOAD:
+                acc = (signed short)mem[operand];
+                pc++;
+                break;
+            case STOR:
+                mem[operand] = acc;
+                wrote = true;
+                addr = operand;
+                value = acc;
+                pc++;
+                break;
+            case B:
+                pc = operand;
+                break;
+            case BNEG:
+                pc = acc < 0 ? operand : pc + 1;
+                break;
+            case BPOS:
+                pc = acc > 0 ? operand : pc + 1;
+                break;
+            case BZRO:
+                pc = acc == 0 ? operand : pc + 1;
+                break;
+            case AND:
+                acc &= mem[operand];
+                pc++;
+                break;
+            case ORR:
+                acc |= mem[operand];
+                pc++;
+                break;
+            case XOR:
+                acc ^= mem[operand];
+                pc++;
+                break;
+            case NOT:
+                acc = !acc;
+                pc++;
+                break;
+            case LSR:
+                acc = acc >> 1;
+                pc++;
+                break;
+            case ASR:
+                acc = acc < 0 ? ~(~acc >> 1) : acc >> 1;
+                pc++;
+                break;
+            case LSL:
+                acc = acc << 1;
+                pc++;
+                break;
+            case ADD:
+            case SUB:
+            case MUL:
+            {
+                //on overflow, executeInstruction() reports the fault
+                int result = op == ADD ? acc + (signed short)mem[operand] :
+                             op == SUB ? acc - (signed short)mem[operand] : acc * (signed short)mem[operand];
+                if(result >= -32768 && result <= 32767){
+                    acc = result;
+                    pc++;
+                    break;
+                }
+            }
+            //fall through
+            default:
+                //everything else, including HALT and faults, takes the reference path
+                hatchling->accumulator = acc;
+                hatchling->instructCntr = pc;
+                hatchling->instructReg = word;
+                hatchling->opCode = op;
+                hatchling->operand = operand;
+                executeInstruction(hatchling);
+                acc = hatchling->accumulator;
+                pc = hatchling->instructCntr;
+                if(op == READ){
+                    wrote = true;
+                    addr = operand;
+                    value = mem[operand];
+                }
+                if(op == HALT || hatchling->fatalError){
+                    slots[step & mask] = (TraceRecord){acc, value, pc, addr, wrote};
+                    if(recording){
+                        atomic_store_explicit(&tr->head, step + 1, memory_order_release);
+                    }
+                    takeSnapshot(&tr->last, hatchling);
+                    tr->steps = step + 1;
+                    return;
+                }
+        }
+
+        slots[step & mask] = (TraceRecord){acc, value, pc, addr, wrote};
+        step++;
+    }
+}
+
+//================================================
+// runs the loaded program with every step
+// recorded to a trace file at path. Returns
+// false if the trace couldn't be written, and
+// sets dropped, if given, to how many steps are
+// missing from it.
+//================================================
+bool traceRun(Hatchling * hatchling, const char *path, unsigned long long maxSteps, double maxTime, unsigned long long *dropped){
+    FILE *f = fopen(path, "wb");
+    if(f == NULL){
+        return false;
+    }
+    TraceHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_MAGIC, 4);
+    hdr.version = TRACE_VERSION;
+    hdr.keyframe = TRACE_KEYFRAME;
+    fwrite(&hdr, sizeof(hdr), 1, f);
+
+    Tracer *tr = calloc(1, sizeof(Tracer));
+    tr->ring = malloc(TRACE_RING * sizeof(TraceRecord));
+    tr->f = f;
+    tr->lossy = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+    tr->maxSteps = maxSteps;
+    tr->maxTime = maxTime;
+    takeSnapshot(&tr->keys[0].state, hatchling);
+    atomic_store_explicit(&tr->keys[0].end, TRACE_KEYFRAME, memory_order_relaxed);
+    pthread_create(&tr->thread, NULL, traceWriter, tr);
+
+    executeTraced(hatchling, tr);
+
+    atomic_store_explicit(&tr->done, true, memory_order_release);
+    pthread_join(tr->thread, NULL);
+    bool ok = !tr->failed;
+    ok &= fclose(f) == 0;
+    if(dropped){
+        *dropped = tr->dropped;
+    }
+    free(tr->ring);
+    free(tr);
+    return ok;
+}
+
+//================================================
+// --replay: rebuilds the machine at a step of a
+// trace from the keyframe before it, without
+// running the program, and prints its dump.
+// step is ~0 for the end of the trace.
+//================================================
+int runReplay(const char *path, unsigned long long step){
+    FILE *f = fopen(path, "rb");
+    if(f == NULL){
+        printf("Please enter a valid filepath\n");
+        return 1;
+    }
+    size_t len;
+    bool mapped;
+    const char *data = mapStream(f, &len, &mapped);
+    fclose(f);
+
+    TraceHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    if(len >= sizeof(hdr)){
+        memcpy(&hdr, data, sizeof(hdr));
+    }
+    if(memcmp(hdr.magic, TRACE_MAGIC, 4) != 0 || hdr.version != TRACE_VERSION){
+        printf("BAD TRACE (EXPECTED %s VERSION %d)\n", TRACE_MAGIC, TRACE_VERSION);
+        unmapStream(data, len, mapped);
+        return 1;
+    }
+
+    //walk the chunk headers to the one holding step, remembering how long the trace is
+    TraceChunk chunk;
+    const char *found = NULL;
+    TraceChunk at;
+    unsigned long long total = 0;
+    unsigned long long resumed = 0;        //first step recorded after step, if step is in a gap
+    for(size_t pos = sizeof(hdr); pos < len; pos += sizeof(chunk) + chunk.packedLen){
+        if(len - pos < sizeof(chunk)){
+            break;
+        }
+        memcpy(&chunk, data + pos, sizeof(chunk));
+        if(len - pos - sizeof(chunk) < chunk.packedLen){
+            break;
+        }
+        total = chunk.firstStep + chunk.nSteps;
+        if(found == NULL || step >= chunk.firstStep){
+            found = data + pos + sizeof(chunk);
+            at = chunk;
+        }
+        else if(resumed == 0){
+            resumed = chunk.firstStep;
+        }
+    }
+    if(found == NULL){
+        printf("BAD TRACE (NO CHUNKS)\n");
+        unmapStream(data, len, mapped);
+        return 1;
+    }
+    if(step == ~0ULL){
+        step = total;
+    }
+    if(step > total){
+        printf("TRACE HAS ONLY %llu STEPS\n", total);
+        unmapStream(data, len, mapped);
+        return 1;
+    }
+    if(step > at.firstStep + at.nSteps){
+        printf("STEP %llu WASN'T RECORDED, THE TRACE SKIPS FROM STEP %llu TO %llu\n",
+               step, at.firstStep + at.nSteps, resumed);
+        unmapStream(data, len, mapped);
+        return 1;
+    }
+
+    unsigned char *raw = malloc(at.rawLen ? at.rawLen : 1);
+    Snapshot state;
+    memset(&state, 0, sizeof(state));
+    state.accumulator = at.accumulator;
+    state.instructReg = at.instructReg;
+    state.instructCntr = at.instructCntr;
+    memcpy(state.mem, at.mem, sizeof(state.mem));
+    TraceStreams s;
+    bool ok = traceDecompress((const unsigned char *)found, at.packedLen, raw, at.rawLen) &&
+              traceSplit(&s, raw, at.rawLen, at.nSteps);
+    for(unsigned long long k = at.firstStep; ok && k < step; k++){
+        traceDecode(&s, &state);
+    }
+    free(raw);
+    unmapStream(data, len, mapped);
+    if(!ok){
+        printf("BAD TRACE (CORRUPT CHUNK AT STEP %llu)\n", at.firstStep);
+        return 1;
+    }
+
+    Hatchling h;
+    stdioInit(&h);
+    state.opCode = state.instructReg >> 8;
+    state.operand = state.instructReg & 0xFF;
+    state.stop = TERM_HALT;
+    restoreSnapshot(&h, &state, NULL);
+    printf("*** REPLAYED TO STEP %llu OF %llu ***\n", step, total);
+    printDump(&h);
+    return 0;
+}
+
+//================================================
+// benchmark harness (--bench). Every stage is
+// timed on its own over synthetic programs:
+// loading text and binary images, dispatch
+// through execute()/executeInstruction(), an
+// arithmetic-heavy and a branch-heavy loop nest
+// on the selected engine, the arithmetic nest
+// with --trace recording into /dev/null, and
+// formatting the computer dump. Each stage reports the median
+// and 99th percentile of its repetitions.
+// Programs named on the command line (make
+// bench passes bench/*.hml) are timed on the
+// selected engine as one stage each.
+//================================================
+#define BENCH_ONE       0xFF    //constant 1
+#define BENCH_MASK      0xFE    //constant 0x00FF
+#define BENCH_B         0xFD    //arithmetic operand
+#define BENCH_C         0xFC    //logic operand
+#define BENCH_A         0xFB    //the value the loop body works on
+#define BENCH_CTR       0xF0    //loop counters, one per nesting level
+#define BENCH_INIT      0xE0    //loop counter start values
+#define BENCH_MAX_DEPTH 8
+#define BENCH_STEPS     2000000 //steps a generated loop nest aims for
+#define BENCH_LOADS     1000    //programs loaded per timed repetition
+#define BENCH_DUMPS     100     //dumps printed per timed repetition
+#define BENCH_MAX_STAGES 32     //timed stages, workload programs included
+#define BENCH_TOLERANCE 10.0    //percent slower than the baseline that counts as a regression
+#define BENCH_WIDE_CODE 0x123400 //where the sparse stage's code is relocated to
+#define BENCH_WIDE_DATA 0xFEDC00 //page the sparse stage's data words are relocated to
+
+enum benchBody{
+    BODY_ARITH,
+    BODY_BRANCH
+};
+typedef enum benchBody BenchBody;
+
+//what a timed stage runs its program on
+enum benchEngine{
+    BENCH_REFERENCE,                //execute(), fetch and decode every step
+    BENCH_SELECTED,                 //the --engine/--jit selection
+    BENCH_TRACED,                   //traceRun() into /dev/null
+    BENCH_STRICT,                   //the strict --variant
+    BENCH_WRAPPING,                 //the wrapping --variant
+    BENCH_INSTRUMENTED,             //the instrumented --variant with a counting hook
+    BENCH_OPTIMIZED                 //the threaded engine given the program's analysis (--optimize)
+};
+typedef enum benchEngine BenchEngine;
+
+struct benchResult{
+    char stage[32];
+    double median;                  //ns per repetition
+    double p99;                     //ns per repetition
+    double stepsPerSec;             //0 for stages that don't execute
+};
+typedef struct benchResult BenchResult;
+
+double nowNs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//================================================
+// emits one level of the loop nest at p, the
+// innermost level holds the body
+//================================================
+int benchNest(unsigned short *mem, int p, int level, int depth, const unsigned short *body, int bodyLen){
+    if(level == depth){
+        memcpy(&mem[p], body, bodyLen * sizeof(unsigned short));
+        return p + bodyLen;
+    }
+    mem[p++] = LOAD << 8 | (BENCH_INIT + level);
+    mem[p++] = STOR << 8 | (BENCH_CTR + level);
+    int head = p;
+    p = benchNest(mem, p, level + 1, depth, body, bodyLen);
+    mem[p++] = LOAD << 8 | (BENCH_CTR + level);
+    mem[p++] = SUB << 8 | BENCH_ONE;
+    mem[p++] = STOR << 8 | (BENCH_CTR + level);
+    mem[p++] = BPOS << 8 | head;
+    return p;
+}
+
+//================================================
+// generates a loop nest of the given depth whose
+// innermost body is roughly length words of
+// arithmetic or data-dependent branches, with
+// enough iterations to run about BENCH_STEPS
+//================================================
+Hatchling benchProgram(BenchBody kind, int length, int depth){
+    Hatchling h;
+    stdioInit(&h);
+
+    //the body repeats one group, which never overflows and whose branches stay inside it.
+    //the branch group tests the low bit of the innermost loop counter, so every branch
+    //alternates between taken and not taken
+    static const unsigned short arith[] = {
+        LOAD << 8 | BENCH_A,  ADD << 8 | BENCH_B,  MUL << 8 | BENCH_ONE,
+        SUB << 8 | BENCH_B,   XOR << 8 | BENCH_C,  AND << 8 | BENCH_MASK,
+        ORR << 8 | BENCH_C,   LSL << 8,            ASR << 8,
+        STOR << 8 | BENCH_A
+    };
+    static const unsigned short branch[] = {
+        LOAD << 8 | BENCH_CTR, AND << 8 | BENCH_ONE, STOR << 8 | BENCH_A,
+        BZRO << 8 | 5,        LOAD << 8 | BENCH_A,  BPOS << 8 | 7,
+        LOAD << 8 | BENCH_A
+    };
+    const unsigned short *group = kind == BODY_ARITH ? arith : branch;
+    int groupLen = kind == BODY_ARITH ? 10 : 7;
+
+    if(depth < 1){
+        depth = 1;
+    }
+    if(depth > BENCH_MAX_DEPTH){
+        depth = BENCH_MAX_DEPTH;
+    }
+    int room = BENCH_INIT - 6 * depth - 1;
+    if(length > room){
+        length = room;
+    }
+    int groups = length / groupLen > 0 ? length / groupLen : 1;
+
+    //the body starts right after the loop headers, branch targets are relative to their group
+    unsigned short body[256];
+    int bodyStart = 2 * depth;
+    for(int g = 0; g < groups; g++){
+        for(int i = 0; i < groupLen; i++){
+            unsigned short word = group[i];
+            if((word >> 8) == BZRO || (word >> 8) == BPOS){
+                word = (word & 0xFF00) | (bodyStart + g * groupLen + (word & 0xFF));
+            }
+            else if(word == (LOAD << 8 | BENCH_CTR)){
+                word += depth - 1;
+            }
+            body[g * groupLen + i] = word;
+        }
+    }
+
+    int p = benchNest(h.mem, 0, 0, depth, body, groups * groupLen);
+    h.mem[p] = HALT << 8;
+
+    //smallest iteration count per level that reaches BENCH_STEPS
+    long iters = 1;
+    long total;
+    do{
+        iters++;
+        total = groups * groupLen;
+        for(int d = 0; d < depth && total < BENCH_STEPS; d++){
+            total *= iters;
+        }
+    }while(total < BENCH_STEPS && iters < 32767);
+    for(int d = 0; d < depth; d++){
+        h.mem[BENCH_INIT + d] = iters;
+    }
+    h.mem[BENCH_ONE] = 1;
+    h.mem[BENCH_MASK] = 0x00FF;
+    h.mem[BENCH_B] = 7;
+    h.mem[BENCH_C] = 0x35;
+    h.mem[BENCH_A] = 3;
+    return h;
+}
+
+int compareDoubles(const void *a, const void *b){
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+//================================================
+// fills in a result from the timed repetitions
+//================================================
+void benchSummarize(BenchResult *r, const char *stage, double *times, int reps, unsigned long long steps){
+    qsort(times, reps, sizeof(double), compareDoubles);
+    snprintf(r->stage, sizeof(r->stage), "%s", stage);
+    r->median = times[reps / 2];
+    int i99 = (reps * 99 + 99) / 100 - 1;
+    r->p99 = times[i99 < reps ? i99 : reps - 1];
+    r->stepsPerSec = steps && r->median > 0 ? steps * 1e9 / r->median : 0;
+}
+
+//================================================
+// the hook the instrumented stage runs with
+//================================================
+void benchCountStep(void *ctx, unsigned char pc, unsigned short word, signed short acc){
+    (void)pc;
+    (void)word;
+    (void)acc;
+    (*(unsigned long long *)ctx)++;
+}
+
+//================================================
+// times running a generated program from its
+// loaded state, through execute(), one of the
+// --variant loops or the engine the options
+// select
+//================================================
+void benchRun(BenchResult *r, const char *stage, const Hatchling *prog, BenchEngine engine, const Options * opts, FILE *sink){
+    double *times = malloc(opts->benchReps * sizeof(double));
+
+    //the step count comes from one profiled run, which also warms the caches
+    Hatchling h = *prog;
+    h.out = sink;
+    Profile *prof = calloc(1, sizeof(Profile));
+    executeProfiled(&h, prof, 0, 0);
+    unsigned long long steps = prof->steps;
+    free(prof);
+    unsigned long long counted = 0;
+    Instrument counter = {benchCountStep, &counted};
+
+    //analyzed once, like a program is at load time
+    Analysis analysis;
+    if(engine == BENCH_OPTIMIZED){
+        hmlAnalyze(prog, &analysis);
+    }
+
+    for(int rep = 0; rep < opts->benchReps; rep++){
+        h = *prog;
+        h.out = sink;
+        double t0 = nowNs();
+        switch(engine){
+            case BENCH_REFERENCE:
+                execute(&h);
+                break;
+            case BENCH_SELECTED:
+                run(&h, opts->engine, opts->jit, NULL);
+                break;
+            case BENCH_TRACED:
+                traceRun(&h, "/dev/null", 0, 0, NULL);
+                break;
+            case BENCH_STRICT:
+                while(hmlRunStrict(&h, NULL) == HML_BAD_INPUT){}
+                break;
+            case BENCH_WRAPPING:
+                while(hmlRunWrapping(&h, NULL) == HML_BAD_INPUT){}
+                break;
+            case BENCH_INSTRUMENTED:
+                while(hmlRunInstrumented(&h, &counter) == HML_BAD_INPUT){}
+                break;
+            case BENCH_OPTIMIZED:
+                while(hmlRunThreaded(&h, &analysis) == HML_BAD_INPUT){}
+                break;
+        }
+        times[rep] = nowNs() - t0;
+    }
+    benchSummarize(r, stage, times, opts->benchReps, steps);
+    free(times);
+}
+
+//================================================
+// relocates a generated program into a 24-bit
+// space: every instruction gets EXTH and EXT
+// prefixes, the code moves to BENCH_WIDE_CODE
+// and the data words to the page at
+// BENCH_WIDE_DATA, under another first-level
+// table, so every step goes through the page
+// table twice
+//================================================
+HmlWide *benchWideProgram(const Hatchling *prog){
+    HmlWide *wide = hmlWideCreate(HML_MAX_BITS);
+    HmlSpace *space = &wide->space;
+
+    //the code is everything up to the HALT, the data words come after it
+    int end = 0;
+    while(end < 255 && prog->mem[end] != HALT << 8){
+        end++;
+    }
+    for(int i = 0; i <= end; i++){
+        unsigned short word = prog->mem[i];
+        unsigned char op = word >> 8;
+        unsigned int target = op >= B && op <= BZRO ? BENCH_WIDE_CODE + 3 * (word & 0xFF) : BENCH_WIDE_DATA + (word & 0xFF);
+        unsigned int at = BENCH_WIDE_CODE + 3 * i;
+        *hmlSpaceWord(space, at) = EXTH << 8 | target >> 16;
+        *hmlSpaceWord(space, at + 1) = EXT << 8 | (target >> 8 & 0xFF);
+        *hmlSpaceWord(space, at + 2) = (word & 0xFF00) | (target & 0xFF);
+    }
+    for(int i = end + 1; i < 256; i++){
+        if(prog->mem[i]){
+            *hmlSpaceWord(space, BENCH_WIDE_DATA + i) = prog->mem[i];
+        }
+    }
+    wide->instructCntr = BENCH_WIDE_CODE;
+    return wide;
+}
+
+//================================================
+// times running a generated program relocated
+// into the sparse address space
+//================================================
+void benchWide(BenchResult *r, const char *stage, const Hatchling *prog, const Options * opts){
+    double *times = malloc(opts->benchReps * sizeof(double));
+
+    //the untimed first run counts the steps
+    HmlWide *wide = benchWideProgram(prog);
+    unsigned long long steps = 0;
+    hmlWideRun(wide, 0, &steps);
+    hmlWideDestroy(wide);
+
+    for(int rep = 0; rep < opts->benchReps; rep++){
+        wide = benchWideProgram(prog);
+        double t0 = nowNs();
+        hmlWideRun(wide, 0, NULL);
+        times[rep] = nowNs() - t0;
+        hmlWideDestroy(wide);
+    }
+    benchSummarize(r, stage, times, opts->benchReps, steps);
+    free(times);
+}
+
+//================================================
+// times parsing one serialized program, in
+// batches of BENCH_LOADS
+//================================================
+void benchLoad(BenchResult *r, const char *stage, const char *data, size_t len, const Options * opts, FILE *sink){
+    double *times = malloc(opts->benchReps * sizeof(double));
+
+    //one untimed load warms the caches
+    Hatchling warm;
+    parseProgram(&warm, data, len, sink);
+    for(int rep = 0; rep < opts->benchReps; rep++){
+        double t0 = nowNs();
+        for(int i = 0; i < BENCH_LOADS; i++){
+            Hatchling h;
+            parseProgram(&h, data, len, sink);
+            __asm__ volatile("" : : "r"(&h) : "memory");
+        }
+        times[rep] = (nowNs() - t0) / BENCH_LOADS;
+    }
+    benchSummarize(r, stage, times, opts->benchReps, 0);
+    free(times);
+}
+
+//================================================
+// reads results written by an earlier --bench,
+// returns how many were read
+//================================================
+int readBenchResults(const char *path, BenchResult *results, int max){
+    FILE *f = fopen(path, "r");
+    if(f == NULL){
+        return -1;
+    }
+    char line[256];
+    int n = 0;
+    while(n < max && fgets(line, sizeof(line), f)){
+        if(line[0] == '#'){
+            continue;
+        }
+        BenchResult *r = &results[n];
+        if(sscanf(line, "%31s %lf %lf %lf", r->stage, &r->median, &r->p99, &r->stepsPerSec) == 4){
+            n++;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+//================================================
+// --bench: runs every stage, prints the results,
+// optionally writes them out as tab-separated
+// values and compares them against a baseline.
+// Returns 1 if any stage got slower than the
+// baseline by more than BENCH_TOLERANCE percent.
+//================================================
+int runBench(const Options * opts, char **paths, int nPaths){
+    FILE *sink = fopen("/dev/null", "w");
+    FILE *empty = fopen("/dev/null", "r");
+    BenchResult results[BENCH_MAX_STAGES];
+    int n = 0;
+
+    Hatchling arith = benchProgram(BODY_ARITH, opts->benchLength, opts->benchDepth);
+    Hatchling branch = benchProgram(BODY_BRANCH, opts->benchLength, opts->benchDepth);
+
+    //serialized copies of the arithmetic program to load from
+    char *text = NULL;
+    size_t textLen = 0;
+    FILE *mf = open_memstream(&text, &textLen);
+    writeText(mf, &arith);
+    fclose(mf);
+    char *image = NULL;
+    size_t imageLen = 0;
+    mf = open_memstream(&image, &imageLen);
+    writeImage(mf, &arith, -1);
+    fclose(mf);
+
+    benchLoad(&results[n++], "load_text", text, textLen, opts, sink);
+    benchLoad(&results[n++], "load_image", image, imageLen, opts, sink);
+    benchRun(&results[n++], "dispatch", &arith, BENCH_REFERENCE, opts, sink);
+    benchRun(&results[n++], "arith_loop", &arith, BENCH_SELECTED, opts, sink);
+    benchRun(&results[n++], "branch_loop", &branch, BENCH_SELECTED, opts, sink);
+    benchRun(&results[n++], "traced_loop", &arith, BENCH_TRACED, opts, sink);
+    benchRun(&results[n++], "strict_loop", &arith, BENCH_STRICT, opts, sink);
+    benchRun(&results[n++], "wrap_loop", &arith, BENCH_WRAPPING, opts, sink);
+    benchRun(&results[n++], "instr_loop", &arith, BENCH_INSTRUMENTED, opts, sink);
+    benchRun(&results[n++], "opt_loop", &arith, BENCH_OPTIMIZED, opts, sink);
+    benchWide(&results[n++], "sparse_loop", &arith, opts);
+
+    //workload programs run on the selected engine, a READ in one finds no input
+    for(int i = 0; i < nPaths && n < BENCH_MAX_STAGES - 1; i++){
+        FILE *f = fopen(paths[i], "r");
+        if(f == NULL){
+            printf("Could not open workload %s\n", paths[i]);
+            continue;
+        }
+        Hatchling prog;
+        readFile(&prog, f, stdout);
+        fclose(f);
+        if(prog.fatalError){
+            continue;
+        }
+        prog.in = empty;
+
+        //the stage is named after the file, without its directory or extension
+        const char *name = strrchr(paths[i], '/') ? strrchr(paths[i], '/') + 1 : paths[i];
+        char stage[32];
+        snprintf(stage, sizeof(stage), "%.*s", (int)strcspn(name, "."), name);
+        benchRun(&results[n++], stage, &prog, BENCH_SELECTED, opts, sink);
+    }
+
+    double *times = malloc(opts->benchReps * sizeof(double));
+    Hatchling done = arith;
+    done.out = sink;
+    execute(&done);
+    printDump(&done);
+    for(int rep = 0; rep < opts->benchReps; rep++){
+        double t0 = nowNs();
+        for(int i = 0; i < BENCH_DUMPS; i++){
+            printDump(&done);
+        }
+        times[rep] = (nowNs() - t0) / BENCH_DUMPS;
+    }
+    benchSummarize(&results[n++], "dump", times, opts->benchReps, 0);
+    free(times);
+    free(text);
+    free(image);
+    fclose(sink);
+    fclose(empty);
+
+    printf("*** BENCHMARK: BODY %d WORDS, DEPTH %d, %d REPETITIONS ***\n\n", opts->benchLength, opts->benchDepth, opts->benchReps);
+    printf("STAGE           MEDIAN NS        P99 NS     STEPS/SEC\n");
+    for(int i = 0; i < n; i++){
+        printf("%-12s %12.0f  %12.0f  %12.0f\n", results[i].stage, results[i].median, results[i].p99, results[i].stepsPerSec);
+    }
+
+    if(opts->benchPath){
+        FILE *f = fopen(opts->benchPath, "w");
+        if(f == NULL){
+            printf("Could not open %s for writing\n", opts->benchPath);
+            return 1;
+        }
+        fprintf(f, "# stage\tmedian_ns\tp99_ns\tsteps_per_sec\n");
+        for(int i = 0; i < n; i++){
+            fprintf(f, "%s\t%.0f\t%.0f\t%.0f\n", results[i].stage, results[i].median, results[i].p99, results[i].stepsPerSec);
+        }
+        fclose(f);
+    }
+
+    int slower = 0;
+    if(opts->baselinePath){
+        BenchResult base[BENCH_MAX_STAGES];
+        int nBase = readBenchResults(opts->baselinePath, base, BENCH_MAX_STAGES);
+        if(nBase < 0){
+            printf("Could not open baseline %s\n", opts->baselinePath);
+            return 1;
+        }
+        printf("\n*** COMPARED WITH %s ***\n\n", opts->baselinePath);
+        printf("STAGE          BASELINE NS        NOW NS    CHANGE\n");
+        for(int i = 0; i < n; i++){
+            const BenchResult *b = NULL;
+            for(int j = 0; j < nBase; j++){
+                if(strcmp(base[j].stage, results[i].stage) == 0){
+                    b = &base[j];
+                }
+            }
+            if(b == NULL || b->median <= 0){
+                printf("%-12s %14s  %12.0f       new\n", results[i].stage, "-", results[i].median);
+                continue;
+            }
+            double change = 100.0 * (results[i].median - b->median) / b->median;
+            bool regressed = change > BENCH_TOLERANCE;
+            slower += regressed;
+            printf("%-12s %14.0f  %12.0f  %+7.1f%%%s\n", results[i].stage, b->median, results[i].median, change, regressed ? "  SLOWER" : "");
+        }
+    }
+    return slower ? 1 : 0;
+}
+
+//================================================
+// run budgets and loop detection. The memory
+// hash is a weighted sum of all 256 words, so a
+// store updates it in O(1). Any run that never
+// ends jumps backwards (or wraps around from FF
+// to 00) over and over, so the state is only
+// sampled right after such a jump. Brent's
+// algorithm keeps one sampled state and moves
+// it forward at every power of two samples;
+// coming back to it means the program is in a
+// cycle. A hash match is confirmed against the
+// saved memory before a loop is reported, and
+// the search starts over after every READ,
+// since the input it consumes isn't part of
+// the state.
+//================================================
+#define HASH_WEIGHT(i)      (((unsigned long long)(i) * 2 + 1) * 0x9E3779B97F4A7C15ULL)
+
+//================================================
+// execute() under the budgets and loop check the
+// options ask for. A stopped run reports why in
+// the same way a fatal error does (stopRun()),
+// and records it in the Hatchling's stop field.
+// The common instructions run inline on local
+// registers, the rest goes through
+// executeInstruction().
+//================================================
+void executeGuarded(Hatchling * hatchling, const Options * opts){
+    if(hatchling->opCode == HALT || hatchling->fatalError){
+        return;
+    }
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+    unsigned short *mem = hatchling->mem;
+    signed short acc = hatchling->accumulator;
+    unsigned char pc = hatchling->instructCntr;
+    unsigned char to;
+    unsigned long long steps = 0;
+    unsigned long long maxSteps = opts->maxSteps ? opts->maxSteps : ~0ULL;
+    double deadline = opts->maxTime > 0 ? nowNs() + opts->maxTime * 1e9 : 0;
+    unsigned long long nextCheck = deadline && maxSteps > TIME_CHECK_STEPS ? TIME_CHECK_STEPS : maxSteps;
+    bool detect = opts->detectLoops;
+
+    unsigned long long hash = 0;
+    for(int i = 0; i < 256; i++){
+        hash += mem[i] * HASH_WEIGHT(i);
+    }
+
+    //Brent's saved state, and how many samples the search has taken since
+    signed short savedAcc = acc;
+    unsigned char savedPc = pc;
+    unsigned long long savedHash = hash;
+    unsigned long long savedSteps = 0;
+    unsigned short savedMem[256];
+    memcpy(savedMem, mem, sizeof(savedMem));
+    unsigned long long power = 1;
+    unsigned long long lambda = 0;
+
+    Termination stop = TERM_HALT;
+    for(;;){
+        if(steps == nextCheck){
+            if(steps == maxSteps){
+                stop = TERM_STEP_LIMIT;
+                break;
+            }
+            if(nowNs() > deadline){
+                stop = TERM_TIME_LIMIT;
+                break;
+            }
+            nextCheck = maxSteps - steps > TIME_CHECK_STEPS ? steps + TIME_CHECK_STEPS : maxSteps;
+        }
+
+        unsigned short word = mem[pc];
+        unsigned char op = word >> 8;
+        unsigned char operand = word & 0xFF;
+        steps++;
+        switch(op){
+            case LOAD:
+                acc = (signed short)mem[operand];
+                to = pc + 1;
+                break;
+            case STOR:
+                hash += ((unsigned short)acc - (unsigned long long)mem[operand]) * HASH_WEIGHT(operand);
+                mem[operand] = acc;
+                to = pc + 1;
+                break;
+            case B:
+                to = operand;
+                break;
+            case BNEG:
+                to = acc < 0 ? operand : pc + 1;
+                break;
+            case BPOS:
+                to = acc > 0 ? operand : pc + 1;
+                break;
+            case BZRO:
+                to = acc == 0 ? operand : pc + 1;
+                break;
+            case ADD:
+            case SUB:
+            {
+                //on overflow, executeInstruction() reports the fault
+                int result = op == ADD ? acc + (signed short)mem[operand] : acc - (signed short)mem[operand];
+                if(result >= -32768 && result <= 32767){
+                    acc = result;
+                    to = pc + 1;
+                    break;
+                }
+            }
+            //fall through
+            default:
+            {
+                //everything else, including HALT and faults, takes the reference path
+                unsigned short before = mem[operand];
+                hatchling->accumulator = acc;
+                hatchling->instructCntr = pc;
+                hatchling->instructReg = word;
+                hatchling->opCode = op;
+                hatchling->operand = operand;
+                executeInstruction(hatchling);
+                if(op == HALT || hatchling->fatalError){
+                    return;
+                }
+                acc = hatchling->accumulator;
+                to = hatchling->instructCntr;
+                if(op == READ){
+                    hash += ((unsigned long long)mem[operand] - before) * HASH_WEIGHT(operand);
+                    power = 1;
+                    lambda = 0;
+                    savedAcc = acc;
+                    savedPc = to;
+                    savedHash = hash;
+                    savedSteps = steps;
+                    memcpy(savedMem, mem, sizeof(savedMem));
+                }
+            }
+        }
+
+        bool backward = to <= pc;
+        pc = to;
+        if(backward && detect){
+            lambda++;
+            if(acc == savedAcc && pc == savedPc && hash == savedHash && memcmp(mem, savedMem, sizeof(savedMem)) == 0){
+                stop = TERM_INFINITE_LOOP;
+                break;
+            }
+            if(lambda == power){
+                savedAcc = acc;
+                savedPc = pc;
+                savedHash = hash;
+                savedSteps = steps;
+                memcpy(savedMem, mem, sizeof(savedMem));
+                power <<= 1;
+                lambda = 0;
+            }
+        }
+    }
+
+    if(stop == TERM_INFINITE_LOOP){
+        fprintf(out, "*** INFINITE LOOP: STATE AT %02X REPEATS EVERY %llu STEPS ***\n", pc, steps - savedSteps);
+    }
+    stopRun(hatchling, acc, pc, stop, steps, opts->maxTime);
+}
+
+//================================================
+// ends a run the budgets or the loop check
+// stopped before the word at pc, which the dump
+// shows as fetched, records why in the stop
+// field and reports it
+//================================================
+void stopRun(Hatchling * hatchling, signed short acc, unsigned char pc, Termination stop, unsigned long long steps, double maxTime){
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+    hatchling->accumulator = acc;
+    hatchling->instructCntr = pc;
+    hatchling->instructReg = hatchling->mem[pc];
+    hatchling->opCode = hatchling->mem[pc] >> 8;
+    hatchling->operand = hatchling->mem[pc] & 0xFF;
+    hatchling->fatalError = true;
+    hatchling->stop = stop;
+    if(stop == TERM_STEP_LIMIT){
+        fprintf(out, "*** STEP LIMIT OF %llu REACHED ***\n", steps);
+    }
+    else if(stop == TERM_TIME_LIMIT){
+        fprintf(out, "*** TIME LIMIT OF %g SECONDS REACHED AFTER %llu STEPS ***\n", maxTime, steps);
+    }
+    fprintf(out, "*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
+}
+
+//================================================
+// the multi-core computer dump: every core's
+// registers and private words, then the shared
+// memory
+//================================================
+void printCoresDump(FILE *out, const Multicore *m){
+    fprintf(out, "*** PROGRAM EXECUTION TERMINATED ***\n\n");
+    fprintf(out, "REGISTERS\n");
+    fprintf(out, "CORE   ACC  InstCtr  InstReg  OpCode  Operand  STEPS\n");
+    for(int i = 0; i < m->nCores; i++){
+        const Core *c = &m->cores[i];
+        fprintf(out, "%4d  %04hX       %02X     %04hX      %02X       %02X  %llu\n", i, (unsigned short)c->regs.accumulator,
+                c->regs.instructCntr, c->regs.instructReg, c->regs.opCode, c->regs.operand, c->steps);
+    }
+    fprintf(out, "\nLocal words: \n    ");
+    for(int i = 0; i < 256 - CORE_LOCAL; i++){
+        fprintf(out, "    %X   ", i);
+    }
+    for(int i = 0; i < m->nCores; i++){
+        fprintf(out, "\n%2d   ", i);
+        for(int j = 0; j < 256 - CORE_LOCAL; j++){
+            fprintf(out, "%04hX    ", m->cores[i].local[j]);
+        }
+    }
+    fprintf(out, "\n");
+
+    char buf[4096];
+    char *p = formatMemory(buf, m->mem);
+    fwrite(buf, 1, p - buf, out);
+}
+
+//================================================
+// loads a program for --cores and --scaling
+//================================================
+bool loadCoresProgram(Hatchling * prog, const char *path){
+    FILE *f = fopen(path, "r");
+    if(f == NULL){
+        printf("Please enter a valid filepath\n");
+        return false;
+    }
+    readFile(prog, f, stdout);
+    fclose(f);
+    return !prog->fatalError;
+}
+
+//================================================
+// --cores: runs a program on K cores sharing its
+// memory and prints why each core stopped
+//================================================
+int runCores(const char *path, const Options * opts){
+    if(opts->cores < 1 || opts->cores > MAX_CORES){
+        printf("--cores must be 1 to %d\n", MAX_CORES);
+        return 1;
+    }
+    Hatchling prog;
+    if(!loadCoresProgram(&prog, path)){
+        return 0;
+    }
+    printf("*** PROGRAM LOADING COMPLETED ***\n");
+    printf("*** PROGRAM EXECUTION BEGINS ON %d CORES ***\n", opts->cores);
+    fflush(stdout);
+
+    hmlSetIo(&prog, stdioRead, stdioWrite, NULL, stdout);
+    Multicore *m = hmlCoresCreate(&prog, opts->cores, opts->deterministic, opts->maxSteps, reportLane);
+    hmlCoresRun(m, opts->quantum);
+    for(int i = 0; i < m->nCores; i++){
+        const Core *c = &m->cores[i];
+        if(c->status == HML_LIMIT && m->maxSteps && c->steps == m->maxSteps){
+            printf("CORE %d: *** STEP LIMIT OF %llu REACHED ***\n", i, c->steps);
+            printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
+        }
+        else if(c->status != HML_OK && c->status != HML_HALTED && c->status != HML_LIMIT){
+            printf("CORE %d: ", i);
+            reportStatus(stdout, c->status);
+        }
+    }
+    if(opts->dump == DUMP_NONE){
+        printf("*** PROGRAM EXECUTION TERMINATED ***\n");
+    }
+    else{
+        printCoresDump(stdout, m);
+    }
+    hmlCoresDestroy(m);
+    return 0;
+}
+
+//================================================
+// --scaling: times a program on 1, 2, 4, 8 and
+// 16 cores, on threads and under the
+// deterministic scheduler, and checks that every
+// run leaves the same shared memory as the
+// single-core run. WRTE output is discarded.
+//================================================
+int runScaling(const char *path, const Options * opts){
+    Hatchling prog;
+    if(!loadCoresProgram(&prog, path)){
+        return 0;
+    }
+    FILE *sink = fopen("/dev/null", "w");
+    hmlSetIo(&prog, stdioRead, stdioWrite, NULL, sink);
+    unsigned short expect[256];
+    double base = 0;
+    bool differ = false;
+
+    printf("*** SCALING: %s, %d REPETITIONS, %ld CPUS ***\n\n", path, opts->benchReps, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("CORES    THREADS MS     STEPS/SEC  SPEEDUP  DETERMINISTIC MS  RESULT\n");
+    for(int k = 1; k <= 16; k *= 2){
+        BenchResult r[2];
+        unsigned long long steps = 0;
+        bool same = true;
+        for(int mode = 0; mode < 2; mode++){
+            double *times = malloc(opts->benchReps * sizeof(double));
+            for(int rep = 0; rep < opts->benchReps; rep++){
+                Multicore *m = hmlCoresCreate(&prog, k, mode == 1, opts->maxSteps, reportLane);
+                double t0 = nowNs();
+                hmlCoresRun(m, opts->quantum);
+                times[rep] = nowNs() - t0;
+
+                steps = 0;
+                for(int i = 0; i < k; i++){
+                    steps += m->cores[i].steps;
+                }
+                if(k == 1 && mode == 0 && rep == 0){
+                    memcpy(expect, m->mem, sizeof(expect));
+                }
+                same &= memcmp(expect, m->mem, sizeof(expect)) == 0;
+                hmlCoresDestroy(m);
+            }
+            benchSummarize(&r[mode], "cores", times, opts->benchReps, steps);
+            free(times);
+        }
+        if(k == 1){
+            base = r[0].median;
+        }
+        differ |= !same;
+        printf("%5d  %12.3f  %12.0f  %6.2fx  %16.3f  %s\n", k, r[0].median / 1e6, r[0].stepsPerSec,
+               r[0].median > 0 ? base / r[0].median : 0, r[1].median / 1e6, same ? "same" : "DIFFERENT");
+    }
+    fclose(sink);
+    return differ ? 1 : 0;
+}
+
+//================================================
+// READ callback of the explorer, hands out the
+// values of the input in order
+//================================================
+HmlStatus exploreRead(Hatchling * hatchling, long *value){
+    ExploreInput *input = hatchling->in;
+    if(input->used == input->n){
+        return HML_END_OF_INPUT;
+    }
+    *value = input->values[input->used++];
+    return HML_OK;
+}
+
+unsigned long long exploreRandom(ExploreWorker *w){
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 7;
+    w->rng ^= w->rng << 17;
+    return w->rng;
+}
+
+//================================================
+// runs the program from its loaded state on one
+// input like executeCovered(), without printing
+// why it stopped, and recording only the edges
+// of the conditional branches. dirty holds the
+// words the previous run on this Hatchling
+// wrote, and the ones this run writes
+//================================================
+Termination exploreRun(Hatchling * hatchling, const Explorer *ex, ExploreInput *input, unsigned long long *coverage,
+                       unsigned long long *dirty){
+    restoreSnapshot(hatchling, &ex->start, dirty);
+    input->used = 0;
+    hatchling->in = input;
+    unsigned char *edges = (unsigned char *)coverage;
+    for(unsigned long long steps = 0; hatchling->opCode != HALT && !hatchling->fatalError; steps++){
+        if(steps == ex->maxSteps){
+            hatchling->stop = TERM_STEP_LIMIT;
+            hatchling->fatalError = true;
+            break;
+        }
+        unsigned char from = hatchling->instructCntr;
+        hatchling->instructReg = hatchling->mem[from];
+        hatchling->opCode = hatchling->instructReg >> 8;
+        hatchling->operand = hatchling->instructReg & 0xFF;
+        hmlExecute(hatchling);
+        if(hatchling->opCode == STOR || hatchling->opCode == READ){
+            MARK_DIRTY(dirty, hatchling->operand);
+        }
+        else if(hatchling->opCode >= BNEG && hatchling->opCode <= BZRO){
+            unsigned int edge = from << 8 | hatchling->instructCntr;
+            edges[edge >> 3] |= 1 << (edge & 7);
+        }
+    }
+    return hmlTermination(hatchling);
+}
+
+//================================================
+// one to four random edits of an input: a value
+// from the dictionary, a small step, a bit flip,
+// a random value, a value dropped or inserted,
+// or the tail of another corpus entry. An input
+// whose run read every value may get another
+//================================================
+void exploreMutate(ExploreWorker *w, ExploreInput *input){
+    Explorer *ex = w->explorer;
+    int rounds = 1 + exploreRandom(w) % 4;
+    for(int r = 0; r < rounds; r++){
+        unsigned long long roll = exploreRandom(w);
+        if(input->n < EXPLORE_MAX_READS && (input->n == 0 || (input->used == input->n && roll % 2))){
+            input->values[input->n++] = roll >> 8 & 1 ? ex->dict[(roll >> 16) % ex->nDict] : (signed short)(roll >> 32);
+            continue;
+        }
+        if(input->n == 0){
+            return;
+        }
+
+        int i = (roll >> 8) % input->n;
+        signed short *v = &input->values[i];
+        switch((roll >> 24) % 8){
+            case 0:
+                *v = ex->dict[(roll >> 32) % ex->nDict];
+                break;
+            case 1:
+                *v = (signed short)(*v + 1 + (roll >> 32) % 16);
+                break;
+            case 2:
+                *v = (signed short)(*v - 1 - (roll >> 32) % 16);
+                break;
+            case 3:
+                *v = (signed short)(*v ^ 1 << (roll >> 32) % 16);
+                break;
+            case 4:
+                *v = (signed short)(roll >> 32);
+                break;
+            case 5:
+                if(input->n > 1){
+                    memmove(v, v + 1, (input->n - i - 1) * sizeof(signed short));
+                    input->n--;
+                }
+                break;
+            case 6:
+                if(input->n < EXPLORE_MAX_READS){
+                    memmove(v + 1, v, (input->n - i) * sizeof(signed short));
+                    input->n++;
+                    *v = ex->dict[(roll >> 32) % ex->nDict];
+                }
+                break;
+            case 7:
+            {
+                int nCorpus = atomic_load_explicit(&ex->nCorpus, memory_order_acquire);
+                const ExploreInput *other = &ex->corpus[(roll >> 32) % nCorpus];
+                if(other->n > i){
+                    memcpy(v, &other->values[i], (other->n - i) * sizeof(signed short));
+                    input->n = other->n;
+                }
+                break;
+            }
+        }
+    }
+}
+
+//================================================
+// checks the run's edges against the ones the
+// worker already knows about. Words with nothing
+// new are cleared on the way; when something is
+// new the rest goes into the shared coverage,
+// and the input into the corpus if no other
+// worker found those edges first. Returns
+// whether the input was added
+//================================================
+bool exploreMerge(ExploreWorker *w, const ExploreInput *input){
+    bool novel = false;
+    for(int i = 0; i < COVERAGE_BYTES / 8; i++){
+        if(w->cov[i]){
+            if(w->cov[i] & ~w->seen[i]){
+                novel = true;
+            }
+            else{
+                w->cov[i] = 0;
+            }
+        }
+    }
+    if(!novel){
+        return false;
+    }
+
+    Explorer *ex = w->explorer;
+    int found = 0;
+    pthread_mutex_lock(&ex->lock);
+    for(int i = 0; i < COVERAGE_BYTES / 8; i++){
+        if(w->cov[i]){
+            found += __builtin_popcountll(w->cov[i] & ~ex->coverage[i]);
+            ex->coverage[i] |= w->cov[i];
+            w->cov[i] = 0;
+        }
+    }
+    memcpy(w->seen, ex->coverage, sizeof(w->seen));
+    ex->edges += found;
+    int nCorpus = atomic_load_explicit(&ex->nCorpus, memory_order_relaxed);
+    bool added = found && nCorpus < EXPLORE_CORPUS;
+    if(added){
+        ex->corpus[nCorpus] = *input;
+        ex->corpus[nCorpus].n = input->used;
+        atomic_store_explicit(&ex->nCorpus, nCorpus + 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&ex->lock);
+    return added;
+}
+
+//================================================
+// shrinks an input that faults to one that
+// still faults the same way at the same
+// address: values it never read go, then every
+// value it can do without, then the rest move
+// as close to 0 as they will go
+//================================================
+void exploreMinimize(ExploreWorker *w, Hatchling * hatchling, ExploreInput *input, Termination stop, unsigned char at){
+    const Explorer *ex = w->explorer;
+    ExploreInput t;
+    #define SAME_FAULT() (exploreRun(hatchling, ex, &t, w->scratch, w->dirty) == stop && hatchling->instructCntr == at)
+
+    input->n = input->used;
+    for(int i = input->n - 1; i >= 0; i--){
+        t = *input;
+        memmove(&t.values[i], &t.values[i + 1], (t.n - i - 1) * sizeof(signed short));
+        t.n--;
+        if(SAME_FAULT()){
+            *input = t;
+        }
+    }
+    for(int i = 0; i < input->n; i++){
+        t = *input;
+        t.values[i] = 0;
+        if(SAME_FAULT()){
+            *input = t;
+            continue;
+        }
+
+        //0 doesn't do, halve the value while it still faults
+        for(;;){
+            t = *input;
+            t.values[i] /= 2;
+            if(t.values[i] == 0 || !SAME_FAULT()){
+                break;
+            }
+            *input = t;
+        }
+    }
+
+    //a last run tells how many of the values are read
+    t = *input;
+    if(SAME_FAULT()){
+        input->n = input->used = t.used;
+    }
+    #undef SAME_FAULT
+}
+
+//================================================
+// runs one input, keeps it if it covered
+// anything new, and records and minimizes the
+// first input to fault at each address
+//================================================
+void exploreTry(ExploreWorker *w, Hatchling * hatchling, ExploreInput *input){
+    Explorer *ex = w->explorer;
+    Termination stop = exploreRun(hatchling, ex, input, w->cov, w->dirty);
+    unsigned char at = hatchling->instructCntr;
+    exploreMerge(w, input);
+    if(stop != TERM_OVERFLOW && stop != TERM_DIVIDE_BY_ZERO && stop != TERM_UNDEFINED_OPCODE){
+        return;
+    }
+
+    pthread_mutex_lock(&ex->lock);
+    bool first = !ex->crashSeen[stop - TERM_OVERFLOW][at];
+    ex->crashSeen[stop - TERM_OVERFLOW][at] = true;
+    pthread_mutex_unlock(&ex->lock);
+    if(!first){
+        return;
+    }
+
+    ExploreCrash crash = {stop, at, (nowNs() - ex->t0) / 1e9, *input};
+    exploreMinimize(w, hatchling, &crash.input, stop, at);
+    pthread_mutex_lock(&ex->lock);
+    ex->crashes[ex->nCrashes++] = crash;
+    pthread_mutex_unlock(&ex->lock);
+}
+
+//================================================
+// explorer worker: first every dictionary value
+// in every READ, alone and in all of them at
+// once, dealt out across the workers, then
+// mutations of random corpus entries until the
+// search stops
+//================================================
+void *exploreThread(void *arg){
+    ExploreWorker *w = arg;
+    Explorer *ex = w->explorer;
+    Hatchling h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.mem, ex->start.mem, sizeof(h.mem));
+    h.read = exploreRead;
+    h.write = NULL;
+    h.out = NULL;
+
+    ExploreInput input;
+    unsigned long long runs = 0;
+    int nEnum = ex->nDict * (EXPLORE_MAX_READS + 1);
+    for(int e = w->id; e < nEnum && !atomic_load_explicit(&ex->stop, memory_order_relaxed); e += ex->nWorkers){
+        signed short d = ex->dict[e / (EXPLORE_MAX_READS + 1)];
+        int at = e % (EXPLORE_MAX_READS + 1);
+        input.n = EXPLORE_MAX_READS;
+        for(int i = 0; i < input.n; i++){
+            input.values[i] = at == EXPLORE_MAX_READS || at == i ? d : 0;
+        }
+        exploreTry(w, &h, &input);
+        if(++runs % EXPLORE_BATCH == 0){
+            atomic_store_explicit(&w->runs, runs, memory_order_relaxed);
+        }
+    }
+
+    while(!atomic_load_explicit(&ex->stop, memory_order_relaxed)){
+        for(int k = 0; k < EXPLORE_BATCH; k++){
+            int nCorpus = atomic_load_explicit(&ex->nCorpus, memory_order_acquire);
+            input = ex->corpus[exploreRandom(w) % nCorpus];
+            exploreMutate(w, &input);
+            exploreTry(w, &h, &input);
+        }
+        runs += EXPLORE_BATCH;
+        atomic_store_explicit(&w->runs, runs, memory_order_relaxed);
+    }
+    atomic_store_explicit(&w->runs, runs, memory_order_relaxed);
+    return NULL;
+}
+
+//================================================
+// an input the way READ takes it from the
+// terminal: base 16 values, - for negative
+//================================================
+char *formatInput(char *p, const ExploreInput *input){
+    for(int i = 0; i < input->n; i++){
+        int v = input->values[i];
+        p += sprintf(p, "%s%s%X", i ? " " : "", v < 0 ? "-" : "", v < 0 ? -v : v);
+    }
+    return p;
+}
+
+//================================================
+// --explore: searches the READ inputs of the
+// loaded program on a worker per core (or
+// --threads) for the given number of seconds,
+// printing runs and covered edges every second,
+// then the faults it found with the smallest
+// input for each. --corpus=DIR keeps the corpus
+// and the faulting inputs as files of values
+// that can be fed to the program's READs
+//================================================
+int runExplore(Hatchling * hatchling, const char *path, const Options * opts){
+    static const char *const faultNames[] = {"OVERFLOW", "DIVIDE_BY_ZERO", "UNDEFINED_OPCODE"};
+    Explorer *ex = calloc(1, sizeof(Explorer));
+    takeSnapshot(&ex->start, hatchling);
+    ex->maxSteps = opts->maxSteps ? opts->maxSteps : EXPLORE_STEPS;
+    pthread_mutex_init(&ex->lock, NULL);
+
+    //interesting values: the extremes, around 0, and around every word of the program
+    bool *seen = calloc(65536, sizeof(bool));
+    static const int fixed[] = {-32768, -32767, -256, -1, 0, 1, 255, 32767};
+    for(int k = 0; k < 8; k++){
+        seen[fixed[k] + 32768] = true;
+    }
+    for(int i = 0; i < 256; i++){
+        for(int d = -1; d <= 1; d++){
+            int v = (signed short)hatchling->mem[i] + d;
+            if(v >= -32768 && v <= 32767){
+                seen[v + 32768] = true;
+            }
+        }
+    }
+    for(int v = 0; v < 65536; v++){
+        if(seen[v]){
+            ex->dict[ex->nDict++] = v - 32768;
+        }
+    }
+    free(seen);
+
+    //the search starts from the input with no values
+    ex->corpus = calloc(EXPLORE_CORPUS, sizeof(ExploreInput));
+    ex->crashes = calloc(3 * 256, sizeof(ExploreCrash));
+    atomic_store(&ex->nCorpus, 1);
+    atomic_store(&ex->stop, false);
+
+    int nWorkers = opts->threads > 0 ? opts->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(nWorkers > MAX_CORES){
+        nWorkers = MAX_CORES;
+    }
+    if(nWorkers < 1){
+        nWorkers = 1;
+    }
+    ex->nWorkers = nWorkers;
+    ExploreWorker *workers = aligned_alloc(64, nWorkers * sizeof(ExploreWorker));
+    memset(workers, 0, nWorkers * sizeof(ExploreWorker));
+
+    printf("*** EXPLORE: %s, %d THREADS, %.0f SECONDS, %d DICTIONARY VALUES ***\n\n", path, nWorkers, opts->explore, ex->nDict);
+    printf(" SECS          RUNS      RUNS/SEC   EDGES  EDGES/SEC  CORPUS  FAULTS\n");
+    ex->t0 = nowNs();
+    for(int w = 0; w < nWorkers; w++){
+        workers[w].explorer = ex;
+        workers[w].id = w;
+        workers[w].rng = 0x9E3779B97F4A7C15ULL * (w + 1);
+        pthread_create(&workers[w].thread, NULL, exploreThread, &workers[w]);
+    }
+
+    //report once a second until the budget is used up
+    unsigned long long lastRuns = 0;
+    int lastEdges = 0;
+    double elapsed = 0;
+    for(int sec = 1; elapsed < opts->explore; sec++){
+        double wake = ex->t0 + (sec < opts->explore ? sec : opts->explore) * 1e9;
+        double now;
+        while((now = nowNs()) < wake){
+            long long left = (long long)(wake - now);
+            struct timespec nap = {left / 1000000000, left % 1000000000};
+            nanosleep(&nap, NULL);
+        }
+        elapsed = (now - ex->t0) / 1e9;
+
+        unsigned long long runs = 0;
+        for(int w = 0; w < nWorkers; w++){
+            runs += atomic_load_explicit(&workers[w].runs, memory_order_relaxed);
+        }
+        pthread_mutex_lock(&ex->lock);
+        int edges = ex->edges;
+        int nCrashes = ex->nCrashes;
+        pthread_mutex_unlock(&ex->lock);
+        double span = elapsed - (sec - 1);
+        printf("%5.0f  %12llu  %12.0f  %6d  %9.0f  %6d  %6d\n", elapsed, runs, (runs - lastRuns) / span, edges,
+               (edges - lastEdges) / span, atomic_load(&ex->nCorpus), nCrashes);
+        fflush(stdout);
+        lastRuns = runs;
+        lastEdges = edges;
+    }
+
+    atomic_store(&ex->stop, true);
+    unsigned long long runs = 0;
+    for(int w = 0; w < nWorkers; w++){
+        pthread_join(workers[w].thread, NULL);
+        runs += workers[w].runs;
+    }
+    elapsed = (nowNs() - ex->t0) / 1e9;
+    int nCorpus = atomic_load(&ex->nCorpus);
+
+    printf("\n*** EXPLORED: %llu RUNS, %.0f RUNS/SEC, %d EDGES, %d INPUTS IN CORPUS, %d FAULTS ***\n",
+           runs, runs / elapsed, ex->edges, nCorpus, ex->nCrashes);
+    char line[EXPLORE_MAX_READS * 8 + 1];
+    if(ex->nCrashes){
+        printf("\nFAULT              AT   FOUND  INPUT\n");
+    }
+    for(int i = 0; i < ex->nCrashes; i++){
+        ExploreCrash *c = &ex->crashes[i];
+        formatInput(line, &c->input);
+        printf("%-17s  %02X  %5.2fs  %s\n", faultNames[c->stop - TERM_OVERFLOW], c->at, c->found, c->input.n ? line : "(none)");
+    }
+
+    int status = 0;
+    if(opts->corpusPath){
+        mkdir(opts->corpusPath, 0755);
+        char file[4096];
+        for(int i = 0; i < nCorpus + ex->nCrashes && status == 0; i++){
+            const ExploreInput *input;
+            if(i < nCorpus){
+                input = &ex->corpus[i];
+                snprintf(file, sizeof(file), "%s/input-%04d.txt", opts->corpusPath, i);
+            }
+            else{
+                ExploreCrash *c = &ex->crashes[i - nCorpus];
+                input = &c->input;
+                snprintf(file, sizeof(file), "%s/fault-%s-%02X.txt", opts->corpusPath, faultNames[c->stop - TERM_OVERFLOW], c->at);
+            }
+            FILE *f = fopen(file, "w");
+            if(f == NULL){
+                printf("Could not open %s for writing\n", file);
+                status = 1;
+                break;
+            }
+            formatInput(line, input);
+            for(char *p = line; *p; p++){
+                if(*p == ' '){
+                    *p = '\n';
+                }
+            }
+            fprintf(f, input->n ? "%s\n" : "%s", line);
+            fclose(f);
+        }
+    }
+
+    pthread_mutex_destroy(&ex->lock);
+    free(workers);
+    free(ex->corpus);
+    free(ex->crashes);
+    free(ex);
+    return status;
+}
+
+#ifdef HML_SERVE
+#define SERVE_MAX_REQUEST   (1 << 20)       //largest request body accepted
+#define SERVE_MAX_OUTPUTS   65536           //WRTE values returned per run, later ones are only counted
+#define SERVE_STEPS         (1ULL << 24)    //step budget of every run unless --max-steps says otherwise
+#define SERVE_PER_WORKER    8               //pending jobs per worker before requests stop being read
+#define SERVE_CONN_DEPTH    256             //requests one connection may have in flight
+#define SERVE_OUT_HIGH      (1 << 20)       //unsent response bytes at which a connection stops being read
+
+volatile sig_atomic_t serveStop = 0;
+
+void serveSignal(int sig){
+    (void)sig;
+    serveStop = 1;
+}
+
+//================================================
+// a worker's READ input and WRTE output for the
+// job it's running
+//================================================
+struct serveIo{
+    const signed short *inputs;
+    int nInputs;
+    int next;                       //next input READ takes
+    signed short *outputs;          //SERVE_MAX_OUTPUTS values
+    unsigned int nOutputs;
+    unsigned int written;
+};
+typedef struct serveIo ServeIo;
+
+HmlStatus serveRead(Hatchling * hatchling, long *value){
+    ServeIo *io = hatchling->in;
+    if(io->next == io->nInputs){
+        return HML_END_OF_INPUT;
+    }
+    *value = io->inputs[io->next++];
+    return HML_OK;
+}
+
+void serveWrite(Hatchling * hatchling, signed short value){
+    ServeIo *io = hatchling->out;
+    if(io->nOutputs < SERVE_MAX_OUTPUTS){
+        io->outputs[io->nOutputs++] = value;
+    }
+    io->written++;
+}
+
+//================================================
+// loads and runs one request on the worker's
+// context and builds its framed response
+//================================================
+void serveRun(ServeJob *job, Hatchling * hatchling, ServeIo *io, unsigned long long maxSteps){
+    ServeRequest req;
+    memcpy(&req, job->request, sizeof(req));
+    size_t inputsLen = req.nInputs * sizeof(signed short);
+    const char *program = job->request + sizeof(req) + inputsLen;
+
+    io->inputs = (const signed short *)(job->request + sizeof(req));
+    io->nInputs = req.nInputs;
+    io->next = 0;
+    io->nOutputs = 0;
+    io->written = 0;
+
+    unsigned long long steps = 0;
+    HmlStatus status = hmlLoad(hatchling, program, job->requestLen - sizeof(req) - inputsLen, NULL);
+    if(status == HML_OK){
+        status = hmlRun(hatchling, maxSteps, &steps);
+    }
+
+    ServeResponse resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.tag = req.tag;
+    resp.status = status;
+    resp.steps = steps > 0xFFFFFFFF ? 0xFFFFFFFF : (unsigned int)steps;
+    resp.written = io->written;
+    resp.nOutputs = io->nOutputs;
+    resp.accumulator = hatchling->accumulator;
+    resp.instructReg = hatchling->instructReg;
+    resp.instructCntr = hatchling->instructCntr;
+    resp.opCode = hatchling->opCode;
+    resp.operand = hatchling->operand;
+    memcpy(resp.mem, hatchling->mem, sizeof(resp.mem));
+
+    unsigned int bodyLen = sizeof(resp) + io->nOutputs * sizeof(signed short);
+    job->responseLen = 4 + bodyLen;
+    job->response = malloc(job->responseLen);
+    memcpy(job->response, &bodyLen, 4);
+    memcpy(job->response + 4, &resp, sizeof(resp));
+    memcpy(job->response + 4 + sizeof(resp), io->outputs, io->nOutputs * sizeof(signed short));
+}
+
+//================================================
+// worker thread: takes queued jobs until the
+// server stops, hands each finished one to the
+// event loop through the done list
+//================================================
+void *serveWorker(void *arg){
+    Server *server = arg;
+    Hatchling hatchling;
+    ServeIo io;
+    io.outputs = malloc(SERVE_MAX_OUTPUTS * sizeof(signed short));
+    hmlInit(&hatchling);
+    hmlSetIo(&hatchling, serveRead, serveWrite, &io, &io);
+
+    pthread_mutex_lock(&server->lock);
+    while(true){
+        while(server->queueHead == NULL && !server->stopping){
+            pthread_cond_wait(&server->work, &server->lock);
+        }
+        if(server->stopping){
+            break;
+        }
+        ServeJob *job = server->queueHead;
+        server->queueHead = job->link;
+        if(server->queueHead == NULL){
+            server->queueTail = NULL;
+        }
+        pthread_mutex_unlock(&server->lock);
+
+        serveRun(job, &hatchling, &io, server->maxSteps);
+
+        pthread_mutex_lock(&server->lock);
+        bool wake = server->doneList == NULL;
+        job->link = server->doneList;
+        server->doneList = job;
+        server->pending--;
+        if(wake){
+            unsigned long long one = 1;
+            if(write(server->wakeFd, &one, sizeof(one)) < 0){
+                //the counter is already non-zero, the event loop will wake anyway
+            }
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+    free(io.outputs);
+    return NULL;
+}
+
+//================================================
+// asks epoll for reading while the connection
+// may take more requests and for writing while
+// it has unsent responses
+//================================================
+void serveWatch(Server *server, ServeConn *conn){
+    if(conn->closed){
+        return;
+    }
+    pthread_mutex_lock(&server->lock);
+    bool full = server->pending >= server->capacity;
+    pthread_mutex_unlock(&server->lock);
+
+    unsigned int events = 0;
+    if(!conn->eof && !full && conn->inFlight < SERVE_CONN_DEPTH && conn->outLen - conn->outPos < SERVE_OUT_HIGH){
+        events |= EPOLLIN;
+    }
+    if(conn->outPos < conn->outLen){
+        events |= EPOLLOUT;
+    }
+    if(events != conn->events){
+        struct epoll_event ev = {.events = events, .data.ptr = conn};
+        epoll_ctl(server->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+        conn->events = events;
+    }
+}
+
+//================================================
+// drops a connection. Jobs still running hold a
+// pointer to it, so serveReap() frees it once the
+// last of them has been collected.
+//================================================
+void serveClose(Server *server, ServeConn *conn){
+    if(!conn->closed){
+        epoll_ctl(server->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+        close(conn->fd);
+        conn->closed = true;
+    }
+}
+
+void serveReap(Server *server){
+    //backwards, because freeing a connection moves the last one into its place
+    for(int i = server->nConns - 1; i >= 0; i--){
+        ServeConn *conn = server->conns[i];
+        if(conn->closed && conn->inFlight == 0){
+            server->conns[i] = server->conns[--server->nConns];
+            free(conn->in);
+            free(conn->out);
+            free(conn);
+        }
+    }
+}
+
+//================================================
+// true once a client that has sent its last
+// request has had every answer
+//================================================
+bool serveFinished(const ServeConn *conn){
+    unsigned int len = 0;
+    if(conn->inLen >= 4){
+        memcpy(&len, conn->in, 4);
+    }
+    bool waiting = conn->inLen >= 4 && conn->inLen - 4 >= len;
+    return conn->eof && conn->inFlight == 0 && conn->outPos == conn->outLen && !waiting;
+}
+
+//================================================
+// sends as much of the connection's responses as
+// the socket takes without blocking
+//================================================
+void serveFlush(Server *server, ServeConn *conn){
+    while(!conn->closed && conn->outPos < conn->outLen){
+        ssize_t n = send(conn->fd, conn->out + conn->outPos, conn->outLen - conn->outPos, MSG_NOSIGNAL);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                serveClose(server, conn);
+            }
+            return;
+        }
+        conn->outPos += n;
+    }
+    if(conn->outPos == conn->outLen){
+        conn->outPos = conn->outLen = 0;
+        if(serveFinished(conn)){
+            serveClose(server, conn);
+        }
+    }
+}
+
+//================================================
+// turns complete requests in the connection's
+// input into queued jobs, as many as the
+// connection and the workers have room for
+//================================================
+void serveParse(Server *server, ServeConn *conn){
+    size_t pos = 0;
+    while(!conn->closed && conn->inLen - pos >= 4 && conn->inFlight < SERVE_CONN_DEPTH){
+        unsigned int len;
+        memcpy(&len, conn->in + pos, 4);
+        ServeRequest req;
+        if(len < sizeof(req) || len > SERVE_MAX_REQUEST){
+            serveClose(server, conn);
+            return;
+        }
+        if(conn->inLen - pos - 4 < len){
+            break;
+        }
+        memcpy(&req, conn->in + pos + 4, sizeof(req));
+        if(sizeof(req) + req.nInputs * sizeof(signed short) > len){
+            serveClose(server, conn);
+            return;
+        }
+
+        pthread_mutex_lock(&server->lock);
+        bool full = server->pending >= server->capacity;
+        pthread_mutex_unlock(&server->lock);
+        if(full){
+            break;
+        }
+
+        ServeJob *job = calloc(1, sizeof(ServeJob));
+        job->conn = conn;
+        job->requestLen = len;
+        job->request = malloc(len);
+        memcpy(job->request, conn->in + pos + 4, len);
+        pos += 4 + len;
+        if(conn->tail){
+            conn->tail->next = job;
+        }
+        else{
+            conn->head = job;
+        }
+        conn->tail = job;
+        conn->inFlight++;
+
+        pthread_mutex_lock(&server->lock);
+        if(server->queueTail){
+            server->queueTail->link = job;
+        }
+        else{
+            server->queueHead = job;
+        }
+        server->queueTail = job;
+        server->pending++;
+        pthread_cond_signal(&server->work);
+        pthread_mutex_unlock(&server->lock);
+    }
+    if(pos > 0 && !conn->closed){
+        memmove(conn->in, conn->in + pos, conn->inLen - pos);
+        conn->inLen -= pos;
+    }
+}
+
+//================================================
+// reads whatever the client has sent
+//================================================
+void serveReceive(Server *server, ServeConn *conn){
+    while(!conn->closed && !conn->eof){
+        if(conn->inCap - conn->inLen < 65536){
+            conn->inCap = conn->inCap * 2 > conn->inLen + 65536 ? conn->inCap * 2 : conn->inLen + 65536;
+            conn->in = realloc(conn->in, conn->inCap);
+        }
+        ssize_t n = recv(conn->fd, conn->in + conn->inLen, conn->inCap - conn->inLen, 0);
+        if(n > 0){
+            conn->inLen += n;
+
+            //stop once a full request is waiting so one client can't buffer without bound
+            if(conn->inLen > SERVE_MAX_REQUEST + 4){
+                break;
+            }
+            continue;
+        }
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            break;
+        }
+        if(n < 0){
+            serveClose(server, conn);
+            return;
+        }
+        conn->eof = true;
+    }
+    serveParse(server, conn);
+    if(!conn->closed && serveFinished(conn)){
+        serveClose(server, conn);
+    }
+}
+
+//================================================
+// moves finished jobs to their connections'
+// output, in request order
+//================================================
+void serveCollect(Server *server){
+    unsigned long long count;
+    if(read(server->wakeFd, &count, sizeof(count)) < 0){
+        //nothing to collect yet
+    }
+    pthread_mutex_lock(&server->lock);
+    ServeJob *done = server->doneList;
+    server->doneList = NULL;
+    pthread_mutex_unlock(&server->lock);
+
+    for(ServeJob *job = done; job; job = job->link){
+        job->done = true;
+    }
 
-            /* replace accumulator value with the product of itself and the signed data word 
-                at the memory location specified by the operand */
-            hatchling->accumulator *= (signed short)hatchling->mem[hatchling->operand];
-            hatchling->instructCntr++;
+    //start somewhere new each time so no connection always gets first pick of the room
+    int start = server->nConns ? server->rotate++ % server->nConns : 0;
+    for(int i = 0; i < server->nConns; i++){
+        ServeConn *conn = server->conns[(start + i) % server->nConns];
+        while(conn->head && conn->head->done){
+            ServeJob *head = conn->head;
+            conn->head = head->next;
+            if(conn->head == NULL){
+                conn->tail = NULL;
+            }
+            if(!conn->closed){
+                if(conn->outCap - conn->outLen < head->responseLen){
+                    conn->outCap = conn->outCap * 2 > conn->outLen + head->responseLen ? conn->outCap * 2 : conn->outLen + head->responseLen;
+                    conn->out = realloc(conn->out, conn->outCap);
+                }
+                memcpy(conn->out + conn->outLen, head->response, head->responseLen);
+                conn->outLen += head->responseLen;
+            }
+            conn->inFlight--;
+            free(head->request);
+            free(head->response);
+            free(head);
+        }
+
+        //workers have room again, so every connection gets to send and queue what it has
+        if(conn->closed){
+            continue;
+        }
+        serveFlush(server, conn);
+        if(!conn->closed){
+            serveParse(server, conn);
+        }
+        if(!conn->closed){
+            serveWatch(server, conn);
+        }
+    }
+}
+
+//================================================
+// takes every connection waiting on the listening
+// socket
+//================================================
+void serveAccept(Server *server){
+    while(true){
+        int fd = accept(server->listenFd, NULL, NULL);
+        if(fd < 0){
             return;
         }
-        
-        case DIV:
-        {
-            if(hatchling->mem[hatchling->operand] == 0){
-                printf("*** ATTEMPT TO DIVIDE BY ZERO ***\n");
-                printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
-
-                //halts program if a divide-by-zero is attempted by halting
-                hatchling->fatalError = true;
-                return;
-            }
-            int quo = hatchling->accumulator / (signed short)hatchling->mem[hatchling->operand];
-            if(quo < -32768 || quo > 32767){
-                printf("*** ACCUMULATOR OVERFLOW ***\n");
-                printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        ServeConn *conn = calloc(1, sizeof(ServeConn));
+        conn->fd = fd;
+        conn->events = EPOLLIN;
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = conn};
+        epoll_ctl(server->epfd, EPOLL_CTL_ADD, fd, &ev);
+        if(server->nConns == server->connsCap){
+            server->connsCap = server->connsCap ? server->connsCap * 2 : 16;
+            server->conns = realloc(server->conns, server->connsCap * sizeof(ServeConn *));
+        }
+        server->conns[server->nConns++] = conn;
+    }
+}
+
+//================================================
+// --serve=SOCKET: a long-running simulation
+// daemon. One thread runs an epoll loop over the
+// listening socket and every connection, turning
+// requests into jobs for a pool of --threads
+// workers (one per core by default) that run them
+// on the library. Connections may pipeline
+// requests. Once every worker has
+// SERVE_PER_WORKER jobs pending, a connection has
+// SERVE_CONN_DEPTH requests in flight or its
+// client stops reading responses, the server stops
+// reading requests until there's room again.
+// Every run is bounded by --max-steps
+// (SERVE_STEPS by default). SIGINT or SIGTERM
+// shut the server down.
+//================================================
+int runServer(const char *path, const Options * opts){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "Socket path %s is too long\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if(server.listenFd < 0 || bind(server.listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server.listenFd, SOMAXCONN) != 0){
+        fprintf(stderr, "Could not listen on %s\n", path);
+        return 1;
+    }
+    fcntl(server.listenFd, F_SETFL, fcntl(server.listenFd, F_GETFL) | O_NONBLOCK);
+    server.epfd = epoll_create1(EPOLL_CLOEXEC);
+    server.wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &server.listenFd};
+    epoll_ctl(server.epfd, EPOLL_CTL_ADD, server.listenFd, &ev);
+    ev.data.ptr = &server.wakeFd;
+    epoll_ctl(server.epfd, EPOLL_CTL_ADD, server.wakeFd, &ev);
+
+    int nWorkers = opts->threads > 0 ? opts->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(nWorkers < 1){
+        nWorkers = 1;
+    }
+    server.capacity = nWorkers * SERVE_PER_WORKER;
+    server.maxSteps = opts->maxSteps ? opts->maxSteps : SERVE_STEPS;
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.work, NULL);
+    pthread_t *threads = malloc(nWorkers * sizeof(pthread_t));
+    for(int w = 0; w < nWorkers; w++){
+        pthread_create(&threads[w], NULL, serveWorker, &server);
+    }
+
+    //no SA_RESTART, so the signal interrupts epoll_wait
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = serveSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("*** SERVING ON %s WITH %d WORKERS ***\n", path, nWorkers);
+    fflush(stdout);
+
+    struct epoll_event events[64];
+    while(!serveStop){
+        int n = epoll_wait(server.epfd, events, 64, -1);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            break;
+        }
+        for(int i = 0; i < n; i++){
+            if(events[i].data.ptr == &server.listenFd){
+                serveAccept(&server);
+                continue;
+            }
+            if(events[i].data.ptr == &server.wakeFd){
+                serveCollect(&server);
+                continue;
+            }
+
+            //connections closed earlier in this batch are still allocated until serveReap()
+            ServeConn *conn = events[i].data.ptr;
+            if(!conn->closed && (events[i].events & EPOLLIN)){
+                serveReceive(&server, conn);
+            }
+            if(!conn->closed && (events[i].events & EPOLLOUT)){
+                serveFlush(&server, conn);
+            }
+            if(!conn->closed && (events[i].events & (EPOLLHUP | EPOLLERR))){
+                serveClose(&server, conn);
+            }
+            serveWatch(&server, conn);
+        }
+        serveReap(&server);
+    }
+
+    pthread_mutex_lock(&server.lock);
+    server.stopping = true;
+    pthread_cond_broadcast(&server.work);
+    pthread_mutex_unlock(&server.lock);
+    for(int w = 0; w < nWorkers; w++){
+        pthread_join(threads[w], NULL);
+    }
+    for(int i = 0; i < server.nConns; i++){
+        ServeConn *conn = server.conns[i];
+        for(ServeJob *job = conn->head, *next; job; job = next){
+            next = job->next;
+            free(job->request);
+            free(job->response);
+            free(job);
+        }
+        conn->inFlight = 0;
+        serveClose(&server, conn);
+    }
+    serveReap(&server);
+    free(server.conns);
+    free(threads);
+    close(server.epfd);
+    close(server.wakeFd);
+    close(server.listenFd);
+    unlink(path);
+    printf("*** SERVER STOPPED ***\n");
+    return 0;
+}
+
+//================================================
+// one load generator connection
+//================================================
+struct loadClient{
+    const char *path;               //server socket
+    const char *request;            //framed request, the tag is filled in per send
+    size_t requestLen;
+    int requests;                   //requests to send
+    int pipeline;                   //requests kept in flight
+    double *latency;                //ns from queueing each request to its response
+    char *first;                    //body of the first response
+    size_t firstLen;
+    int mismatches;                 //responses out of order or different from the first
+    bool failed;                    //couldn't connect, or the server hung up early
+};
+typedef struct loadClient LoadClient;
+
+void *loadThread(void *arg){
+    LoadClient *c = arg;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", c->path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0){
+        c->failed = true;
+        c->requests = 0;
+        if(fd >= 0){
+            close(fd);
+        }
+        return NULL;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    char *out = malloc(c->pipeline * c->requestLen);
+    size_t outLen = 0, outPos = 0;
+    size_t inCap = 65536, inLen = 0;
+    char *in = malloc(inCap);
+    double *sentAt = malloc(c->requests * sizeof(double));
+    int sent = 0, received = 0;
+
+    while(received < c->requests){
+        //top the pipeline up
+        if(sent < c->requests && sent - received < c->pipeline){
+            memmove(out, out + outPos, outLen - outPos);
+            outLen -= outPos;
+            outPos = 0;
+            while(sent < c->requests && sent - received < c->pipeline){
+                unsigned int tag = sent;
+                memcpy(out + outLen, c->request, c->requestLen);
+                memcpy(out + outLen + 4, &tag, 4);
+                outLen += c->requestLen;
+                sentAt[sent++] = nowNs();
+            }
+        }
+
+        struct pollfd pfd = {.fd = fd, .events = POLLIN | (outPos < outLen ? POLLOUT : 0)};
+        if(poll(&pfd, 1, -1) < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            c->failed = true;
+            break;
+        }
+        if(pfd.revents & POLLOUT){
+            ssize_t n = send(fd, out + outPos, outLen - outPos, MSG_NOSIGNAL);
+            if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                c->failed = true;
+                break;
+            }
+            outPos += n > 0 ? n : 0;
+        }
+        if(!(pfd.revents & (POLLIN | POLLHUP | POLLERR))){
+            continue;
+        }
+        if(inCap - inLen < 65536){
+            inCap *= 2;
+            in = realloc(in, inCap);
+        }
+        ssize_t n = recv(fd, in + inLen, inCap - inLen, 0);
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)){
+            continue;
+        }
+        if(n <= 0){
+            c->failed = true;
+            break;
+        }
+        inLen += n;
 
-                //halts program if operation results in accumulator overflow
-                hatchling->fatalError = true;
-                return;
+        size_t pos = 0;
+        while(inLen - pos >= 4){
+            unsigned int len;
+            memcpy(&len, in + pos, 4);
+            if(inLen - pos - 4 < len){
+                break;
+            }
+            const char *body = in + pos + 4;
+            unsigned int tag;
+            memcpy(&tag, body, 4);
+            if(len < sizeof(ServeResponse) || tag >= (unsigned int)sent){
+                c->failed = true;
+                break;
+            }
+            c->latency[received] = nowNs() - sentAt[tag];
+            if(tag != (unsigned int)received){
+                c->mismatches++;
+            }
+            if(c->first == NULL){
+                c->first = malloc(len);
+                memcpy(c->first, body, len);
+                c->firstLen = len;
+            }
+            else if(len != c->firstLen || memcmp(body + 4, c->first + 4, len - 4) != 0){
+                c->mismatches++;
             }
+            received++;
+            pos += 4 + len;
+        }
+        if(c->failed){
+            break;
+        }
+        memmove(in, in + pos, inLen - pos);
+        inLen -= pos;
+    }
+    c->requests = received;
+    close(fd);
+    free(out);
+    free(in);
+    free(sentAt);
+    return NULL;
+}
 
-            /* replace accumulator value with the quotient of itself and the signed data word 
-                at the memory location specified by the operand */
-            hatchling->accumulator /= (signed short)hatchling->mem[hatchling->operand];
-            hatchling->instructCntr++;
-            return;
+//================================================
+// --load=SOCKET: a load generator for --serve.
+// Sends the program with the READ inputs given on
+// standard input over --connections connections,
+// --requests per connection, keeping --pipeline
+// of them in flight on each, then reports
+// throughput and latency percentiles, and the
+// result the server sent back unless
+// --dump=none.
+//================================================
+int runLoad(const char *path, const char *programPath, const Options * opts){
+    FILE *f = fopen(programPath, "r");
+    if(f == NULL){
+        printf("Please enter a valid filepath\n");
+        return 1;
+    }
+
+    //inputs are read the way READ reads them
+    signed short *inputs = NULL;
+    int nInputs = 0;
+    char line[80];
+    while(nInputs < 0xFFFF && scanf("%79s", line) == 1){
+        long dat = strtol(line, NULL, 16);
+        if(dat < -32768 || dat > 32767){
+            printf("Value out of range (-32768 to 32767, base 10)\n");
+            free(inputs);
+            fclose(f);
+            return 1;
         }
-        
-        case MOD:
-        {
-            if(hatchling->mem[hatchling->operand] == 0){
-                printf("*** ATTEMPT TO DIVIDE BY ZERO ***\n");
-                printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
-
-                //halts program if a divide-by-zero is attempted by halting
-                hatchling->fatalError = true;
-                return;
-            }
-            int modul = hatchling->accumulator % (signed short)hatchling->mem[hatchling->operand];
-            if(modul < -32768 || modul > 32767){
-                printf("*** ACCUMULATOR OVERFLOW ***\n");
-                printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
+        inputs = realloc(inputs, (nInputs + 1) * sizeof(signed short));
+        inputs[nInputs++] = dat;
+    }
 
-                //halts program if operation results in accumulator overflow
-                hatchling->fatalError = true;
-                return;
-            }
+    size_t programLen;
+    bool mapped;
+    const char *program = mapStream(f, &programLen, &mapped);
+    ServeRequest req = {0, nInputs, 0};
+    unsigned int len = sizeof(req) + nInputs * sizeof(signed short) + programLen;
+    char *request = malloc(4 + len);
+    memcpy(request, &len, 4);
+    memcpy(request + 4, &req, sizeof(req));
+    if(nInputs > 0){
+        memcpy(request + 4 + sizeof(req), inputs, nInputs * sizeof(signed short));
+    }
+    memcpy(request + 4 + sizeof(req) + nInputs * sizeof(signed short), program, programLen);
+    unmapStream(program, programLen, mapped);
+    fclose(f);
+    free(inputs);
 
-            /* replace accumulator value with the remainder of itself divided by the
-                 signed data word at the memory location specified by the operand */
-            hatchling->accumulator %= (signed short)hatchling->mem[hatchling->operand];
-            hatchling->instructCntr++;
-            return;
+    int nClients = opts->connections > 0 ? opts->connections : 1;
+    int perClient = opts->requests > 0 ? opts->requests : 1;
+    LoadClient *clients = calloc(nClients, sizeof(LoadClient));
+    pthread_t *threads = malloc(nClients * sizeof(pthread_t));
+    double t0 = nowNs();
+    for(int i = 0; i < nClients; i++){
+        clients[i].path = path;
+        clients[i].request = request;
+        clients[i].requestLen = 4 + len;
+        clients[i].requests = perClient;
+        clients[i].pipeline = opts->pipeline > 0 ? opts->pipeline : 1;
+        clients[i].latency = malloc(perClient * sizeof(double));
+        pthread_create(&threads[i], NULL, loadThread, &clients[i]);
+    }
+    int total = 0, mismatches = 0;
+    bool failed = false;
+    for(int i = 0; i < nClients; i++){
+        pthread_join(threads[i], NULL);
+        total += clients[i].requests;
+        mismatches += clients[i].mismatches;
+        failed |= clients[i].failed;
+        if(clients[i].first && clients[0].first && i > 0
+            && (clients[i].firstLen != clients[0].firstLen || memcmp(clients[i].first + 4, clients[0].first + 4, clients[0].firstLen - 4) != 0)){
+            mismatches++;
         }
-       
-        case AND:
-            /* replace accumulator with the bitwise AND of itself and the data word
-                at the memory location specified by the operand */
-            hatchling->accumulator &= hatchling->mem[hatchling->operand];
-            hatchling->instructCntr++;
-            return;
-        
-        case ORR:
-            /* replace accumulator with the bitwise OR of itself and the data word
-                at the memory location specified by the operand */
-            hatchling->accumulator |= hatchling->mem[hatchling->operand];
-            hatchling->instructCntr++;
-            return;
-        
-        case NOT:
-            /* replace accumulator with the logical (not bitwise) 
-                NOT of itself and the data word at the memory 
-                    location specified by the operand */
-            hatchling->accumulator = !hatchling->accumulator;
-            hatchling->instructCntr++;
-            return;
-        
-        case XOR:
-            /* replace accumulator with the bitwise XOR of itself and the data word
-                at the memory location specified by the operand */
-            hatchling->accumulator ^= hatchling->mem[hatchling->operand];
-            hatchling->instructCntr++;
-            return;
-        
-        case LSR:
+    }
+    double seconds = (nowNs() - t0) / 1e9;
 
-            // shifts the bits in the accumulator right by 1 bit (logical)
-            hatchling->accumulator = hatchling->accumulator >> 1;
-            hatchling->instructCntr++;
-            return;
-        
-        case ASR:
-        
-            // shifts the bits in the accumulator right by 1 bit (preserving sign)
-            if(hatchling->accumulator < 0){
-                
-                //shifts the bits in a negative number right by 1 bit while preserving sign
-                hatchling->accumulator = ~(~hatchling->accumulator >> 1);
-                hatchling->instructCntr++;
-                return;
-            }
+    double *latency = malloc((total > 0 ? total : 1) * sizeof(double));
+    int k = 0;
+    for(int i = 0; i < nClients; i++){
+        memcpy(latency + k, clients[i].latency, clients[i].requests * sizeof(double));
+        k += clients[i].requests;
+    }
+    qsort(latency, total, sizeof(double), compareDoubles);
 
-            hatchling->accumulator = hatchling->accumulator >> 1;
-            hatchling->instructCntr++;
-            return;
-        
-        
-        case LSL:
+    printf("*** LOAD: %d CONNECTIONS, %d REQUESTS EACH, PIPELINE %d ***\n\n", nClients, perClient, clients[0].pipeline);
+    printf("REQUESTS        %d\n", total);
+    printf("SECONDS         %.3f\n", seconds);
+    printf("REQUESTS/SEC    %.0f\n", total / seconds);
+    if(total > 0){
+        printf("LATENCY P50     %.1f US\n", latency[total / 2] / 1e3);
+        printf("LATENCY P90     %.1f US\n", latency[(total * 90 + 99) / 100 - 1] / 1e3);
+        printf("LATENCY P99     %.1f US\n", latency[(total * 99 + 99) / 100 - 1] / 1e3);
+        printf("LATENCY P99.9   %.1f US\n", latency[(total * 999 + 999) / 1000 - 1] / 1e3);
+        printf("LATENCY MAX     %.1f US\n", latency[total - 1] / 1e3);
+    }
+    printf("MISMATCHES      %d\n", mismatches);
+    if(failed){
+        printf("*** CONNECTION TO %s FAILED ***\n", path);
+    }
 
-            // shifts the bits in the accumulator left by 1 bit (logical)
-            hatchling->accumulator = hatchling->accumulator << 1;
-            hatchling->instructCntr++;
-            return;
-        
-        case B:
-            /* sets the instruction counter to the program memory location
-                specified by the operand of the B instruction */
-            hatchling->instructCntr = hatchling->operand;
-            return;
-        
-        case BNEG:
+    //the result every request got back, unless --dump=none asks for the numbers alone
+    if(clients[0].first && opts->dump != DUMP_NONE){
+        ServeResponse resp;
+        memcpy(&resp, clients[0].first, sizeof(resp));
+        printf("\nSTATUS          %s\n", hmlStatusName(resp.status));
+        printf("STEPS           %u\n", resp.steps);
+        for(unsigned int i = 0; i < resp.nOutputs; i++){
+            signed short value;
+            memcpy(&value, clients[0].first + sizeof(resp) + i * sizeof(value), sizeof(value));
+            printf("OUTPUT: %04hX (REPRESENTED IN BASE 16, 2'S COMPLEMENT)\n", value);
+        }
+        if(resp.written > resp.nOutputs){
+            printf("(%u MORE OUTPUTS NOT RETURNED)\n", resp.written - resp.nOutputs);
+        }
+        printf("\n");
 
-            /* sets the instruction counter to the program memory location
-                specified by the operand of the BNEG instruction if the 
-                accumulator has a negative value */
-            if(hatchling->accumulator < 0){
-                hatchling->instructCntr = hatchling->operand;
-            }
-            else{
-                hatchling->instructCntr++;
-            }
-            return;
-        
-        case BPOS:
+        Hatchling h;
+        stdioInit(&h);
+        h.accumulator = resp.accumulator;
+        h.instructReg = resp.instructReg;
+        h.instructCntr = resp.instructCntr;
+        h.opCode = resp.opCode;
+        h.operand = resp.operand;
+        memcpy(h.mem, resp.mem, sizeof(h.mem));
+        printDump(&h);
+    }
 
-            /* sets the instruction counter to the program memory location
-                specified by the operand of the BPOS instruction if the 
-                accumulator has a positive value */
-            if(hatchling->accumulator > 0){
-                hatchling->instructCntr = hatchling->operand;
-            }
-            else{
-                hatchling->instructCntr++;
-            }
-            return;
-        
-        case BZRO:
+    for(int i = 0; i < nClients; i++){
+        free(clients[i].latency);
+        free(clients[i].first);
+    }
+    free(clients);
+    free(threads);
+    free(latency);
+    free(request);
+    return failed || mismatches ? 1 : 0;
+}
+#else
+int runServer(const char *path, const Options * opts){
+    (void)opts;
+    printf("Can't serve on %s: --serve needs epoll\n", path);
+    return 1;
+}
 
-            /* sets the instruction counter to the program memory location
-                specified by the operand of the BZRO instruction if the 
-                accumulator has a value of 0 */
-            if(hatchling->accumulator == 0){
-                hatchling->instructCntr = hatchling->operand;
-            }
-            else{
-                hatchling->instructCntr++;
-            }
-            return;
-        
-        case LOAD:
+int runLoad(const char *path, const char *programPath, const Options * opts){
+    (void)programPath;
+    (void)opts;
+    printf("Can't load %s: --load needs epoll\n", path);
+    return 1;
+}
+#endif
 
-            //loading the SIGNED data value into the accumulator
-            hatchling->accumulator = (signed short)hatchling->mem[hatchling->operand];
-            hatchling->instructCntr++;
-            return;
-        
-        case STOR:
+//================================================
+// formats the termination banner and registers
+// of the computer dump into p, returns the end
+//================================================
+char *formatRegisters(char *p, const Hatchling * hatchling){
+    p = PUT_LITERAL(p, "*** PROGRAM EXECUTION TERMINATED ***\n\n");
+    p = PUT_LITERAL(p, "REGISTERS\n");
+    p = hex4(PUT_LITERAL(p, "ACC         "), (unsigned short)hatchling->accumulator);
+    p = hex2(PUT_LITERAL(p, "\nInstCtr       "), hatchling->instructCntr);
+    p = hex4(PUT_LITERAL(p, "\nInstReg     "), hatchling->instructReg);
+    p = hex2(PUT_LITERAL(p, "\nOpCode        "), hatchling->opCode);
+    p = hex2(PUT_LITERAL(p, "\nOperand       "), hatchling->operand);
+    return PUT_LITERAL(p, "\n");
+}
+
+//================================================
+// prints the Hatchling computer dump: the
+// registers followed by program memory. The
+// whole dump is formatted with the hex table and
+// handed to out in one write.
+//================================================
+void printDump(Hatchling * hatchling){
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+    char buf[4096];
+    char *p = formatRegisters(buf, hatchling);
+    p = formatMemory(p, hatchling->mem);
+    fwrite(buf, 1, p - buf, out);
+}
+
+//================================================
+// formats the memory part of the computer dump
+// into p, returns the end
+//================================================
+char *formatMemory(char *p, const unsigned short *mem){
+    p = PUT_LITERAL(p, "\nMemory: \n");
+
+    //prints Hatchling program memory in matrix form
+    p = PUT_LITERAL(p, "    ");
+    for(int i = 0; i < 16; i++){
+        p = PUT_LITERAL(p, "    ");
+        *p++ = hexPairs[i * 2 + 1];
+        p = PUT_LITERAL(p, "   ");
+    }
+
+    for(int i = 0; i < 256; i++){
+
+        //new row in memory output
+        if(i % 16 == 0){
+            *p++ = '\n';
+            p = i ? hex2(p, i) : PUT_LITERAL(p, " 0");
+            p = PUT_LITERAL(p, "   ");
+        }
+        p = PUT_LITERAL(hex4(p, mem[i]), "    ");
+    }
+    *p++ = '\n';
+    return p;
+}
+
+//================================================
+// --dump=changed: the registers followed by the
+// words that differ from loaded, the memory the
+// program started with
+//================================================
+void printDumpChanged(Hatchling * hatchling, const unsigned short *loaded){
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+    char buf[256 * 20 + 256];
+    char *p = formatRegisters(buf, hatchling);
 
-            //stores the accumulator's value in the memory location specified by operand
-            hatchling->mem[hatchling->operand] = hatchling->accumulator;
-            hatchling->instructCntr++;
+    int changed = 0;
+    for(int i = 0; i < 256; i++){
+        changed += hatchling->mem[i] != loaded[i];
+    }
+    p += sprintf(p, "\nMemory changed since load: %d words\n", changed);
+    for(int i = 0; i < 256; i++){
+        if(hatchling->mem[i] != loaded[i]){
+            p = PUT_LITERAL(hex2(p, i), "   ");
+            p = PUT_LITERAL(hex4(p, loaded[i]), " -> ");
+            p = PUT_LITERAL(hex4(p, hatchling->mem[i]), "\n");
+        }
+    }
+    fwrite(buf, 1, p - buf, out);
+}
+
+//================================================
+// ends a run with the dump --dump asked for and
+// the --dump-image file if there is one
+//================================================
+void finishDump(Hatchling * hatchling, const unsigned short *loaded, const Options * opts){
+    FILE *out = hatchling->out ? hatchling->out : stdout;
+    switch(opts->dump){
+        case DUMP_FULL:
+            printDump(hatchling);
+            break;
+        case DUMP_CHANGED:
+            printDumpChanged(hatchling, loaded);
+            break;
+        case DUMP_NONE:
+            fprintf(out, "*** PROGRAM EXECUTION TERMINATED ***\n");
+            break;
+    }
+    if(opts->dumpImagePath){
+        FILE *f = fopen(opts->dumpImagePath, "wb");
+        if(f == NULL){
+            fprintf(out, "Could not open %s for writing\n", opts->dumpImagePath);
             return;
-        
-        case READ: 
+        }
+        writeImage(f, hatchling, hatchling->instructCntr);
+        fclose(f);
+    }
+}
 
-            printf("INPUT A SIGNED SHORT INT (BASE 16, USE - FOR NEGATIVE):  ");
-            char line[80];
-            scanf("%s", line);
+//================================================
+// the computer dump of an extended run: the
+// registers, as wide as the address space, and
+// every page that was written, in the 256-word
+// dump's matrix form
+//================================================
+void printWideDump(FILE *out, const HmlWide *wide){
+    const HmlSpace *space = &wide->space;
+    int digits = space->mask > 0xFFFF ? 6 : 4;
+    fprintf(out, "*** PROGRAM EXECUTION TERMINATED ***\n\n");
+    fprintf(out, "REGISTERS\n");
+    fprintf(out, "ACC         %04hX\n", (unsigned short)wide->core.accumulator);
+    fprintf(out, "%-*s%0*X\n", 16 - digits, "InstCtr", digits, wide->instructCntr);
+    fprintf(out, "InstReg     %04hX\n", wide->core.instructReg);
+    fprintf(out, "OpCode        %02X\n", wide->core.opCode);
+    fprintf(out, "%-*s%0*X\n", 16 - digits, "Operand", digits, wide->operand);
 
-            //read in the number as a base 16 value
-            long dat = strtol(line,NULL,16);
-            if(dat < -32768 || dat > 32767){
-                printf("Value out of range (-32768 to 32767, base 10)\n");
-                return;
+    fprintf(out, "\nMemory: %zu pages of %d words written, %zu KB\n", space->pages, 1 << HML_PAGE_BITS,
+            (space->pages * (sizeof(unsigned short) << HML_PAGE_BITS) + space->nTables * sizeof(space->zeroTable)) / 1024);
+    for(unsigned int page = 0; page <= space->mask >> HML_PAGE_BITS; page++){
+        const unsigned short *words = hmlSpacePage(space, page);
+        if(words == NULL){
+            continue;
+        }
+        fprintf(out, "\n%*s", digits + 2, "");
+        for(int i = 0; i < 16; i++){
+            fprintf(out, "    %X   ", i);
+        }
+        for(int i = 0; i < 1 << HML_PAGE_BITS; i++){
+            if(i % 16 == 0){
+                fprintf(out, "\n%0*X   ", digits, page << HML_PAGE_BITS | i);
             }
-            //otherwise, loading the SIGNED data value into program memory
-            hatchling->mem[hatchling->operand] = (signed short)dat;
-            hatchling->instructCntr++;
-            return;
-        
-        case WRTE:
-            
-            //writes value at memory address specified by operand to standard output as a hex number in 2's complement
-            printf("OUTPUT: %04hX (REPRESENTED IN BASE 16, 2'S COMPLEMENT)\n", (signed short)hatchling->mem[hatchling->operand]);
-            hatchling->instructCntr++;
-            return;
-        
-        case HALT:
-            //do nothing here, execute function handles program behavior
-            return;
-        
-        default:
-            //halts program if we reach undefined opcode
-            printf("*** UNDEFINED HATCHLING OPCODE ***\n");
-            printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
-            hatchling->fatalError = true;
-            return;
+            fprintf(out, "%04hX    ", words[i]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+//================================================
+// --address-bits: loads an extended .hml file
+// into a sparse 16 or 24-bit address space and
+// runs it with the stdio READ and WRTE
+//================================================
+int runWide(const char *path, const Options * opts){
+    if(opts->addressBits != 16 && opts->addressBits != 24){
+        printf("--address-bits must be 16 or 24\n");
+        return 1;
+    }
+    FILE *f = fopen(path, "r");
+    if(f == NULL){
+        printf("Please enter a valid filepath\n");
+        return 0;
+    }
+    HmlWide *wide = hmlWideCreate(opts->addressBits);
+    if(wide == NULL){
+        fclose(f);
+        printf("Could not allocate a %d-bit address space\n", opts->addressBits);
+        return 1;
+    }
+    stdioInit(&wide->core);
+
+    size_t len;
+    bool mapped;
+    const char *data = mapStream(f, &len, &mapped);
+    unsigned long detail = 0;
+    HmlStatus status = hmlWideLoadText(wide, data, len, &detail);
+    unmapStream(data, len, mapped);
+    fclose(f);
+    if(status == HML_TOO_LONG){
+        printf("PROGRAM DOES NOT FIT IN THE %d-BIT ADDRESS SPACE\n", opts->addressBits);
+    }
+    reportLoad(status, detail, stdout);
+    if(status != HML_OK){
+        hmlWideDestroy(wide);
+        return 0;
+    }
+
+    printf("*** PROGRAM LOADING COMPLETED ***\n");
+    printf("*** PROGRAM EXECUTION BEGINS ***\n");
+    unsigned long long steps = 0;
+    do{
+        status = hmlWideRun(wide, opts->maxSteps ? opts->maxSteps - steps : 0, &steps);
+        reportStatus(stdout, status);
+    }while(status == HML_BAD_INPUT);
+    if(status == HML_LIMIT){
+        printf("*** STEP LIMIT OF %llu REACHED ***\n", steps);
+        printf("*** HATCHLING EXECUTION ABNORMALLY TERMINATED ***\n");
+    }
+    if(wide->space.failed){
+        printf("*** OUT OF MEMORY FOR PAGES, SOME WRITES WERE LOST ***\n");
+    }
+
+    if(opts->dump == DUMP_NONE){
+        printf("*** PROGRAM EXECUTION TERMINATED ***\n");
     }
+    else{
+        printWideDump(stdout, wide);
+    }
+    hmlWideDestroy(wide);
+    return 0;
 }
 
 //================================================
@@ -459,80 +5852,375 @@ void executeInstruction(Hatchling * hatchling){
 //================================================
 int main(int argc, char *argv[]){
 
+    Options opts = {
+        .engine = ENGINE_THREADED,
+        .jit = JIT_OFF,
+        .simd = SIMD_AUTO,
+        .entry = -1,
+        .benchLength = 64,
+        .benchDepth = 3,
+        .benchReps = 21,
+        .connections = 4,
+        .requests = 10000,
+        .pipeline = 16,
+        .dump = DUMP_FULL,
+        .replayStep = ~0ULL,
+        .quantum = CORE_QUANTUM,
+        .variant = VARIANT_NONE,
+    };
+#ifdef HML_AOT
+    //a build with a translated program linked in runs it unless told otherwise
+    opts.engine = ENGINE_AOT;
+#endif
+
+    //consume leading --options, the file path (if any) comes last
+    int argi = 1;
+    bool engineChosen = false;
+    while(argi < argc && strncmp(argv[argi], "--", 2) == 0){
+        if(strcmp(argv[argi], "--engine=switch") == 0){
+            opts.engine = ENGINE_SWITCH;
+            engineChosen = true;
+        }
+        else if(strcmp(argv[argi], "--engine=threaded") == 0){
+            opts.engine = ENGINE_THREADED;
+            engineChosen = true;
+        }
+        else if(strcmp(argv[argi], "--engine=aot") == 0){
+            opts.engine = ENGINE_AOT;
+            engineChosen = true;
+        }
+        else if(strcmp(argv[argi], "--jit=off") == 0){
+            opts.jit = JIT_OFF;
+        }
+        else if(strcmp(argv[argi], "--jit=on") == 0){
+            opts.jit = JIT_ON;
+        }
+        else if(strcmp(argv[argi], "--jit=always") == 0){
+            opts.jit = JIT_ALWAYS;
+        }
+        else if(strcmp(argv[argi], "--emit-c") == 0){
+            opts.emitC = true;
+        }
+        else if(strncmp(argv[argi], "--emit-c=", 9) == 0){
+            opts.emitC = true;
+            opts.emitPath = argv[argi] + 9;
+        }
+        else if(strncmp(argv[argi], "--batch=", 8) == 0){
+            opts.batchPath = argv[argi] + 8;
+        }
+        else if(strncmp(argv[argi], "--threads=", 10) == 0){
+            opts.threads = atoi(argv[argi] + 10);
+        }
+        else if(strncmp(argv[argi], "--lanes=", 8) == 0){
+            opts.lanesPath = argv[argi] + 8;
+        }
+        else if(strcmp(argv[argi], "--simd=auto") == 0){
+            opts.simd = SIMD_AUTO;
+        }
+        else if(strcmp(argv[argi], "--simd=avx2") == 0){
+            opts.simd = SIMD_AVX2;
+        }
+        else if(strcmp(argv[argi], "--simd=sse2") == 0){
+            opts.simd = SIMD_SSE2;
+        }
+        else if(strcmp(argv[argi], "--simd=scalar") == 0){
+            opts.simd = SIMD_SCALAR;
+        }
+        else if(strncmp(argv[argi], "--convert=", 10) == 0){
+            opts.convertPath = argv[argi] + 10;
+        }
+        else if(strncmp(argv[argi], "--max-steps=", 12) == 0){
+            opts.maxSteps = strtoull(argv[argi] + 12, NULL, 10);
+        }
+        else if(strncmp(argv[argi], "--max-time=", 11) == 0){
+            opts.maxTime = atof(argv[argi] + 11);
+        }
+        else if(strcmp(argv[argi], "--detect-loops") == 0){
+            opts.detectLoops = true;
+        }
+        else if(strcmp(argv[argi], "--peephole-stats") == 0){
+            opts.peepholeStats = true;
+        }
+        else if(strcmp(argv[argi], "--analyze") == 0){
+            opts.analyze = true;
+        }
+        else if(strcmp(argv[argi], "--optimize") == 0){
+            opts.optimize = true;
+        }
+        else if(strcmp(argv[argi], "--explore") == 0){
+            opts.explore = EXPLORE_SECONDS;
+        }
+        else if(strncmp(argv[argi], "--explore=", 10) == 0){
+            opts.explore = atof(argv[argi] + 10);
+        }
+        else if(strncmp(argv[argi], "--corpus=", 9) == 0){
+            opts.corpusPath = argv[argi] + 9;
+        }
+        else if(strcmp(argv[argi], "--profile") == 0){
+            opts.profile = true;
+        }
+        else if(strncmp(argv[argi], "--profile=", 10) == 0){
+            opts.profile = true;
+            opts.profilePath = argv[argi] + 10;
+        }
+        else if(strcmp(argv[argi], "--bench") == 0){
+            opts.bench = true;
+        }
+        else if(strncmp(argv[argi], "--bench=", 8) == 0){
+            opts.bench = true;
+            opts.benchPath = argv[argi] + 8;
+        }
+        else if(strncmp(argv[argi], "--baseline=", 11) == 0){
+            opts.baselinePath = argv[argi] + 11;
+        }
+        else if(strncmp(argv[argi], "--length=", 9) == 0){
+            opts.benchLength = atoi(argv[argi] + 9);
+        }
+        else if(strncmp(argv[argi], "--depth=", 8) == 0){
+            opts.benchDepth = atoi(argv[argi] + 8);
+        }
+        else if(strncmp(argv[argi], "--reps=", 7) == 0){
+            opts.benchReps = atoi(argv[argi] + 7) > 0 ? atoi(argv[argi] + 7) : 1;
+        }
+        else if(strcmp(argv[argi], "--fork-server") == 0){
+            opts.forkServer = true;
+        }
+        else if(strncmp(argv[argi], "--coverage=", 11) == 0){
+            opts.coveragePath = argv[argi] + 11;
+        }
+        else if(strncmp(argv[argi], "--serve=", 8) == 0){
+            opts.servePath = argv[argi] + 8;
+        }
+        else if(strncmp(argv[argi], "--load=", 7) == 0){
+            opts.loadPath = argv[argi] + 7;
+        }
+        else if(strncmp(argv[argi], "--connections=", 14) == 0){
+            opts.connections = atoi(argv[argi] + 14);
+        }
+        else if(strncmp(argv[argi], "--requests=", 11) == 0){
+            opts.requests = atoi(argv[argi] + 11);
+        }
+        else if(strncmp(argv[argi], "--pipeline=", 11) == 0){
+            opts.pipeline = atoi(argv[argi] + 11);
+        }
+        else if(strcmp(argv[argi], "--stream") == 0){
+            opts.stream = true;
+        }
+        else if(strncmp(argv[argi], "--input=", 8) == 0){
+            opts.stream = true;
+            opts.inputPath = argv[argi] + 8;
+        }
+        else if(strcmp(argv[argi], "--dump=full") == 0){
+            opts.dump = DUMP_FULL;
+        }
+        else if(strcmp(argv[argi], "--dump=changed") == 0){
+            opts.dump = DUMP_CHANGED;
+        }
+        else if(strcmp(argv[argi], "--dump=none") == 0){
+            opts.dump = DUMP_NONE;
+        }
+        else if(strncmp(argv[argi], "--dump-image=", 13) == 0){
+            opts.dumpImagePath = argv[argi] + 13;
+        }
+        else if(strncmp(argv[argi], "--trace=", 8) == 0){
+            opts.tracePath = argv[argi] + 8;
+        }
+        else if(strncmp(argv[argi], "--replay=", 9) == 0){
+            opts.replayPath = argv[argi] + 9;
+        }
+        else if(strncmp(argv[argi], "--at=", 5) == 0){
+            opts.replayStep = strtoull(argv[argi] + 5, NULL, 10);
+        }
+        else if(strncmp(argv[argi], "--cache=", 8) == 0){
+            opts.cacheEntries = atoi(argv[argi] + 8);
+        }
+        else if(strncmp(argv[argi], "--cache-file=", 13) == 0){
+            opts.cachePath = argv[argi] + 13;
+        }
+        else if(strncmp(argv[argi], "--cache-verify=", 15) == 0){
+            opts.cacheVerify = atoi(argv[argi] + 15);
+        }
+        else if(strcmp(argv[argi], "--cache-stats") == 0){
+            opts.cacheStats = true;
+        }
+        else if(strncmp(argv[argi], "--address-bits=", 15) == 0){
+            opts.addressBits = atoi(argv[argi] + 15);
+        }
+        else if(strncmp(argv[argi], "--cores=", 8) == 0){
+            opts.cores = atoi(argv[argi] + 8);
+        }
+        else if(strcmp(argv[argi], "--schedule=threads") == 0){
+            opts.deterministic = false;
+        }
+        else if(strcmp(argv[argi], "--schedule=deterministic") == 0){
+            opts.deterministic = true;
+        }
+        else if(strncmp(argv[argi], "--quantum=", 10) == 0){
+            opts.quantum = atoi(argv[argi] + 10) > 0 ? atoi(argv[argi] + 10) : 1;
+        }
+        else if(strcmp(argv[argi], "--scaling") == 0){
+            opts.scaling = true;
+        }
+        else if(strcmp(argv[argi], "--variant=strict") == 0){
+            opts.variant = VARIANT_STRICT;
+        }
+        else if(strcmp(argv[argi], "--variant=wrapping") == 0){
+            opts.variant = VARIANT_WRAPPING;
+        }
+        else if(strcmp(argv[argi], "--variant=instrumented") == 0){
+            opts.variant = VARIANT_INSTRUMENTED;
+        }
+        else if(strncmp(argv[argi], "--step-log=", 11) == 0){
+            opts.variant = VARIANT_INSTRUMENTED;
+            opts.stepLogPath = argv[argi] + 11;
+        }
+        else if(strncmp(argv[argi], "--entry=", 8) == 0){
+            opts.entry = strtol(argv[argi] + 8, NULL, 16) & 0xFF;
+        }
+        else{
+            printf("Unknown option %s\n", argv[argi]);
+            printf("Options: --engine=switch|threaded|aot --jit=off|on|always --emit-c[=FILE]\n");
+            printf("         --batch=MANIFEST|DIR --threads=N --lanes=FILE --simd=auto|avx2|sse2|scalar\n");
+            printf("         --convert=OUT.hml|OUT.hmb|OUT.hmc --entry=XX\n");
+            printf("         --fork-server --coverage=FILE --profile[=FILE.json] --peephole-stats\n");
+            printf("         --max-steps=N --max-time=SECONDS --detect-loops\n");
+            printf("         --bench[=RESULTS.tsv] --baseline=RESULTS.tsv --length=N --depth=N --reps=N [WORKLOAD.hml ...]\n");
+            printf("         --serve=SOCKET --load=SOCKET --connections=N --requests=N --pipeline=N\n");
+            printf("         --stream --input=FILE --dump=full|changed|none --dump-image=FILE.hmb\n");
+            printf("         --trace=FILE.hmt --replay=FILE.hmt --at=STEP\n");
+            printf("         --cache=ENTRIES --cache-file=FILE --cache-verify=N --cache-stats (with --stream)\n");
+            printf("         --address-bits=16|24 (with --max-steps, --dump=full|none)\n");
+            printf("         --cores=K --schedule=threads|deterministic --quantum=N --scaling\n");
+            printf("         --variant=strict|wrapping|instrumented --step-log=FILE\n");
+            printf("         --analyze --optimize\n");
+            printf("         --explore[=SECONDS] --corpus=DIR (with --threads=N, --max-steps=N)\n");
+            return(0);
+        }
+        argi++;
+    }
+    int nargs = argc - argi;
+
+    //budgeted runs go through executeGuarded()'s own loop, so there's no engine left to pick
+    bool budgeted = opts.maxSteps || opts.maxTime > 0 || opts.detectLoops;
+    if(budgeted && (engineChosen || opts.jit != JIT_OFF || opts.optimize || opts.variant != VARIANT_NONE)){
+        printf("--max-steps, --max-time and --detect-loops can't be used with --engine, --jit, --optimize or --variant\n");
+        return 1;
+    }
+    if(opts.detectLoops && (opts.profile || opts.tracePath)){
+        printf("--detect-loops can't be used with --profile or --trace\n");
+        return 1;
+    }
+
+    //a variant is its own engine, there's nothing left for --engine or --jit to pick
+    if(opts.variant != VARIANT_NONE && (engineChosen || opts.jit != JIT_OFF)){
+        printf("--variant can't be used with --engine or --jit\n");
+        return 1;
+    }
+
+    //the specialized loop is picked once, here, and called directly from then on
+    if(opts.variant == VARIANT_INSTRUMENTED){
+        FILE *log = opts.stepLogPath ? fopen(opts.stepLogPath, "w") : stderr;
+        if(log == NULL){
+            printf("Could not open %s for writing\n", opts.stepLogPath);
+            return 1;
+        }
+        opts.instrument.step = stepLog;
+        opts.instrument.ctx = log;
+    }
+    opts.variantFn = selectVariant(opts.variant);
+
+    //conversion takes any number of input programs
+    if(opts.convertPath && nargs > 0){
+        return runConvert(argv + argi, nargs, opts.convertPath, opts.entry);
+    }
+
+    //the benchmark generates its own programs, any given are timed as workloads too
+    if(opts.bench){
+        return runBench(&opts, argv + argi, nargs);
+    }
+
+    //replay rebuilds a traced run without the program
+    if(opts.replayPath && nargs == 0){
+        return runReplay(opts.replayPath, opts.replayStep);
+    }
+
+    //the daemon takes its programs from its clients
+    if(opts.servePath && nargs == 0){
+        return runServer(opts.servePath, &opts);
+    }
+
+    //the load generator sends one program to a running daemon
+    if(opts.loadPath && nargs == 1){
+        return runLoad(opts.loadPath, argv[argi], &opts);
+    }
+
+    //multi-core runs share one memory between their cores
+    if(opts.scaling && nargs == 1){
+        return runScaling(argv[argi], &opts);
+    }
+    if(opts.cores && nargs == 1){
+        return runCores(argv[argi], &opts);
+    }
+
+    //extended addressing runs on its own machine
+    if(opts.addressBits && nargs == 1){
+        return runWide(argv[argi], &opts);
+    }
+
+    //--stream runs, one or a batch of them, can go through the result cache
+    if(opts.stream && (opts.cacheEntries > 0 || opts.cachePath)){
+        opts.cache = cacheCreate(opts.cacheEntries, opts.cachePath, opts.cacheVerify);
+        if(opts.cache == NULL){
+            printf("Could not open result cache %s\n", opts.cachePath);
+            return 1;
+        }
+    }
+
+    //batch mode runs everything listed in the manifest instead of one program
+    if(opts.batchPath && nargs == 0){
+        runBatch(opts.batchPath, &opts);
+    }
+
     //if we're reading from standard input
-    if(argc == 1){
-        
-        Hatchling h = readProgram();
-        printf("*** PROGRAM LOADING COMPLETED ***\n");
-        printf("*** PROGRAM EXECUTION BEGINS ***\n");
-        execute(&h);
+    else if(nargs == 0){
         
-        //Hatchling computer dump
-        printf("*** PROGRAM EXECUTION TERMINATED ***\n\n");
-        printf("REGISTERS\n");
-        printf("ACC         %04hX\n", h.accumulator);
-        printf("InstCtr       %02hX\n", h.instructCntr);
-        printf("InstReg     %04hX\n", h.instructReg);
-        printf("OpCode        %02hX\n", h.opCode);
-        printf("Operand       %02hX\n", h.operand);
-        printf("\nMemory: \n");
-
-        //print Hatchling program memory in matrix form
-        printf("    ");
-            for(int i = 0; i < 16; i++){
-                printf("%5X   ", i);
-            }
-
-            for(int i = 0; i < 256; i++){
-                
-                //new row in memory output
-                if(i % 16 == 0){
-                    printf("\n%2X   ", i);
-                }
-
-                printf("%04X    ", h.mem[i]);
-            }
-            printf("\n");
+        Hatchling h;
+        readProgram(&h);
+        if(opts.stream){
+            simulateStream(&h, &opts);
+        }
+        else{
+            simulate(&h, &opts);
+        }
     }
     
     //if we're reading from hml file
-    else if(argc == 2){
+    else if(nargs == 1){
         FILE *hp;
 
-        //proceeds only if the 2nd command line argument is a valid file 
-        if((hp = (fopen(argv[1], "r")))){
+        //proceeds only if the file path argument is a valid file 
+        if((hp = (fopen(argv[argi], "r")))){
             
-            Hatchling hf = readFile(hp);
+            Hatchling hf;
+            readFile(&hf, hp, stdout);
             fclose(hp);
-            printf("*** PROGRAM LOADING COMPLETED ***\n");
-            printf("*** PROGRAM EXECUTION BEGINS ***\n");
-            execute(&hf);
-
-            //Hatchling computer dump
-            printf("*** PROGRAM EXECUTION TERMINATED ***\n\n");
-            printf("REGISTERS\n");
-            printf("ACC         %04hX\n", hf.accumulator);
-            printf("InstCtr       %02hX\n", hf.instructCntr);
-            printf("InstReg     %04hX\n", hf.instructReg);
-            printf("OpCode        %02hX\n", hf.opCode);
-            printf("Operand       %02hX\n", hf.operand);
-            printf("\nMemory: \n");
-
-            //prints Hatchling program memory in matrix form
-            printf("    ");
-            for(int i = 0; i < 16; i++){
-                printf("%5X   ", i);
-            }
-
-            for(int i = 0; i < 256; i++){
-                
-                //new row in memory output
-                if(i % 16 == 0){
-                    printf("\n%2X   ", i);
-                }
-                printf("%04X    ", hf.mem[i]);
+
+            //lockstep mode runs the program once per input set
+            if(opts.lanesPath && !hf.fatalError){
+                runLanes(&hf, opts.lanesPath, &opts);
+            }
+            else if(opts.forkServer && !hf.fatalError){
+                return runForkServer(&hf, &opts);
+            }
+            else if(opts.explore > 0 && !hf.fatalError){
+                return runExplore(&hf, argv[argi], &opts);
+            }
+            else if(opts.stream){
+                simulateStream(&hf, &opts);
+            }
+            else{
+                simulate(&hf, &opts);
             }
-            printf("\n");
         }
         else{
             printf("Please enter a valid filepath\n");
@@ -543,6 +6231,13 @@ int main(int argc, char *argv[]){
     else{
         printf("Please enter \"./[executable]\" or \"./[executable] [filepath]\" to run the program\n");
     }
+
+    if(opts.cache){
+        if(opts.cacheStats){
+            printCacheStats(stdout, opts.cache);
+        }
+        cacheDestroy(opts.cache);
+    }
     
     // return to calling environment
     return(0);
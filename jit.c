@@ -0,0 +1,433 @@
+//================================================
+//
+// libhatchling: the x86-64 JIT tier. See
+// hatchling.h.
+//
+//================================================
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "hatchling.h"
+
+//the JIT emits x86-64 machine code into mmap'd buffers
+#if defined(__x86_64__) && defined(__unix__) && !defined(HML_NO_JIT)
+#define HML_JIT 1
+#endif
+
+
+#define JIT_THRESHOLD     64        //block entries before a block is compiled in JIT_ON mode
+#define JIT_MAX_BLOCK     64        //most instructions compiled into a single block
+#define JIT_MAX_INSN      24        //most bytes of machine code emitted per instruction
+#define JIT_BUFFER_SIZE   (1 << 20) //bytes of executable memory, flushed when full
+#define JIT_EXIT_FAULT    0x100     //set in a block's return value when the interpreter must run the next word
+
+//================================================
+// compiled block entry point: runs native code
+// against program memory and the accumulator
+// and returns the instruction counter to
+// continue interpreting at, with JIT_EXIT_FAULT
+// set if that instruction overflowed
+//================================================
+typedef int (*JitEntry)(unsigned short *mem, signed short *acc);
+
+//================================================
+// one compiled basic block, indexed by the
+// address it starts at
+//================================================
+struct jitBlock{
+    JitEntry entry;                         //native code, NULL if not compiled
+    unsigned char start;                    //first memory address covered by the block
+    unsigned char length;                   //number of memory words covered by the block
+    unsigned char nStores;                  //number of distinct STOR targets in the block
+    unsigned char stores[JIT_MAX_BLOCK];    //STOR targets, checked for invalidation on exit
+};
+typedef struct jitBlock JitBlock;
+
+//================================================
+// JIT state for one program run: block cache,
+// hotness counters and the code buffer
+//================================================
+struct jit{
+    unsigned char *buf;             //executable code buffer
+    size_t used;                    //bytes of buf handed out so far
+    unsigned int threshold;         //block entries before compiling
+    JitBlock blocks[256];           //compiled blocks by start address
+    unsigned int counts[256];       //times each leader has been reached
+    bool leader[256];               //addresses seen as branch targets / block starts
+    bool failed[256];               //leaders with nothing compilable at them
+    unsigned short cover[256];      //number of compiled blocks covering each address
+};
+typedef struct jit Jit;
+
+#ifdef HML_JIT
+//================================================
+// x86-64 code emission helpers. Compiled code
+// keeps the accumulator in cx, uses dx as a
+// scratch register, rdi points at program
+// memory and rsi at the accumulator
+//================================================
+static void jitEmit(unsigned char **p, const unsigned char *bytes, int n){
+    memcpy(*p, bytes, n);
+    *p += n;
+}
+
+static void jitEmit32(unsigned char **p, int value){
+    memcpy(*p, &value, 4);
+    *p += 4;
+}
+
+//emits an instruction with a [rdi + 2*addr] memory operand
+static void jitEmitMem(unsigned char **p, const unsigned char *bytes, int n, unsigned char addr){
+    jitEmit(p, bytes, n);
+    jitEmit32(p, addr * 2);
+}
+
+//================================================
+// creates the JIT state for one run, returns
+// NULL if executable memory isn't available
+//================================================
+static Jit *jitCreate(JitMode mode){
+    Jit *jit = calloc(1, sizeof(Jit));
+    if(jit == NULL){
+        return NULL;
+    }
+    jit->buf = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(jit->buf == MAP_FAILED){
+        free(jit);
+        return NULL;
+    }
+    jit->threshold = mode == JIT_ALWAYS ? 1 : JIT_THRESHOLD;
+    return jit;
+}
+
+static void jitDestroy(Jit *jit){
+    munmap(jit->buf, JIT_BUFFER_SIZE);
+    free(jit);
+}
+
+//================================================
+// drops a compiled block and its coverage
+//================================================
+static void jitDropBlock(Jit *jit, JitBlock *blk){
+    for(int i = 0; i < blk->length; i++){
+        jit->cover[(unsigned char)(blk->start + i)]--;
+    }
+    blk->entry = NULL;
+}
+
+//================================================
+// throws away every compiled block covering the
+// given address after it was written to
+//================================================
+static void jitInvalidate(Jit *jit, unsigned char addr){
+    jit->failed[addr] = false;
+    if(jit->cover[addr] == 0){
+        return;
+    }
+    for(int i = 0; i < 256; i++){
+        JitBlock *blk = &jit->blocks[i];
+        if(blk->entry && (unsigned char)(addr - blk->start) < blk->length){
+            jitDropBlock(jit, blk);
+        }
+    }
+}
+
+//================================================
+// returns whether the JIT compiles the opcode or
+// leaves it to the interpreter
+//================================================
+static bool jitSupported(unsigned char op){
+    switch(op){
+        case ADD: case SUB: case MUL:
+        case AND: case ORR: case NOT: case XOR:
+        case LSR: case ASR: case LSL:
+        case B: case BNEG: case BPOS: case BZRO:
+        case LOAD: case STOR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+//================================================
+// compiles the basic block starting at the given
+// address. The block ends at a branch, before
+// any instruction that needs the interpreter
+// (DIV, MOD, READ, WRTE, HALT, undefined), right
+// after a STOR into the block itself, or before
+// a word an earlier STOR in the block may have
+// changed. Returns false if nothing could be
+// compiled at the address.
+//================================================
+static bool jitCompile(Jit *jit, unsigned short *mem, unsigned char start){
+
+    //nothing to compile if the block would start with an interpreter-only word
+    if(!jitSupported(mem[start] >> 8)){
+        return false;
+    }
+
+    //flush everything if the buffer can't take a worst case block
+    size_t worst = (JIT_MAX_BLOCK + 2) * JIT_MAX_INSN * 2;
+    if(jit->used + worst > JIT_BUFFER_SIZE){
+        for(int i = 0; i < 256; i++){
+            if(jit->blocks[i].entry){
+                jitDropBlock(jit, &jit->blocks[i]);
+            }
+        }
+        jit->used = 0;
+    }
+    if(mprotect(jit->buf, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE) != 0){
+        return false;
+    }
+
+    unsigned char *code = jit->buf + jit->used;
+    unsigned char *p = code;
+    struct { unsigned char *rel; int pc; } exits[JIT_MAX_BLOCK * 2 + 1];
+    int nExits = 0;
+    bool stored[256] = {false};
+    JitBlock *blk = &jit->blocks[start];
+    blk->nStores = 0;
+
+    //movsx ecx, word [rsi]
+    jitEmit(&p, (unsigned char[]){0x0F, 0xBF, 0x0E}, 3);
+    unsigned char *loop = p;
+
+    //jumps to the exit stub that resumes the interpreter at pc
+    #define EXIT_REL(to)    do{ exits[nExits].rel = p; exits[nExits++].pc = (to); jitEmit32(&p, 0); }while(0)
+    #define EXIT_TO(to)     do{ jitEmit(&p, (unsigned char[]){0xE9}, 1); EXIT_REL(to); }while(0)
+    #define EXIT_IF_OF(to)  do{ jitEmit(&p, (unsigned char[]){0x0F, 0x80}, 2); EXIT_REL(to); }while(0)
+
+    int n = 0;
+    unsigned char addr = start;
+    bool ended = false;
+    while(!ended){
+        if(n == JIT_MAX_BLOCK || stored[addr] || (n > 0 && addr == 0)){
+            EXIT_TO(addr);
+            break;
+        }
+        unsigned char op = mem[addr] >> 8;
+        unsigned char a = mem[addr] & 0xFF;
+        switch(op){
+            case ADD:
+            case SUB:
+            case MUL:
+                //mov edx, ecx; <op> dx, [mem]; jo -> interpreter faults; mov ecx, edx
+                jitEmit(&p, (unsigned char[]){0x89, 0xCA}, 2);
+                if(op == ADD){
+                    jitEmitMem(&p, (unsigned char[]){0x66, 0x03, 0x97}, 3, a);
+                }
+                else if(op == SUB){
+                    jitEmitMem(&p, (unsigned char[]){0x66, 0x2B, 0x97}, 3, a);
+                }
+                else{
+                    jitEmitMem(&p, (unsigned char[]){0x66, 0x0F, 0xAF, 0x97}, 4, a);
+                }
+                EXIT_IF_OF(addr | JIT_EXIT_FAULT);
+                jitEmit(&p, (unsigned char[]){0x89, 0xD1}, 2);
+                break;
+            case AND:
+                jitEmitMem(&p, (unsigned char[]){0x66, 0x23, 0x8F}, 3, a);
+                break;
+            case ORR:
+                jitEmitMem(&p, (unsigned char[]){0x66, 0x0B, 0x8F}, 3, a);
+                break;
+            case XOR:
+                jitEmitMem(&p, (unsigned char[]){0x66, 0x33, 0x8F}, 3, a);
+                break;
+            case NOT:
+                //xor edx, edx; test cx, cx; sete dl; mov ecx, edx
+                jitEmit(&p, (unsigned char[]){0x31, 0xD2, 0x66, 0x85, 0xC9, 0x0F, 0x94, 0xC2, 0x89, 0xD1}, 10);
+                break;
+            case LSR:
+            case ASR:
+                //both shift the signed accumulator, sar cx, 1
+                jitEmit(&p, (unsigned char[]){0x66, 0xD1, 0xF9}, 3);
+                break;
+            case LSL:
+                //shl cx, 1
+                jitEmit(&p, (unsigned char[]){0x66, 0xD1, 0xE1}, 3);
+                break;
+            case LOAD:
+                //movsx ecx, word [mem]
+                jitEmitMem(&p, (unsigned char[]){0x0F, 0xBF, 0x8F}, 3, a);
+                break;
+            case STOR:
+            {
+                //mov word [mem], cx
+                jitEmitMem(&p, (unsigned char[]){0x66, 0x89, 0x8F}, 3, a);
+                stored[a] = true;
+                bool seen = false;
+                for(int i = 0; i < blk->nStores; i++){
+                    seen = seen || blk->stores[i] == a;
+                }
+                if(!seen){
+                    blk->stores[blk->nStores++] = a;
+                }
+
+                //a store into this block's own words ends the block
+                if((unsigned char)(a - start) <= n){
+                    EXIT_TO((unsigned char)(addr + 1));
+                    ended = true;
+                }
+                break;
+            }
+            case B:
+            case BNEG:
+            case BPOS:
+            case BZRO:
+            {
+                unsigned char jcc[2] = {0x0F, 0x85};
+                if(op == BNEG){
+                    jcc[1] = 0x88;  //js
+                }
+                else if(op == BPOS){
+                    jcc[1] = 0x8F;  //jg
+                }
+                else if(op == BZRO){
+                    jcc[1] = 0x84;  //jz
+                }
+                unsigned char *taken = NULL;
+                if(op != B){
+                    //test cx, cx; j<cc> taken
+                    jitEmit(&p, (unsigned char[]){0x66, 0x85, 0xC9}, 3);
+                    jitEmit(&p, jcc, 2);
+                    taken = p;
+                    jitEmit32(&p, 0);
+                    EXIT_TO((unsigned char)(addr + 1));
+                    int rel = (int)(p - taken - 4);
+                    memcpy(taken, &rel, 4);
+                }
+
+                //loops back to the block's own start stay in native code
+                if(a == start){
+                    jitEmit(&p, (unsigned char[]){0xE9}, 1);
+                    jitEmit32(&p, (int)(loop - p - 4));
+                }
+                else{
+                    EXIT_TO(a);
+                }
+                ended = true;
+                break;
+            }
+            default:
+                //DIV, MOD, READ, WRTE, HALT and undefined opcodes go back to the interpreter
+                EXIT_TO(addr);
+                ended = true;
+                continue;
+        }
+        n++;
+        addr++;
+    }
+
+    //exit stubs: mov word [rsi], cx; mov eax, pc; ret
+    for(int i = 0; i < nExits; i++){
+        int rel = (int)(p - exits[i].rel - 4);
+        memcpy(exits[i].rel, &rel, 4);
+        jitEmit(&p, (unsigned char[]){0x66, 0x89, 0x0E, 0xB8}, 4);
+        jitEmit32(&p, exits[i].pc);
+        jitEmit(&p, (unsigned char[]){0xC3}, 1);
+    }
+
+    #undef EXIT_REL
+    #undef EXIT_TO
+    #undef EXIT_IF_OF
+
+    if(mprotect(jit->buf, JIT_BUFFER_SIZE, PROT_READ | PROT_EXEC) != 0){
+        return false;
+    }
+    jit->used += ((size_t)(p - code) + 15) & ~(size_t)15;
+    blk->entry = (JitEntry)(void *)code;
+    blk->start = start;
+    blk->length = n;
+    for(int i = 0; i < n; i++){
+        jit->cover[(unsigned char)(start + i)]++;
+    }
+    return true;
+}
+#endif
+
+//================================================
+// runs the Hatchling program with the JIT tier:
+// interprets with hmlExecute() while counting
+// how often each block leader
+// (branch targets and the words after
+// instructions the JIT doesn't compile) is
+// reached, and runs hot blocks as native code.
+// Any STOR or READ that writes into a compiled
+// block throws the block away. Falls back to
+// hmlStep() when the JIT isn't available.
+//================================================
+HmlStatus hmlRunJit(Hatchling *hatchling, JitMode mode){
+    HmlStatus status;
+#ifdef HML_JIT
+    Jit *jit;
+
+    //a stopped program stays stopped, hmlStep() says why
+    if(hatchling->opCode == HALT || hatchling->fatalError){
+        return hmlStep(hatchling);
+    }
+    if(mode == JIT_OFF || (jit = jitCreate(mode)) == NULL){
+        while((status = hmlStep(hatchling)) == HML_OK){
+        }
+        return status;
+    }
+
+    //set when a block stopped on an overflowing instruction, which
+    //the interpreter then runs to report the fatal error
+    bool fault = false;
+
+    jit->leader[hatchling->instructCntr] = true;
+    for(;;){
+        unsigned char pc = hatchling->instructCntr;
+        JitBlock *blk = &jit->blocks[pc];
+
+        if(blk->entry == NULL && jit->leader[pc] && !jit->failed[pc] && ++jit->counts[pc] >= jit->threshold){
+            jit->failed[pc] = !jitCompile(jit, hatchling->mem, pc);
+            jit->counts[pc] = 0;
+        }
+
+        if(blk->entry && !fault){
+            int next = blk->entry(hatchling->mem, &hatchling->accumulator);
+            hatchling->instructCntr = next & 0xFF;
+            fault = next & JIT_EXIT_FAULT;
+
+            //stores inside the block may have hit compiled code
+            for(int i = 0; i < blk->nStores; i++){
+                jitInvalidate(jit, blk->stores[i]);
+            }
+            continue;
+        }
+
+        //interpret one instruction exactly like hmlRun()
+        status = hmlStep(hatchling);
+        if(status != HML_OK){
+            break;
+        }
+
+        switch(hatchling->opCode){
+            case B:
+            case BNEG:
+            case BPOS:
+            case BZRO:
+            case DIV:
+            case MOD:
+            case WRTE:
+                jit->leader[hatchling->instructCntr] = true;
+                break;
+            case READ:
+                jit->leader[hatchling->instructCntr] = true;
+                jitInvalidate(jit, hatchling->operand);
+                break;
+            case STOR:
+                jitInvalidate(jit, hatchling->operand);
+                break;
+        }
+    }
+    jitDestroy(jit);
+#else
+    (void)mode;
+    while((status = hmlStep(hatchling)) == HML_OK){
+    }
+#endif
+    return status;
+}
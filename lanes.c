@@ -0,0 +1,397 @@
+//================================================
+//
+// libhatchling: the SIMD lockstep engine, one
+// program run on many inputs at once. See
+// hatchling.h.
+//
+//================================================
+#include <stdlib.h>
+#include <string.h>
+#include "hatchling.h"
+
+//GCC/Clang vector extensions, the lockstep engine runs lanes one at a time without them
+#if defined(__GNUC__) && !defined(HML_NO_SIMD)
+#define HML_SIMD 1
+#define LANE_BLOCK 16               //lanes per vector block, one 256-bit register of words
+typedef signed short LaneVec __attribute__((vector_size(32)));
+typedef unsigned short LaneUVec __attribute__((vector_size(32)));
+typedef int LaneWide __attribute__((vector_size(64)));
+typedef unsigned long long LaneBits __attribute__((vector_size(32)));
+
+//half blocks for the baseline kernel, one 128-bit register of words
+typedef signed short LaneHalf __attribute__((vector_size(16)));
+typedef unsigned short LaneUHalf __attribute__((vector_size(16)));
+typedef int LaneHalfWide __attribute__((vector_size(32)));
+typedef unsigned long long LaneHalfBits __attribute__((vector_size(16)));
+#endif
+
+//================================================
+// structure-of-arrays state of N Hatchling lanes
+// running the same program: every register and
+// memory word is a vector across lanes, stored
+// in blocks of LANE_BLOCK lanes
+//================================================
+#ifdef HML_SIMD
+struct hmlLanes{
+    int nLanes;                     //lanes in use
+    int nBlocks;                    //vector blocks, nLanes rounded up to LANE_BLOCK
+    LaneVec *acc;                   //accumulator of each lane
+    LaneVec *pc;                    //instruction counter of each lane
+    LaneVec *running;               //-1 while a lane is running, 0 once it halted or hit a fatal error
+    LaneVec *slow;                  //-1 for lanes the current step hands to hmlExecute()
+    LaneVec *mem;                   //word address a of block b is mem[a * nBlocks + b]
+    Hatchling *io;                  //I/O of each lane, nothing else in them is used
+    HmlReportFn report;             //told about bad READ values and fatal errors, NULL for no one
+};
+#else
+struct hmlLanes{
+    int nLanes;
+};
+#endif
+
+#ifdef HML_SIMD
+//================================================
+// lane vector helpers
+//================================================
+#define LANE_BLEND(m, x, y) (((x) & (m)) | ((y) & ~(m)))
+#define LANE_SPLAT(V, v)    ((V){0} + (short)(v))
+#define LANE_ANY(BITS, m)   ({ BITS t_ = (BITS)(m); unsigned long long or_ = 0;                        \
+                               for(int k_ = 0; k_ < (int)(sizeof(BITS) / 8); k_++){ or_ |= t_[k_]; } \
+                               or_ != 0; })
+
+//================================================
+// one lockstep step: runs the word at address p
+// on every running lane whose counter is p and
+// whose copy of that word is the same, as a
+// masked vector operation over each block of
+// lanes. Blocks with no lanes in the group are
+// skipped. Lanes that need the scalar path
+// (overflow, DIV/MOD, I/O, undefined opcodes)
+// are flagged in slow. Returns the lowest
+// counter among the lanes still running, or a
+// value above 0xFF when none are.
+//
+// The body is written once over the vector type
+// V (unsigned UV, widened W, 64-bit view BITS)
+// and instantiated for full 256-bit blocks and
+// for 128-bit half blocks.
+//================================================
+#define SIMD_STEP_BODY(V, UV, W, BITS)                                                                   \
+    unsigned char op = word >> 8;                                                                       \
+    unsigned char a = word & 0xFF;                                                                      \
+    int nv = s->nBlocks * (int)(sizeof(LaneVec) / sizeof(V));                                           \
+    V *accs = (V *)s->acc;                                                                              \
+    V *pcs = (V *)s->pc;                                                                                \
+    V *runs = (V *)s->running;                                                                          \
+    V *slows = (V *)s->slow;                                                                            \
+    V *code = (V *)&s->mem[p * s->nBlocks];                                                             \
+    V *data = (V *)&s->mem[a * s->nBlocks];                                                             \
+    V vp = LANE_SPLAT(V, p);                                                                            \
+    V vword = LANE_SPLAT(V, word);                                                                      \
+    V va = LANE_SPLAT(V, a);                                                                            \
+    V one = LANE_SPLAT(V, 1);                                                                           \
+    V low = LANE_SPLAT(V, 0xFF);                                                                        \
+    V minPc = LANE_SPLAT(V, 0x7FFF);                                                                    \
+                                                                                                        \
+    for(int b = 0; b < nv; b++){                                                                        \
+        V run = runs[b];                                                                                \
+        V pc = pcs[b];                                                                                  \
+        V msk = run & (pc == vp) & (code[b] == vword);                                                  \
+                                                                                                        \
+        if(LANE_ANY(BITS, msk)){                                                                        \
+            V acc = accs[b];                                                                            \
+            V m = data[b];                                                                              \
+            V next = (pc + one) & low;                                                                  \
+            V fault = {0};                                                                              \
+                                                                                                        \
+            switch(op){                                                                                 \
+                case ADD:                                                                               \
+                {                                                                                       \
+                    V sum = (V)((UV)acc + (UV)m);                                                       \
+                    fault = msk & (((acc ^ sum) & (m ^ sum)) < 0);                                      \
+                    acc = LANE_BLEND(msk & ~fault, sum, acc);                                           \
+                    break;                                                                              \
+                }                                                                                       \
+                case SUB:                                                                               \
+                {                                                                                       \
+                    V diff = (V)((UV)acc - (UV)m);                                                      \
+                    fault = msk & (((acc ^ m) & (acc ^ diff)) < 0);                                     \
+                    acc = LANE_BLEND(msk & ~fault, diff, acc);                                          \
+                    break;                                                                              \
+                }                                                                                       \
+                case MUL:                                                                               \
+                {                                                                                       \
+                    W prod = __builtin_convertvector(acc, W) * __builtin_convertvector(m, W);           \
+                    V narrow = __builtin_convertvector(prod, V);                                        \
+                    fault = msk & __builtin_convertvector(__builtin_convertvector(narrow, W) != prod, V); \
+                    acc = LANE_BLEND(msk & ~fault, narrow, acc);                                        \
+                    break;                                                                              \
+                }                                                                                       \
+                case AND:                                                                               \
+                    acc = LANE_BLEND(msk, acc & m, acc);                                                \
+                    break;                                                                              \
+                case ORR:                                                                               \
+                    acc = LANE_BLEND(msk, acc | m, acc);                                                \
+                    break;                                                                              \
+                case XOR:                                                                               \
+                    acc = LANE_BLEND(msk, acc ^ m, acc);                                                \
+                    break;                                                                              \
+                case NOT:                                                                               \
+                    acc = LANE_BLEND(msk, (acc == 0) & one, acc);                                       \
+                    break;                                                                              \
+                case LSR:                                                                               \
+                case ASR:                                                                               \
+                    acc = LANE_BLEND(msk, acc >> 1, acc);                                               \
+                    break;                                                                              \
+                case LSL:                                                                               \
+                    acc = LANE_BLEND(msk, (V)((UV)acc << 1), acc);                                      \
+                    break;                                                                              \
+                case B:                                                                                 \
+                    next = va;                                                                          \
+                    break;                                                                              \
+                case BNEG:                                                                              \
+                    next = LANE_BLEND(acc < 0, va, next);                                               \
+                    break;                                                                              \
+                case BPOS:                                                                              \
+                    next = LANE_BLEND(acc > 0, va, next);                                               \
+                    break;                                                                              \
+                case BZRO:                                                                              \
+                    next = LANE_BLEND(acc == 0, va, next);                                              \
+                    break;                                                                              \
+                case LOAD:                                                                              \
+                    acc = LANE_BLEND(msk, m, acc);                                                      \
+                    break;                                                                              \
+                case STOR:                                                                              \
+                    data[b] = LANE_BLEND(msk, acc, m);                                                  \
+                    break;                                                                              \
+                case HALT:                                                                              \
+                    run &= ~msk;                                                                        \
+                    next = pc;                                                                          \
+                    break;                                                                              \
+                default:                                                                                \
+                    fault = msk;                                                                        \
+                    break;                                                                              \
+            }                                                                                           \
+                                                                                                        \
+            /* lanes in the group move on unless they need the scalar path */                           \
+            accs[b] = acc;                                                                              \
+            pcs[b] = pc = LANE_BLEND(msk & ~fault, next, pc);                                           \
+            runs[b] = run;                                                                              \
+            if(LANE_ANY(BITS, fault)){                                                                  \
+                slows[b] = fault;                                                                       \
+                *anySlow = true;                                                                        \
+            }                                                                                           \
+        }                                                                                               \
+                                                                                                        \
+        /* lanes that stopped count as 0x7FFF so they never win the min */                              \
+        V lanePc = LANE_BLEND(run, pc, minPc);                                                          \
+        minPc = LANE_BLEND(lanePc < minPc, lanePc, minPc);                                              \
+    }                                                                                                   \
+                                                                                                        \
+    int lowest = 0x7FFF;                                                                                \
+    for(int i = 0; i < (int)(sizeof(V) / sizeof(short)); i++){                                          \
+        lowest = minPc[i] < lowest ? minPc[i] : lowest;                                                 \
+    }                                                                                                   \
+    return lowest;
+
+__attribute__((target("avx2"))) static int simdStepAvx2(HmlLanes *s, unsigned char p, unsigned short word, bool *anySlow){
+    SIMD_STEP_BODY(LaneVec, LaneUVec, LaneWide, LaneBits)
+}
+
+static int simdStepBase(HmlLanes *s, unsigned char p, unsigned short word, bool *anySlow){
+    SIMD_STEP_BODY(LaneHalf, LaneUHalf, LaneHalfWide, LaneHalfBits)
+}
+
+//================================================
+// lane accessors into the vector blocks
+//================================================
+#define LANE(v, i)        (((signed short *)(v))[(i)])
+#define LANE_MEM(s, a, i) (((signed short *)&(s)->mem[(a) * (s)->nBlocks])[(i)])
+
+//================================================
+// runs the word at address p on one lane through
+// hmlExecute(), with a scratch Hatchling holding
+// the lane's registers and I/O and the one
+// memory word the instruction can touch, so
+// statuses and fatal errors are exactly those of
+// the scalar engines
+//================================================
+static void simdScalarStep(HmlLanes *s, int i, unsigned char p, unsigned short word){
+    unsigned char a = word & 0xFF;
+    const Hatchling *io = &s->io[i];
+    Hatchling scratch;
+    hmlInit(&scratch);
+    hmlSetIo(&scratch, io->read, io->write, io->in, io->out);
+    scratch.accumulator = LANE(s->acc, i);
+    scratch.instructCntr = p;
+    scratch.instructReg = word;
+    scratch.opCode = word >> 8;
+    scratch.operand = a;
+    scratch.mem[a] = LANE_MEM(s, a, i);
+    HmlStatus status = hmlExecute(&scratch);
+    if(status != HML_OK && s->report){
+        s->report(&scratch, status);
+    }
+
+    LANE(s->acc, i) = scratch.accumulator;
+    LANE(s->pc, i) = scratch.instructCntr;
+    LANE_MEM(s, a, i) = scratch.mem[a];
+    if(scratch.fatalError){
+        LANE(s->running, i) = 0;
+    }
+}
+
+//================================================
+// runs the loaded program on every lane in
+// lockstep. Each step picks the lowest counter
+// among running lanes, so lanes that took
+// different paths regroup as soon as they reach
+// the same address again.
+//================================================
+static void executeLockstep(HmlLanes *s, SimdMode mode){
+    int (*step)(HmlLanes *, unsigned char, unsigned short, bool *) = simdStepBase;
+#if defined(__x86_64__) || defined(__i386__)
+    if(mode == SIMD_AVX2 || (mode == SIMD_AUTO && __builtin_cpu_supports("avx2"))){
+        step = simdStepAvx2;
+    }
+#else
+    (void)mode;
+#endif
+
+    int p = 0;
+    while(p <= 0xFF){
+
+        //the group runs the word held by its first lane, lanes holding another word wait
+        unsigned short word = 0;
+        for(int i = 0; i < s->nLanes; i++){
+            if(LANE(s->running, i) && LANE(s->pc, i) == p){
+                word = LANE_MEM(s, p, i);
+                break;
+            }
+        }
+
+        bool anySlow = false;
+        p = step(s, p, word, &anySlow);
+        if(!anySlow){
+            continue;
+        }
+
+        for(int b = 0; b < s->nBlocks; b++){
+            if(!LANE_ANY(LaneBits, s->slow[b])){
+                continue;
+            }
+            for(int i = b * LANE_BLOCK; i < (b + 1) * LANE_BLOCK; i++){
+                if(LANE(s->slow, i)){
+                    simdScalarStep(s, i, LANE(s->pc, i), word);
+                }
+            }
+            s->slow[b] = (LaneVec){0};
+        }
+
+        //the scalar path moved or stopped lanes, find the lowest counter again
+        p = 0x7FFF;
+        for(int i = 0; i < s->nLanes; i++){
+            if(LANE(s->running, i) && LANE(s->pc, i) < p){
+                p = LANE(s->pc, i);
+            }
+        }
+    }
+}
+
+//================================================
+// sets up nLanes lanes of a loaded program, none
+// with any I/O until hmlLanesSetIo(). Returns
+// NULL without vector extensions or memory.
+//================================================
+HmlLanes *hmlLanesCreate(const Hatchling *prog, int nLanes, HmlReportFn report){
+    if(nLanes < 1){
+        return NULL;
+    }
+    HmlLanes *s = calloc(1, sizeof(HmlLanes));
+    if(s == NULL){
+        return NULL;
+    }
+    s->nLanes = nLanes;
+    s->nBlocks = (nLanes + LANE_BLOCK - 1) / LANE_BLOCK;
+    s->acc = aligned_alloc(32, s->nBlocks * sizeof(LaneVec));
+    s->pc = aligned_alloc(32, s->nBlocks * sizeof(LaneVec));
+    s->running = aligned_alloc(32, s->nBlocks * sizeof(LaneVec));
+    s->slow = aligned_alloc(32, s->nBlocks * sizeof(LaneVec));
+    s->mem = aligned_alloc(32, 256 * s->nBlocks * sizeof(LaneVec));
+    s->io = calloc(nLanes, sizeof(Hatchling));
+    s->report = report;
+    if(s->acc == NULL || s->pc == NULL || s->running == NULL || s->slow == NULL || s->mem == NULL || s->io == NULL){
+        hmlLanesDestroy(s);
+        return NULL;
+    }
+    memset(s->slow, 0, s->nBlocks * sizeof(LaneVec));
+    for(int i = 0; i < s->nBlocks * LANE_BLOCK; i++){
+        LANE(s->acc, i) = prog->accumulator;
+        LANE(s->pc, i) = prog->instructCntr;
+        LANE(s->running, i) = i < nLanes ? -1 : 0;
+        for(int a = 0; a < 256; a++){
+            LANE_MEM(s, a, i) = prog->mem[a];
+        }
+    }
+    return s;
+}
+
+void hmlLanesDestroy(HmlLanes *s){
+    free(s->acc);
+    free(s->pc);
+    free(s->running);
+    free(s->slow);
+    free(s->mem);
+    free(s->io);
+    free(s);
+}
+
+void hmlLanesSetIo(HmlLanes *s, int lane, HmlReadFn read, HmlWriteFn write, void *in, void *out){
+    hmlSetIo(&s->io[lane], read, write, in, out);
+}
+
+void hmlLanesRun(HmlLanes *s, SimdMode mode){
+    executeLockstep(s, mode);
+}
+
+//================================================
+// copies a lane's registers and memory into a
+// context, which keeps its own I/O
+//================================================
+void hmlLanesGet(const HmlLanes *s, int lane, Hatchling *hatchling){
+    for(int a = 0; a < 256; a++){
+        hatchling->mem[a] = LANE_MEM(s, a, lane);
+    }
+    hatchling->accumulator = LANE(s->acc, lane);
+    hatchling->instructCntr = LANE(s->pc, lane);
+    hatchling->instructReg = hatchling->mem[hatchling->instructCntr];
+    hatchling->opCode = hatchling->instructReg >> 8;
+    hatchling->operand = hatchling->instructReg & 0xFF;
+}
+#else
+HmlLanes *hmlLanesCreate(const Hatchling *prog, int nLanes, HmlReportFn report){
+    (void)prog;
+    (void)nLanes;
+    (void)report;
+    return NULL;
+}
+
+void hmlLanesDestroy(HmlLanes *lanes){
+    free(lanes);
+}
+
+void hmlLanesSetIo(HmlLanes *lanes, int lane, HmlReadFn read, HmlWriteFn write, void *in, void *out){
+    (void)lanes; (void)lane; (void)read; (void)write; (void)in; (void)out;
+}
+
+void hmlLanesRun(HmlLanes *lanes, SimdMode mode){
+    (void)lanes;
+    (void)mode;
+}
+
+void hmlLanesGet(const HmlLanes *lanes, int lane, Hatchling *hatchling){
+    (void)lanes;
+    (void)lane;
+    (void)hatchling;
+}
+#endif
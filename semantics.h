@@ -0,0 +1,71 @@
+//================================================
+//
+// libhatchling, internal: what every Hatchling
+// instruction does, written once. hmlExecute()
+// in hatchling.c and the threaded interpreters
+// in threaded.c are both generated from this
+// list, so they can't drift apart.
+//
+//================================================
+#ifndef HML_SEMANTICS_H
+#define HML_SEMANTICS_H
+
+//================================================
+// X(op, body) for every instruction but HALT.
+// A body works on the locals acc (the
+// accumulator), mem (memory) and a (the
+// operand), and on hatchling for its I/O. What
+// it does where engines differ goes through
+// hooks each engine defines before expanding
+// the list:
+//
+//   OVERFLOW_CHECK(r)  r is out of 16-bit range
+//   ZERO_CHECK(d)      d is a zero divisor
+//   JUMP(t)            go to t instead of the
+//                      next word
+//   READ_WORD(a)       read a value into mem[a]
+//   STORED(a)          mem[a] was just written
+//
+// A body that falls off its end moves on to the
+// next word.
+//================================================
+#define HML_SEMANTICS(X)                                                                                     \
+    X(ADD,  { int r_ = acc + (signed short)mem[a]; OVERFLOW_CHECK(r_); acc = r_; })                          \
+    X(SUB,  { int r_ = acc - (signed short)mem[a]; OVERFLOW_CHECK(r_); acc = r_; })                          \
+    X(MUL,  { int r_ = acc * (signed short)mem[a]; OVERFLOW_CHECK(r_); acc = r_; })                          \
+    X(DIV,  { ZERO_CHECK(mem[a]); int r_ = acc / (signed short)mem[a]; OVERFLOW_CHECK(r_); acc = r_; })      \
+    X(MOD,  { ZERO_CHECK(mem[a]); int r_ = acc % (signed short)mem[a]; OVERFLOW_CHECK(r_); acc = r_; })      \
+    X(AND,  { acc &= mem[a]; })                                                                              \
+    X(ORR,  { acc |= mem[a]; })                                                                              \
+    X(NOT,  { acc = !acc; })                                                                                 \
+    X(XOR,  { acc ^= mem[a]; })                                                                              \
+    X(LSR,  { acc = acc >> 1; })                                                                             \
+    X(ASR,  { acc = acc < 0 ? ~(~acc >> 1) : acc >> 1; })                                                    \
+    X(LSL,  { acc = acc << 1; })                                                                             \
+    X(B,    { JUMP(a); })                                                                                    \
+    X(BNEG, { if(acc < 0){ JUMP(a); } })                                                                     \
+    X(BPOS, { if(acc > 0){ JUMP(a); } })                                                                     \
+    X(BZRO, { if(acc == 0){ JUMP(a); } })                                                                    \
+    X(LOAD, { acc = (signed short)mem[a]; })                                                                 \
+    X(STOR, { mem[a] = acc; STORED(a); })                                                                    \
+    X(READ, { READ_WORD(a); STORED(a); })                                                                    \
+    X(WRTE, { if(hatchling->write){ hatchling->write(hatchling, (signed short)mem[a]); } })
+
+//================================================
+// the READ_WORD() every engine uses: a read
+// that fails ends the run at fatal with
+// HML_END_OF_INPUT, a value out of range goes
+// to BAD_INPUT with the READ still to run
+//================================================
+#define HML_READ_WORD(a, BAD_INPUT)                                                                          \
+    { long dat_;                                                                                             \
+      if(hatchling->read == NULL || hatchling->read(hatchling, &dat_) != HML_OK){                            \
+          status = HML_END_OF_INPUT;                                                                         \
+          goto fatal;                                                                                        \
+      }                                                                                                      \
+      if(dat_ < -32768 || dat_ > 32767){                                                                     \
+          BAD_INPUT;                                                                                         \
+      }                                                                                                      \
+      mem[a] = (signed short)dat_; }
+
+#endif
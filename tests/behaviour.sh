@@ -0,0 +1,199 @@
+#!/bin/sh
+#================================================
+# behaviour checks for the hmlsim modes that
+# don't just run one program: the result cache,
+# trace replay, batch, the serve daemon and its
+# load generator, multi-core and wide address
+# spaces. Prints FAIL for each case that doesn't
+# behave and exits non-zero if one failed.
+#
+# usage: tests/behaviour.sh (from the repository root)
+#================================================
+root=$(cd "$(dirname "$0")/.." && pwd)
+tmp=$(mktemp -d)
+server=
+trap '[ -n "$server" ] && kill $server 2>/dev/null; rm -rf "$tmp"' EXIT
+failed=0
+
+gcc -O2 -Wall -pthread -o "$tmp/hmlsim" "$root/hmlsim.c" "$root/hatchling.c" "$root/analyze.c" \
+    "$root/threaded.c" "$root/jit.c" "$root/lanes.c" "$root/cores.c" || exit 1
+sim="$tmp/hmlsim"
+
+printf '5\n3\n1\n2\n4\n0\n0\n0\n' > "$tmp/in.txt"
+
+#--- result cache ---
+
+#the first run stores its result, a second process answers from the file with what a plain run prints
+"$sim" --stream --input="$tmp/in.txt" "$root/ex2.hml" > "$tmp/plain"
+"$sim" --stream --input="$tmp/in.txt" --cache-file="$tmp/cache" --cache-stats "$root/ex2.hml" > "$tmp/first"
+"$sim" --stream --input="$tmp/in.txt" --cache-file="$tmp/cache" --cache-verify=1 --cache-stats "$root/ex2.hml" > "$tmp/second"
+if [ "$(tail -n 1 "$tmp/first")" != "*** RESULT CACHE: 0 HITS, 1 MISSES, 1 STORED, 0 VERIFIED, 0 MISMATCHED ***" ] \
+    || [ "$(tail -n 1 "$tmp/second")" != "*** RESULT CACHE: 1 HITS, 0 MISSES, 0 STORED, 1 VERIFIED, 0 MISMATCHED ***" ]; then
+    echo "FAIL cache file doesn't hit on the second run"
+    failed=1
+fi
+if [ "$(sed '$d' "$tmp/first")" != "$(cat "$tmp/plain")" ] || [ "$(sed '$d' "$tmp/second")" != "$(cat "$tmp/plain")" ]; then
+    echo "FAIL cached run prints something else than a plain one"
+    failed=1
+fi
+
+#different input is a different key
+printf '7\n' > "$tmp/other.txt"
+out=$("$sim" --stream --input="$tmp/other.txt" --cache-file="$tmp/cache" --cache-stats "$root/ex2.hml" | tail -n 1)
+if [ "$out" != "*** RESULT CACHE: 0 HITS, 1 MISSES, 1 STORED, 0 VERIFIED, 0 MISMATCHED ***" ]; then
+    echo "FAIL cache hit for different input: $out"
+    failed=1
+fi
+
+#--- trace replay ---
+
+#replaying to the end of a trace rebuilds the final state of the run that recorded it
+"$sim" --trace="$tmp/primes.hmt" "$root/bench/primes.hml" > "$tmp/traced"
+"$sim" --replay="$tmp/primes.hmt" > "$tmp/replayed"
+if [ "$(sed -n '/^REGISTERS/,$p' "$tmp/traced")" != "$(sed -n '/^REGISTERS/,$p' "$tmp/replayed")" ] \
+    || ! grep -q "^\*\*\* REPLAYED TO STEP 3134064 OF 3134064 \*\*\*$" "$tmp/replayed"; then
+    echo "FAIL --replay to the end of the trace"
+    failed=1
+fi
+
+#replaying to a step has the accumulator, counter and memory of a run stopped there
+"$sim" --replay="$tmp/primes.hmt" --at=5000 > "$tmp/replayed"
+"$sim" --max-steps=5000 "$root/bench/primes.hml" > "$tmp/stopped"
+for section in "^ACC" "^InstCtr" "/^Memory/,\$"; do
+    case $section in /*) cmd="${section}p" ;; *) cmd="/$section/p" ;; esac
+    if [ "$(sed -n "$cmd" "$tmp/stopped")" != "$(sed -n "$cmd" "$tmp/replayed")" ]; then
+        echo "FAIL --replay --at=5000 differs from --max-steps=5000 in $section"
+        failed=1
+    fi
+done
+
+#--- batch ---
+
+#a manifest runs every job, in order, each printing what it prints on its own
+printf '%s %s\n' "$root/ex1.hml" "$tmp/in.txt" "$root/two.hml" "$tmp/in.txt" "$root/three.hml" "$tmp/in.txt" \
+    "$root/ex2.hml" "$tmp/other.txt" > "$tmp/manifest"
+"$sim" --batch="$tmp/manifest" --threads=3 > "$tmp/batch"
+rc=$?
+for p in ex1 two three; do
+    "$sim" "$root/$p.hml" < "$tmp/in.txt"
+done > "$tmp/single"
+"$sim" "$root/ex2.hml" < "$tmp/other.txt" >> "$tmp/single"
+if [ $rc -ne 0 ] || [ "$(grep -v '^\*\*\* BATCH JOB' "$tmp/batch")" != "$(cat "$tmp/single")" ] \
+    || [ "$(grep '^\*\*\* BATCH JOB' "$tmp/batch" | cut -d' ' -f4)" != "$(printf '1:\n2:\n3:\n4:')" ]; then
+    echo "FAIL --batch of a manifest"
+    failed=1
+fi
+
+#a container made by --convert runs every program in it
+"$sim" --convert="$tmp/all.hmc" "$root/ex1.hml" "$root/two.hml" > /dev/null
+"$sim" --batch="$tmp/all.hmc" --threads=2 < /dev/null | grep -v '^\*\*\* BATCH JOB' > "$tmp/batch"
+{ "$sim" "$root/ex1.hml" < /dev/null; "$sim" "$root/two.hml" < /dev/null; } > "$tmp/single"
+if ! cmp -s "$tmp/batch" "$tmp/single"; then
+    echo "FAIL --batch of a container"
+    failed=1
+fi
+
+#--- serve and load ---
+
+"$sim" --serve="$tmp/sock" --threads=2 > "$tmp/serve.log" 2>&1 &
+server=$!
+i=0
+while [ ! -S "$tmp/sock" ] && [ $i -lt 50 ] && kill -0 $server 2>/dev/null; do
+    sleep 0.1
+    i=$((i + 1))
+done
+if grep -q "needs epoll" "$tmp/serve.log"; then
+    echo "skipped --serve, not built on this platform"
+elif [ ! -S "$tmp/sock" ]; then
+    echo "FAIL --serve didn't start listening"
+    failed=1
+else
+    #every request gets back the result of running the program itself
+    "$sim" --load="$tmp/sock" --connections=3 --requests=20 --pipeline=4 "$root/ex2.hml" < "$tmp/in.txt" > "$tmp/load"
+    rc=$?
+    "$sim" --stream --input="$tmp/in.txt" "$root/ex2.hml" > "$tmp/single"
+    if [ $rc -ne 0 ] || ! grep -q "^REQUESTS        60$" "$tmp/load" || ! grep -q "^MISMATCHES      0$" "$tmp/load" \
+        || ! grep -q "^STATUS          HALTED$" "$tmp/load" \
+        || [ "$(grep '^OUTPUT' "$tmp/load")" != "$(grep '^OUTPUT' "$tmp/single")" ] \
+        || [ "$(sed -n '/EXECUTION TERMINATED/,$p' "$tmp/load")" != "$(sed -n '/EXECUTION TERMINATED/,$p' "$tmp/single")" ]; then
+        echo "FAIL --load against --serve (rc $rc)"
+        failed=1
+    fi
+
+    #--dump=none leaves the numbers alone
+    "$sim" --load="$tmp/sock" --requests=5 --dump=none "$root/ex2.hml" < "$tmp/in.txt" > "$tmp/load"
+    if grep -q "^STATUS\|^REGISTERS" "$tmp/load" || ! grep -q "^LATENCY P99.9" "$tmp/load"; then
+        echo "FAIL --load --dump=none"
+        failed=1
+    fi
+
+    #SIGTERM shuts the server down cleanly
+    kill $server
+    wait $server
+    rc=$?
+    server=
+    if [ $rc -ne 0 ] || ! grep -q "^\*\*\* SERVER STOPPED \*\*\*$" "$tmp/serve.log"; then
+        echo "FAIL --serve shutdown (rc $rc)"
+        failed=1
+    fi
+fi
+
+#a server that isn't there is a failed run that counts no requests
+out=$("$sim" --load="$tmp/nothing" --requests=5 "$root/ex2.hml" < "$tmp/in.txt")
+rc=$?
+if [ $rc -eq 0 ] || ! echo "$out" | grep -q "^REQUESTS        0$" || ! echo "$out" | grep -q "CONNECTION TO .* FAILED"; then
+    echo "FAIL --load with no server (rc $rc)"
+    failed=1
+fi
+
+#--- multi-core ---
+
+#one core runs a plain program to the same output and memory as the single machine
+for p in ex1 two three; do
+    "$sim" --cores=1 "$root/$p.hml" < "$tmp/in.txt" > "$tmp/cores"
+    "$sim" "$root/$p.hml" < "$tmp/in.txt" > "$tmp/single"
+    if [ "$(grep -o 'OUTPUT: .*' "$tmp/cores")" != "$(grep -o 'OUTPUT: .*' "$tmp/single")" ] \
+        || [ "$(sed -n '/^Memory/,$p' "$tmp/cores")" != "$(sed -n '/^Memory/,$p' "$tmp/single")" ]; then
+        echo "FAIL --cores=1 on $p.hml"
+        failed=1
+    fi
+done
+
+#the deterministic schedule interleaves the cores the same way every time
+a=$("$sim" --cores=4 --schedule=deterministic --quantum=7 "$root/reduce.hml")
+b=$("$sim" --cores=4 --schedule=deterministic --quantum=7 "$root/reduce.hml")
+if [ "$a" != "$b" ] || ! echo "$a" | grep -q "^OUTPUT: 1000 "; then
+    echo "FAIL --schedule=deterministic isn't reproducible"
+    failed=1
+fi
+
+#--- wide address spaces ---
+
+#EXTH/EXT prefixes reach words far past the first page
+printf '6112\n6034\n4056\n6112\n6034\n1057\n6112\n6034\n4158\n6112\n6034\n5158\nFF00\n@123456\n0100\n0023\n' > "$tmp/wide.hml"
+out=$("$sim" --address-bits=24 "$tmp/wide.hml")
+if ! echo "$out" | grep -q "^OUTPUT: 0123 " || ! echo "$out" | grep -q "^ACC         0123$" \
+    || ! echo "$out" | grep -q "^Memory: 2 pages of 256 words written"; then
+    echo "FAIL 24-bit program"
+    failed=1
+fi
+
+#an address past a 16-bit space doesn't load
+out=$("$sim" --address-bits=16 "$tmp/wide.hml")
+if ! echo "$out" | grep -q "BAD INSTRUCTION ON LINE 0D" || echo "$out" | grep -q "EXECUTION BEGINS"; then
+    echo "FAIL 24-bit address in a 16-bit space"
+    failed=1
+fi
+
+#a plain program runs unchanged in page 0
+for p in ex1 two three; do
+    wide=$("$sim" --address-bits=16 "$root/$p.hml" < "$tmp/in.txt")
+    single=$("$sim" "$root/$p.hml" < "$tmp/in.txt")
+    if [ "$(echo "$wide" | grep -o 'OUTPUT: .*\|^ACC.*\|^\*\*\*.*')" != "$(echo "$single" | grep -o 'OUTPUT: .*\|^ACC.*\|^\*\*\*.*')" ]; then
+        echo "FAIL --address-bits=16 on $p.hml"
+        failed=1
+    fi
+done
+
+[ $failed -eq 0 ] && echo "all behaviour checks passed"
+exit $failed
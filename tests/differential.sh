@@ -0,0 +1,81 @@
+#!/bin/sh
+#================================================
+# differential checks for hmlsim. Runs every
+# sample program under each engine and mode
+# that should behave like the reference switch
+# engine, with good input and with a value out
+# of range, and prints FAIL for any output that
+# differs from --engine=switch. Exits non-zero
+# if one did.
+#
+# usage: tests/differential.sh (from the repository root)
+#================================================
+root=$(cd "$(dirname "$0")/.." && pwd)
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+#the library is built once, every --emit-c translation is linked against it
+for src in hatchling analyze threaded jit lanes cores; do
+    gcc -O2 -Wall -c -o "$tmp/$src.o" "$root/$src.c" || exit 1
+done
+ar rcs "$tmp/libhatchling.a" "$tmp"/*.o
+gcc -O2 -Wall -pthread -o "$tmp/hmlsim" "$root/hmlsim.c" "$tmp/libhatchling.a" || exit 1
+
+printf '5\n3\n1\n2\n4\n0\n0\n0\n' > "$tmp/good.txt"
+printf '5\n3\n99999\n1\n0\n0\n' > "$tmp/bad.txt"
+printf '5 3 1\n-2 7 0\n1\n\n4 4 4 4\n7FFF 7FFF\n' > "$tmp/lanes.txt"
+
+for prog in "$root"/*.hml "$root"/bench/*.hml; do
+    name=$(basename "$prog")
+    for input in good bad; do
+        "$tmp/hmlsim" --engine=switch "$prog" < "$tmp/$input.txt" > "$tmp/ref" 2>&1
+
+        #--step-log runs the instrumented variant, a wrapping run only matches where nothing overflows
+        modes="--engine=threaded --jit=on --jit=always --optimize --variant=strict --step-log=/dev/null"
+        if ! grep -q "ACCUMULATOR OVERFLOW" "$tmp/ref"; then
+            modes="$modes --variant=wrapping"
+        fi
+        for mode in $modes; do
+            "$tmp/hmlsim" $mode "$prog" < "$tmp/$input.txt" > "$tmp/out" 2>&1
+            if ! cmp -s "$tmp/ref" "$tmp/out"; then
+                echo "FAIL $name $mode ($input input)"
+                failed=1
+            fi
+        done
+    done
+
+    #the program translated by --emit-c and built into the simulator
+    "$tmp/hmlsim" --emit-c="$tmp/aot.c" "$prog" > /dev/null
+    if ! gcc -O1 -pthread -DHML_AOT="\"$tmp/aot.c\"" -o "$tmp/hmlsim_aot" "$root/hmlsim.c" "$tmp/libhatchling.a"; then
+        echo "FAIL $name --emit-c doesn't build"
+        failed=1
+    else
+        for input in good bad; do
+            "$tmp/hmlsim" --engine=switch "$prog" < "$tmp/$input.txt" > "$tmp/ref" 2>&1
+            "$tmp/hmlsim_aot" "$prog" < "$tmp/$input.txt" > "$tmp/out" 2>&1
+            if ! cmp -s "$tmp/ref" "$tmp/out"; then
+                echo "FAIL $name --emit-c ($input input)"
+                failed=1
+            fi
+        done
+    fi
+
+    #every lane prints what a run on that lane's input prints
+    for simd in auto scalar; do
+        "$tmp/hmlsim" --lanes="$tmp/lanes.txt" --simd=$simd "$prog" > "$tmp/lanes.out" 2>&1
+        n=0
+        while IFS= read -r line; do
+            n=$((n + 1))
+            printf '%s\n' $line | "$tmp/hmlsim" --engine=switch "$prog" > "$tmp/ref" 2>&1
+            awk -v n=$n '/^\*\*\* LANE [0-9]+ \*\*\*$/{ lane = $3; next } lane == n' "$tmp/lanes.out" > "$tmp/out"
+            if ! cmp -s "$tmp/ref" "$tmp/out"; then
+                echo "FAIL $name --lanes --simd=$simd, lane $n"
+                failed=1
+            fi
+        done < "$tmp/lanes.txt"
+    done
+done
+
+[ $failed -eq 0 ] && echo "all differential checks passed"
+exit $failed
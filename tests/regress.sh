@@ -0,0 +1,78 @@
+#!/bin/sh
+#================================================
+# regression checks for hmlsim. Builds the
+# simulator into a scratch directory and runs
+# each case, printing FAIL for any that doesn't
+# behave. Exits non-zero if one failed.
+#
+# usage: tests/regress.sh (from the repository root)
+#================================================
+root=$(cd "$(dirname "$0")/.." && pwd)
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+gcc -O2 -Wall -pthread -o "$tmp/hmlsim" "$root/hmlsim.c" "$root/hatchling.c" "$root/analyze.c" \
+    "$root/threaded.c" "$root/jit.c" "$root/lanes.c" "$root/cores.c" || exit 1
+
+#a container holding only the magic is truncated, not a crash, and says so once
+printf 'HMLC' > "$tmp/tiny.hmc"
+out=$("$tmp/hmlsim" --batch="$tmp/tiny.hmc")
+rc=$?
+if [ $rc -ne 0 ] || [ "$out" != "TRUNCATED CONTAINER $tmp/tiny.hmc" ]; then
+    echo "FAIL header-only container (rc $rc)"
+    failed=1
+fi
+
+#a READ with no input left ends the run instead of reading garbage
+out=$("$tmp/hmlsim" "$root/two.hml" < /dev/null)
+rc=$?
+if [ $rc -ne 0 ] || ! echo "$out" | grep -q "^\*\*\* END OF INPUT \*\*\*$" \
+    || ! echo "$out" | grep -q "^REGISTERS"; then
+    echo "FAIL READ at end of input (rc $rc)"
+    failed=1
+fi
+
+#a budget can't silently drop the engine that was asked for
+out=$("$tmp/hmlsim" --max-steps=100 --jit=on "$root/bench/primes.hml")
+if ! echo "$out" | grep -q "can't be used with"; then
+    echo "FAIL --max-steps with --jit"
+    failed=1
+fi
+
+#a profiled run keeps to its step budget
+out=$("$tmp/hmlsim" --max-steps=1000 --profile "$root/bench/primes.hml")
+if ! echo "$out" | grep -q "STEP LIMIT OF 1000 REACHED" || ! echo "$out" | grep -q "PROFILE: 1000 STEPS"; then
+    echo "FAIL --max-steps with --profile"
+    failed=1
+fi
+
+#a traced run keeps to its step budget and stops where the untraced one does
+plain=$("$tmp/hmlsim" --max-steps=70000 "$root/bench/primes.hml")
+traced=$("$tmp/hmlsim" --max-steps=70000 --trace="$tmp/t.hmt" "$root/bench/primes.hml")
+if [ "$plain" != "$traced" ] || ! echo "$traced" | grep -q "STEP LIMIT OF 70000 REACHED"; then
+    echo "FAIL --max-steps with --trace"
+    failed=1
+fi
+
+#a wide program line too long for a word is rejected, not cut short to one
+printf '4001\n00000000000000001\nFF00\n' > "$tmp/long.hml"
+out=$("$tmp/hmlsim" --address-bits=24 "$tmp/long.hml")
+if ! echo "$out" | grep -q "BAD INSTRUCTION ON LINE 01" || echo "$out" | grep -q "EXECUTION BEGINS"; then
+    echo "FAIL long line in a wide program"
+    failed=1
+fi
+
+#reduce.hml sums the same on 1, 2 and 4 cores, on threads and under the scheduler
+for schedule in deterministic threads; do
+    for k in 1 2 4; do
+        out=$("$tmp/hmlsim" --cores=$k --schedule=$schedule "$root/reduce.hml" | grep "^OUTPUT")
+        if [ "$out" != "OUTPUT: 1000 (REPRESENTED IN BASE 16, 2'S COMPLEMENT)" ]; then
+            echo "FAIL reduce.hml on $k cores ($schedule): $out"
+            failed=1
+        fi
+    done
+done
+
+[ $failed -eq 0 ] && echo "all regression checks passed"
+exit $failed
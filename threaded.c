@@ -0,0 +1,220 @@
+//================================================
+//
+// libhatchling: the threaded interpreter, its
+// peephole pass, and the specialized variants
+// built on it. See hatchling.h.
+//
+//================================================
+#include <string.h>
+#include "hatchling.h"
+#include "semantics.h"
+
+
+//================================================
+// computed goto (labels as values) is a GNU
+// extension, the threaded engine falls back to
+// a switch when the compiler doesn't have it
+//================================================
+#if defined(__GNUC__) && !defined(HML_NO_COMPUTED_GOTO)
+#define HML_COMPUTED_GOTO 1
+#endif
+
+//================================================
+// superinstructions the peephole pass puts in
+// place of common sequences, numbered past the
+// real opcodes so they never collide with a
+// word in memory
+//================================================
+#define FUSED_LOAD_ADD_STOR 0x100   //LOAD x; ADD y; STOR z
+#define FUSED_LOAD_SUB_STOR 0x101   //LOAD x; SUB y; STOR z
+#define FUSED_LOAD_SUB_BZRO 0x102   //LOAD x; SUB y; BZRO z
+#define FUSED_STOR_LOAD     0x103   //STOR x; LOAD x, the LOAD can't change the accumulator
+#define FOLDED_LOAD         0x104   //LOAD of a constant word
+#define FOLDED_STOR         0x105   //LOAD/ADD|SUB/STOR of constant words, stores value
+#define FOLDED_BRANCH       0x106   //LOAD/SUB/BZRO of constant words, goes to operand3
+#define SAFE_ADD            0x107   //ADD the analysis proved can't overflow
+#define SAFE_SUB            0x108   //SUB the analysis proved can't overflow
+#define SAFE_MUL            0x109   //MUL the analysis proved can't overflow
+#define SLOT_KINDS          0x10A
+
+//================================================
+// one predecoded memory word used by the
+// threaded engine: where to jump for its opcode
+// (or the superinstruction starting there) and
+// the operands to run it with
+//================================================
+struct decodedSlot{
+#ifdef HML_COMPUTED_GOTO
+    const void *handler;            //label of the handler for opCode
+#endif
+    unsigned short opCode;          //opcode, or the superinstruction starting at this word
+    unsigned char operand;          //lower byte of the predecoded word
+    unsigned char operand2;         //operands of the second and third word of a superinstruction
+    unsigned char operand3;
+    signed short value;             //accumulator result of a folded sequence
+};
+typedef struct decodedSlot DecodedSlot;
+
+//================================================
+// marks every address that some word in memory
+// would write to as a STOR or READ. Everything
+// else is constant, so the peephole pass may
+// fold it.
+//================================================
+static void findWritable(const unsigned short *mem, bool *writable){
+    memset(writable, 0, 256 * sizeof(bool));
+    for(int i = 0; i < 256; i++){
+        unsigned char op = mem[i] >> 8;
+        if(op == STOR || op == READ){
+            writable[mem[i] & 0xFF] = true;
+        }
+    }
+}
+
+//================================================
+// peephole pass for one word of the threaded
+// engine: predecodes the word at i and, when it
+// starts one of the common sequences, replaces
+// it with a superinstruction covering the whole
+// sequence. Sequences that only read constant
+// words are folded into their result, unless
+// the result overflows, in which case they stay
+// fused so the fault happens at run time. The
+// words after i keep their own slots, so
+// branches into the middle of a sequence still
+// work. Returns the slot's opcode.
+//================================================
+static unsigned short peephole(DecodedSlot *slot, const unsigned short *mem, const bool *writable, int i){
+    unsigned char op = mem[i] >> 8;
+    unsigned char x = mem[i] & 0xFF;
+    slot->opCode = op;
+    slot->operand = x;
+    slot->operand2 = 0;
+    slot->operand3 = 0;
+    slot->value = 0;
+
+    if(op == STOR){
+        if(i + 1 < 256 && mem[i + 1] == (LOAD << 8 | x)){
+            slot->opCode = FUSED_STOR_LOAD;
+        }
+        return slot->opCode;
+    }
+    if(op != LOAD){
+        return op;
+    }
+
+    if(i + 2 < 256){
+        unsigned char op2 = mem[i + 1] >> 8;
+        unsigned char op3 = mem[i + 2] >> 8;
+        if((op2 == ADD && op3 == STOR) || (op2 == SUB && (op3 == STOR || op3 == BZRO))){
+            unsigned char y = mem[i + 1] & 0xFF;
+            unsigned char z = mem[i + 2] & 0xFF;
+            slot->operand2 = y;
+            slot->operand3 = z;
+            if(op2 == ADD){
+                slot->opCode = FUSED_LOAD_ADD_STOR;
+            }
+            else{
+                slot->opCode = op3 == STOR ? FUSED_LOAD_SUB_STOR : FUSED_LOAD_SUB_BZRO;
+            }
+
+            if(!writable[x] && !writable[y]){
+                int result = op2 == ADD ? (signed short)mem[x] + (signed short)mem[y]
+                                        : (signed short)mem[x] - (signed short)mem[y];
+                if(result >= -32768 && result <= 32767){
+                    slot->value = result;
+                    if(op3 == STOR){
+                        slot->opCode = FOLDED_STOR;
+                    }
+                    else{
+                        slot->opCode = FOLDED_BRANCH;
+                        slot->operand3 = result == 0 ? z : (unsigned char)(i + 3);
+                    }
+                }
+            }
+            return slot->opCode;
+        }
+    }
+
+    if(!writable[x]){
+        slot->opCode = FOLDED_LOAD;
+        slot->value = mem[x];
+    }
+    return slot->opCode;
+}
+
+//================================================
+// runs the peephole pass over a loaded program
+// and counts the superinstructions it makes
+//================================================
+void hmlPeepholeStats(const Hatchling *hatchling, PeepholeStats *stats){
+    static const int lengths[] = {3, 3, 3, 2, 1, 3, 3};
+    bool writable[256];
+    memset(stats, 0, sizeof(*stats));
+    findWritable(hatchling->mem, writable);
+    for(int i = 0; i < 256; i++){
+        DecodedSlot slot;
+        unsigned short kind = peephole(&slot, hatchling->mem, writable, i);
+        if(kind >= FUSED_LOAD_ADD_STOR){
+            stats->fused[kind - FUSED_LOAD_ADD_STOR]++;
+            stats->words += lengths[kind - FUSED_LOAD_ADD_STOR];
+        }
+    }
+}
+
+//================================================
+// the threaded engines. The checked one runs
+// hmlRunThreaded() and the strict variant, the
+// wrapping one leaves the overflow checks out,
+// and the instrumented one calls its hook
+// before every instruction, so it doesn't fuse
+// any of them.
+//================================================
+#define THREADED_NAME       runChecked
+#define THREADED_CHECKED    1
+#define THREADED_FUSE       1
+#define THREADED_HOOK       0
+#include "threaded_loop.h"
+#undef THREADED_NAME
+#undef THREADED_CHECKED
+#undef THREADED_FUSE
+#undef THREADED_HOOK
+
+#define THREADED_NAME       runWrapping
+#define THREADED_CHECKED    0
+#define THREADED_FUSE       1
+#define THREADED_HOOK       0
+#include "threaded_loop.h"
+#undef THREADED_NAME
+#undef THREADED_CHECKED
+#undef THREADED_FUSE
+#undef THREADED_HOOK
+
+#define THREADED_NAME       runInstrumented
+#define THREADED_CHECKED    1
+#define THREADED_FUSE       0
+#define THREADED_HOOK       1
+#include "threaded_loop.h"
+#undef THREADED_NAME
+#undef THREADED_CHECKED
+#undef THREADED_FUSE
+#undef THREADED_HOOK
+
+HmlStatus hmlRunThreaded(Hatchling *hatchling, const Analysis *analysis){
+    return runChecked(hatchling, analysis, NULL);
+}
+
+//strict: the library's semantics
+HmlStatus hmlRunStrict(Hatchling *hatchling, const Instrument *instrument){
+    return runChecked(hatchling, NULL, instrument);
+}
+
+//wrapping: for programs known not to overflow, results that do wrap to 16 bits
+HmlStatus hmlRunWrapping(Hatchling *hatchling, const Instrument *instrument){
+    return runWrapping(hatchling, NULL, instrument);
+}
+
+//instrumented: strict, with the hook before every instruction
+HmlStatus hmlRunInstrumented(Hatchling *hatchling, const Instrument *instrument){
+    return runInstrumented(hatchling, NULL, instrument);
+}
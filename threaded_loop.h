@@ -0,0 +1,282 @@
+//================================================
+//
+// libhatchling, internal: one threaded
+// interpreter loop. threaded.c includes this
+// once per engine it builds, after defining
+//
+//   THREADED_NAME     the function to define
+//   THREADED_CHECKED  1 to check for overflow
+//   THREADED_FUSE     1 to run the peephole pass
+//   THREADED_HOOK     1 to call the instrument
+//                     before every instruction
+//
+// so the checks an engine leaves out aren't
+// compiled into it at all. The handlers for the
+// instructions come from HML_SEMANTICS.
+//
+//================================================
+
+//================================================
+// runs the Hatchling program like hmlRun(), but
+// predecodes all 256 memory words into a table
+// of handler/operand slots up front and jumps
+// straight from one handler to the next. The
+// accumulator and instruction counter live in
+// locals and are written back when the program
+// halts, hits a fatal error or reads a value
+// out of range, with the same final state and
+// status as hmlRun(). With an analysis of a
+// program that doesn't modify its code, stores
+// never re-decode anything and the ADD, SUB and
+// MUL it proved safe run without overflow
+// checks.
+//================================================
+static HmlStatus THREADED_NAME(Hatchling *hatchling, const Analysis *analysis, const Instrument *instrument){
+
+    //a stopped program stays stopped, hmlStep() says why
+    if(hatchling->opCode == HALT || hatchling->fatalError){
+        return hmlStep(hatchling);
+    }
+
+    unsigned short *mem = hatchling->mem;
+    signed short acc = hatchling->accumulator;
+    unsigned char pc = hatchling->instructCntr;
+    unsigned char operand;
+    HmlStatus status;
+    DecodedSlot code[256];
+    bool writable[256];
+    findWritable(mem, writable);
+    bool stable = analysis && !analysis->selfModifying;
+    (void)instrument;
+
+#if THREADED_FUSE
+    //only a LOAD or STOR can start a superinstruction, anything else decodes as itself
+    #define PEEPHOLE(i) ((mem[(i)] >> 8) == LOAD || (mem[(i)] >> 8) == STOR ? peephole(&code[(i)], mem, writable, (i)) \
+                            : (code[(i)].operand = mem[(i)] & 0xFF, code[(i)].opCode = mem[(i)] >> 8))
+#else
+    #define PEEPHOLE(i) (code[(i)].operand = mem[(i)] & 0xFF, code[(i)].opCode = mem[(i)] >> 8)
+#endif
+
+#if THREADED_HOOK
+    #define STEP_HOOK() instrument->step(instrument->ctx, pc, mem[pc], acc)
+#else
+    #define STEP_HOOK()
+#endif
+
+#ifdef HML_COMPUTED_GOTO
+    //opcode -> handler, anything without one is undefined
+    #define HANDLER_ENTRY(op, body) handlers[op] = &&op_##op;
+    const void *handlers[SLOT_KINDS];
+    for(int i = 0; i < SLOT_KINDS; i++){
+        handlers[i] = &&op_undefined;
+    }
+    HML_SEMANTICS(HANDLER_ENTRY)
+    handlers[HALT] = &&op_HALT;
+    handlers[FUSED_LOAD_ADD_STOR] = &&op_FUSED_LOAD_ADD_STOR;
+    handlers[FUSED_LOAD_SUB_STOR] = &&op_FUSED_LOAD_SUB_STOR;
+    handlers[FUSED_LOAD_SUB_BZRO] = &&op_FUSED_LOAD_SUB_BZRO;
+    handlers[FUSED_STOR_LOAD] = &&op_FUSED_STOR_LOAD;
+    handlers[FOLDED_LOAD] = &&op_FOLDED_LOAD;
+    handlers[FOLDED_STOR] = &&op_FOLDED_STOR;
+    handlers[FOLDED_BRANCH] = &&op_FOLDED_BRANCH;
+    handlers[SAFE_ADD] = &&op_SAFE_ADD;
+    handlers[SAFE_SUB] = &&op_SAFE_SUB;
+    handlers[SAFE_MUL] = &&op_SAFE_MUL;
+    #define DECODE(i)   (code[(i)].handler = handlers[PEEPHOLE(i)])
+    #define HANDLER(op) op_##op
+    #define UNDEFINED   op_undefined
+    #define DISPATCH()  do{ STEP_HOOK(); operand = code[pc].operand; goto *code[pc].handler; }while(0)
+
+    //pasted here, HANDLER() would expand the opcode's name first
+    #define HANDLER_CASE(op, body)  op_##op: HANDLER_BODY(body)
+#else
+    #define DECODE(i)   PEEPHOLE(i)
+    #define HANDLER(op) case op
+    #define UNDEFINED   default
+    #define DISPATCH()  continue
+    #define HANDLER_CASE(op, body)  case op: HANDLER_BODY(body)
+#endif
+
+#if THREADED_FUSE
+    /*a store re-decodes the stored word, and the one or two words before
+        it when they are a LOAD or STOR that may start a superinstruction
+        covering it. A store that creates a STOR or READ into a word the
+        peephole pass took as constant undoes the folding everywhere. A
+        stable program only ever stores into data, nothing needs it */
+    #define REDECODE(z) do{ unsigned char z_ = (z), y_ = z_ - 1, x_ = z_ - 2, w_ = mem[z_] & 0xFF; \
+                            if(stable){ \
+                            } \
+                            else if(((mem[z_] >> 8) == STOR || (mem[z_] >> 8) == READ) && !writable[w_]){ \
+                                writable[w_] = true; \
+                                for(int i_ = 0; i_ < 256; i_++){ DECODE(i_); } \
+                            } \
+                            else{ \
+                                DECODE(z_); \
+                                if((mem[y_] >> 8) == LOAD || (mem[y_] >> 8) == STOR){ DECODE(y_); } \
+                                if((mem[x_] >> 8) == LOAD){ DECODE(x_); } \
+                            } }while(0)
+#else
+    //without superinstructions a store only ever changes its own slot
+    #define REDECODE(z) do{ if(!stable){ DECODE(z); } }while(0)
+#endif
+
+#if THREADED_CHECKED
+    #define OVERFLOW_CHECK(r)   if((r) < -32768 || (r) > 32767){ status = HML_OVERFLOW; goto fatal; }
+    #define FUSED_CHECK(r)      if((r) < -32768 || (r) > 32767){ goto fused_fault; }
+#else
+    #define OVERFLOW_CHECK(r)
+    #define FUSED_CHECK(r)
+#endif
+    #define ZERO_CHECK(d)       if((d) == 0){ status = HML_DIVIDE_BY_ZERO; goto fatal; }
+    #define JUMP(t)             { pc = (t); DISPATCH(); }
+    #define READ_WORD(a)        HML_READ_WORD(a, { status = HML_BAD_INPUT; goto done; })
+    #define STORED(a)           REDECODE(a)
+    #define HANDLER_BODY(...)   { unsigned char a = operand; (void)a; __VA_ARGS__ } pc++; DISPATCH();
+
+    //predecode the whole memory image
+    for(int i = 0; i < 256; i++){
+        DECODE(i);
+        if(stable && analysis->safe[i] && code[i].opCode <= MUL){
+            code[i].opCode += SAFE_ADD - ADD;
+#ifdef HML_COMPUTED_GOTO
+            code[i].handler = handlers[code[i].opCode];
+#endif
+        }
+    }
+
+#ifdef HML_COMPUTED_GOTO
+    DISPATCH();
+    {
+#else
+    for(;;){
+        STEP_HOOK();
+        operand = code[pc].operand;
+        switch(code[pc].opCode){
+#endif
+
+        HML_SEMANTICS(HANDLER_CASE)
+
+        HANDLER(SAFE_ADD):
+            acc += (signed short)mem[operand];
+            pc++;
+            DISPATCH();
+
+        HANDLER(SAFE_SUB):
+            acc -= (signed short)mem[operand];
+            pc++;
+            DISPATCH();
+
+        HANDLER(SAFE_MUL):
+            acc *= (signed short)mem[operand];
+            pc++;
+            DISPATCH();
+
+        HANDLER(FUSED_LOAD_ADD_STOR):
+        {
+            int sum = (signed short)mem[operand] + (signed short)mem[code[pc].operand2];
+            FUSED_CHECK(sum);
+            acc = sum;
+            unsigned char z = code[pc].operand3;
+            mem[z] = acc;
+            REDECODE(z);
+            pc += 3;
+            DISPATCH();
+        }
+
+        HANDLER(FUSED_LOAD_SUB_STOR):
+        {
+            int diff = (signed short)mem[operand] - (signed short)mem[code[pc].operand2];
+            FUSED_CHECK(diff);
+            acc = diff;
+            unsigned char z = code[pc].operand3;
+            mem[z] = acc;
+            REDECODE(z);
+            pc += 3;
+            DISPATCH();
+        }
+
+        HANDLER(FUSED_LOAD_SUB_BZRO):
+        {
+            int diff = (signed short)mem[operand] - (signed short)mem[code[pc].operand2];
+            FUSED_CHECK(diff);
+            acc = diff;
+            pc = acc == 0 ? code[pc].operand3 : pc + 3;
+            DISPATCH();
+        }
+
+#if THREADED_CHECKED
+        fused_fault:
+            //run the LOAD, then let the ADD/SUB on its own fault
+            acc = mem[operand];
+            pc++;
+            DISPATCH();
+#endif
+
+        HANDLER(FUSED_STOR_LOAD):
+            mem[operand] = acc;
+            REDECODE(operand);
+
+            //unless the store replaced the LOAD, it leaves the accumulator as it is
+            pc += operand == (unsigned char)(pc + 1) ? 1 : 2;
+            DISPATCH();
+
+        HANDLER(FOLDED_LOAD):
+            acc = code[pc].value;
+            pc++;
+            DISPATCH();
+
+        HANDLER(FOLDED_STOR):
+        {
+            acc = code[pc].value;
+            unsigned char z = code[pc].operand3;
+            mem[z] = acc;
+            REDECODE(z);
+            pc += 3;
+            DISPATCH();
+        }
+
+        HANDLER(FOLDED_BRANCH):
+            acc = code[pc].value;
+            pc = code[pc].operand3;
+            DISPATCH();
+
+        HANDLER(HALT):
+            status = HML_HALTED;
+            goto done;
+
+        UNDEFINED:
+            status = HML_UNDEFINED_OPCODE;
+            goto fatal;
+#ifndef HML_COMPUTED_GOTO
+        }
+#endif
+    }
+
+fatal:
+    hatchling->fatalError = true;
+done:
+    //the word at pc is the one that stopped the run
+    hatchling->accumulator = acc;
+    hatchling->instructCntr = pc;
+    hatchling->instructReg = mem[pc];
+    hatchling->opCode = mem[pc] >> 8;
+    hatchling->operand = mem[pc] & 0xFF;
+    return status;
+
+    #undef PEEPHOLE
+    #undef STEP_HOOK
+    #undef HANDLER_ENTRY
+    #undef DECODE
+    #undef HANDLER
+    #undef UNDEFINED
+    #undef DISPATCH
+    #undef REDECODE
+    #undef OVERFLOW_CHECK
+    #undef FUSED_CHECK
+    #undef ZERO_CHECK
+    #undef JUMP
+    #undef READ_WORD
+    #undef STORED
+    #undef HANDLER_BODY
+    #undef HANDLER_CASE
+}